@@ -65,6 +65,10 @@ STAR: '*';
 SLASH: '/';
 LPAREN: '(';
 RPAREN: ')';
+LBRACKET: '[';
+RBRACKET: ']';
+LBRACE: '{';
+RBRACE: '}';
 COMMA: ',';
 DOT: '.';
 AT: '@';
@@ -88,6 +92,11 @@ FOR: 'FOR';
 NEXT: 'NEXT';
 STEP: 'STEP';
 TO: 'TO';
+BREAK: 'BREAK';
+
+// arrays
+DIM: 'DIM';
+AS: 'AS';
 
 // modules
 MODULE: 'MODULE';
@@ -10,6 +10,9 @@ options {
 #ifndef _WIN32
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #endif
+#include "atom.h"
+#include "call_site.h"
+#include "type_feedback.h"
 }
 
 // Actual grammar start.
@@ -22,7 +25,10 @@ main
    )+ EOF
 ;
 
+// site caches the function this call resolved to, and name is the
+// procedureName interned on first use.
 procedureCall
+  locals [wwivbasic::CallSite site, wwivbasic::Name name]
   : procedureName LPAREN (parameterList)? RPAREN
   ;
 
@@ -57,23 +63,42 @@ statement
     | forStatement
     | procedureCall NEWLINE
     | returnStatement
+    | breakStatement
+    | dimStatement
     | emptyStatement        
 ;
 
 emptyStatement : NEWLINE;
 
 
-expr: expr relationaloperator expr      # Relation
-    | expr multiplicativeoperator expr  # MulDiv
+// Alternatives are in order of precedence, highest first.  feedback
+// records the operand types seen by the operator alternatives.
+expr
+  locals [wwivbasic::TypeFeedback feedback]
+    : expr multiplicativeoperator expr  # MulDiv
     | expr additiveoperator expr        # AddSub
+    | expr relationaloperator expr      # Relation
+    | expr AND expr                     # LogicalAnd
+    | expr OR expr                      # LogicalOr
     | procedureCall                     # ProcCall
     | LPAREN expr RPAREN                # Parens
+    | rvalue LBRACKET expr RBRACKET     # Index
+    | dictionary                        # Dict
     | rvalue                            # Ident
     | INT                               # Int
     | STRING                            # String
     | booleanExpr                       # Boolean
 ;
 
+// { key : value, ... } makes a dictionary of the entries, in order.
+dictionary
+  : LBRACE (dictionaryEntry (COMMA dictionaryEntry)*)? RBRACE
+;
+
+dictionaryEntry
+  : expr COLON expr
+;
+
 booleanExpr
   : TRUE
   | FALSE
@@ -82,14 +107,12 @@ booleanExpr
 additiveoperator
    : PLUS
    | MINUS
-   | OR
 ;
 
 multiplicativeoperator
    : STAR
    | SLASH
    | MOD
-   | AND
 ;
 
 relationaloperator
@@ -127,19 +150,41 @@ ifThenElseIfElseStatement
   : IF expr THEN NEWLINE? statements (ELSEIF expr THEN NEWLINE? statements)* ELSE statements ENDIF NEWLINE
 ;
 
+// var is the loop variable interned on first use.  The STEP may be
+// negated, as in STEP -1, since there is no unary minus.
 forStatement
-  : FOR ID EQ expr TO expr (STEP INT)? NEWLINE? statements NEXT NEWLINE
+  locals [wwivbasic::Atom var]
+  : FOR ID EQ expr TO expr (STEP MINUS? expr)? NEWLINE? statements NEXT NEWLINE
+;
+
+// Leaves the innermost FOR loop.
+breakStatement
+  : BREAK NEWLINE
 ;
 
 returnStatement
   : RETURN expr NEWLINE
 ;
 
-lvalue :   variable;
+// DIM name[size] AS type makes an array of size elements, indexed from 0.
+// The type is INTEGER (the default), STRING or BOOLEAN.
+dimStatement
+  : DIM variable LBRACKET expr RBRACKET (AS ID)? NEWLINE
+;
+
+// A variable, or an element of an array or dictionary.
+lvalue : variable (LBRACKET expr RBRACKET)?;
 
 id: ID;
 
-variable :   ID;
-rvalue :   ID;
+// name is the ID interned on first use.
+variable
+  locals [wwivbasic::Name name]
+  : ID
+  ;
+rvalue
+  locals [wwivbasic::Name name]
+  : ID
+  ;
 procedureName : ID;
 
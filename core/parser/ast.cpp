@@ -21,11 +21,12 @@
 #include "core/stl.h"
 #include "core/strings.h"
 #include "fmt/format.h"
+#include <functional>
 #include <iomanip>
 #include <memory>
 #include <sstream>
-#include <stack>
 #include <stdexcept>
+#include <string_view>
 #include <utility>
 
 using namespace wwiv::strings;
@@ -156,127 +157,165 @@ std::string Factor::ToString(int indent) const {
 
 void Factor::accept(AstVisitor* visitor) { visitor->visit(this); }
 
-static std::unique_ptr<Factor> createFactor(const Token& token) {
-  const auto& l = token.lexeme;
-
-  if (token.type == TokenType::string || token.type == TokenType::character) {
-    return std::make_unique<String>(l);
-  } else if (isdigit(l.front())) {
-    return std::make_unique<Number>(to_number<int>(l));
-  } else {
-    return std::make_unique<Variable>(l);
-  }
-}
-
-static std::unique_ptr<LogicalOperatorNode> createLogicalOperator(const Token& token) {
+static Operator logical_operator(const Token& token) {
   switch (token.type) {
   case TokenType::logical_or:
-    return std::make_unique<LogicalOperatorNode>(Operator::logical_or);
+    return Operator::logical_or;
   case TokenType::logical_and:
-    return std::make_unique<LogicalOperatorNode>(Operator::logical_and);
+    return Operator::logical_and;
   }
   throw parse_error(fmt::format("Unexpected token found trying to create logical operator: ",
                                 to_string(token)));
 }
 
-static std::unique_ptr<BinaryOperatorNode> createBinaryOperator(const Token& token) {
+static Operator binary_operator(const Token& token) {
   switch (token.type) {
   case TokenType::add:
-    return std::make_unique<BinaryOperatorNode>(Operator::add);
+    return Operator::add;
   case TokenType::assign:
     throw parse_error("Assignment operators are not allowed.");
   case TokenType::div:
-    return std::make_unique<BinaryOperatorNode>(Operator::div);
+    return Operator::div;
   case TokenType::eq:
-    return std::make_unique<BinaryOperatorNode>(Operator::eq);
+    return Operator::eq;
   case TokenType::ge:
-    return std::make_unique<BinaryOperatorNode>(Operator::ge);
+    return Operator::ge;
   case TokenType::gt:
-    return std::make_unique<BinaryOperatorNode>(Operator::gt);
+    return Operator::gt;
   case TokenType::le:
-    return std::make_unique<BinaryOperatorNode>(Operator::le);
+    return Operator::le;
   case TokenType::lt:
-    return std::make_unique<BinaryOperatorNode>(Operator::lt);
+    return Operator::lt;
   case TokenType::mul:
-    return std::make_unique<BinaryOperatorNode>(Operator::mul);
+    return Operator::mul;
   case TokenType::ne:
-    return std::make_unique<BinaryOperatorNode>(Operator::ne);
+    return Operator::ne;
   case TokenType::sub:
-    return std::make_unique<BinaryOperatorNode>(Operator::sub);
+    return Operator::sub;
   }
   throw parse_error(
       fmt::format("Unexpected token found trying to create logical operator: ", to_string(token)));
 }
 
-// ReSharper disable once CppMemberFunctionMayBeConst
-bool Ast::reduce(std::stack<std::unique_ptr<AstNode>>& stack) {
-  VLOG(2) << "Ast::reduce. Stack Size: " << stack.size();
-  if (stack.size() < 3) {
+///////////////////////////////////////////////////////////////////////////
+// FlatAst
+
+int32_t FlatAst::intern(const std::string& s) {
+  const auto mask = interned_.size() - 1;
+  for (auto i = std::hash<std::string_view>()(s) & mask;; i = (i + 1) & mask) {
+    auto& [offset, length] = interned_[i];
+    if (length < 0) {
+      offset = static_cast<int32_t>(strings_.size());
+      length = static_cast<int32_t>(s.size());
+      strings_.append(s);
+      return offset;
+    }
+    if (std::string_view(strings_).substr(offset, length) == s) {
+      return offset;
+    }
+  }
+}
+
+FlatAst::Entry FlatAst::factor(const Token& token) {
+  const auto& l = token.lexeme;
+  FlatNode n{FlatNodeType::variable, Operator::UNKNOWN, 0, 0};
+  if (token.type == TokenType::string || token.type == TokenType::character) {
+    n.type = FlatNodeType::string_val;
+  } else if (isdigit(l.front())) {
+    n.type = FlatNodeType::int_value;
+    n.a = to_number<int>(l);
+  }
+  if (n.type != FlatNodeType::int_value) {
+    n.a = intern(l);
+    n.b = static_cast<int32_t>(l.size());
+  }
+  nodes_.push_back(n);
+  return {AstType::FACTOR, Operator::UNKNOWN, root()};
+}
+
+std::string FlatAst::describe(const Entry& e) const {
+  switch (e.type) {
+  case AstType::BINOP:
+    return fmt::format("BinOp: {}", to_string(e.op));
+  case AstType::LOGICAL_OP:
+    return fmt::format("LogOp: {}", to_string(e.op));
+  default: {
+    const auto& n = nodes_[e.node];
+    if (n.type == FlatNodeType::expression) {
+      return fmt::format("Expression #{}", e.node);
+    }
+    if (n.type == FlatNodeType::int_value) {
+      return fmt::format("Factor #{}: '{}'", e.node, n.int_value());
+    }
+    return fmt::format("Factor #{}: '{}'", e.node, text(n));
+  }
+  }
+}
+
+bool FlatAst::need_reduce(size_t base, bool allow_logical) const {
+  if (stack_.size() == base) {
+    return false;
+  }
+  const auto t = stack_.back().type;
+  return t == AstType::BINOP || (allow_logical && t == AstType::LOGICAL_OP);
+}
+
+void FlatAst::reduce(size_t base) {
+  VLOG(2) << "FlatAst::reduce. Stack Size: " << stack_.size() - base;
+  if (stack_.size() - base < 3) {
     std::ostringstream ss;
-    while (!stack.empty()) {
-      ss << "[" << stack.top()->ToString() << "] ";
-      stack.pop();
+    while (stack_.size() > base) {
+      ss << "[" << describe(stack_.back()) << "] ";
+      stack_.pop_back();
     }
     throw parse_error(fmt::format("[CNTREDUCE3] Invalid expression provided: \r\nHere's what was understood: {} ", ss.str()));
   }
-  auto right_ast = std::move(stack.top());
-  stack.pop();
-  const auto op_ast = std::move(stack.top());
-  stack.pop();
-  auto left_ast = std::move(stack.top());
-  stack.pop();
-  
-  // Set op
-  auto op{Operator::UNKNOWN};
-  if (auto* oper = dynamic_cast<OperatorNode*>(op_ast.get())) {
-    op = oper->oper;
-  } else {
-    throw parse_error(fmt::format("Expected BINOP at: {}", to_string(*op_ast.get())));
-  }
-  // Set left
-  std::unique_ptr<Expression> left;
-  if (left_ast->ast_type() == AstType::FACTOR) {
-    auto* factor = dynamic_cast<Factor*>(left_ast.release());
-    left = std::unique_ptr<Factor>(factor);
-  } else if (left_ast->ast_type() == AstType::EXPR) {
-    auto* factor = dynamic_cast<Expression*>(left_ast.release());
-    left = std::unique_ptr<Expression>(factor);
-  }
-  std::unique_ptr<Expression> right;
-  // Set right
-  if (right_ast->ast_type() == AstType::FACTOR) {
-    auto* factor = dynamic_cast<Factor*>(right_ast.release());
-    right = std::unique_ptr<Factor>(factor);
-  } else if (right_ast->ast_type() == AstType::EXPR) {
-    auto* factor = dynamic_cast<Expression*>(right_ast.release());
-    right = std::unique_ptr<Expression>(factor);
-  }
-  stack.push(std::make_unique<Expression>(std::move(left), op, std::move(right)));
-  return true;
+  const auto right = stack_.back();
+  stack_.pop_back();
+  const auto op = stack_.back();
+  stack_.pop_back();
+  const auto left = stack_.back();
+  stack_.pop_back();
+
+  if (op.type != AstType::BINOP && op.type != AstType::LOGICAL_OP) {
+    throw parse_error(fmt::format("Expected BINOP at: {}", describe(op)));
+  }
+  if (left.type != AstType::FACTOR && left.type != AstType::EXPR) {
+    throw parse_error(fmt::format("Expected an operand at: {}", describe(left)));
+  }
+  if (right.type != AstType::FACTOR && right.type != AstType::EXPR) {
+    throw parse_error(fmt::format("Expected an operand at: {}", describe(right)));
+  }
+  nodes_.push_back({FlatNodeType::expression, op.op, left.node, right.node});
+  stack_.push_back({AstType::EXPR, Operator::UNKNOWN, root()});
+}
+
+FlatAst::Entry FlatAst::reduce_all(size_t base) {
+  // Flatten out any repeating logical conditions here,  we should end with
+  // one single tree node at the root.
+  while (stack_.size() - base > 1) {
+    reduce(base);
+  }
+  if (stack_.size() - base != 1) {
+    throw parse_error(
+        fmt::format("The Stack size should be one at the root, we have: ", stack_.size() - base));
+  }
+  const auto e = stack_.back();
+  stack_.pop_back();
+  if (e.type != AstType::FACTOR && e.type != AstType::EXPR) {
+    throw parse_error(fmt::format("Expected an operand at: {}", describe(e)));
+  }
+  return e;
 }
 
-std::unique_ptr<AstNode> Ast::parseExpression(std::vector<Token>::iterator& it,
-                                              const std::vector<Token>::iterator& end) {
-  std::stack<std::unique_ptr<AstNode>> stack;
+FlatAst::Entry FlatAst::parse_expression(token_iterator& it, const token_iterator& end) {
+  const auto base = stack_.size();
   for (; it != end; ++it) {
     switch (it->type) { 
-    case TokenType::rparen: {
+    case TokenType::rparen:
       // If we have a right parens, we are no longer in an expression.
       // exit now before advancing it;
-
-      // Flatten out any repeating logical conditions here,  we should end with
-      // one single tree node at the root.
-      while (stack.size() > 1) {
-        if (!reduce(stack)) {
-          break;
-        }
-      }
-      if (stack.size() != 1) {
-        throw parse_error(
-            fmt::format("The Stack size should be one at the root, we have: ", stack.size()));
-      }
-      return std::move(stack.top());
-    }
+      return reduce_all(base);
     case TokenType::comment:
       // skip
       LOG(INFO) << "comment: " << it->lexeme;
@@ -285,16 +324,14 @@ std::unique_ptr<AstNode> Ast::parseExpression(std::vector<Token>::iterator& it,
     case TokenType::character:
     case TokenType::number:
     case TokenType::identifier: {
-      const auto l = it->lexeme;
-      if (l.empty()) {
-        return std::make_unique<ErrorNode>(
-            StrCat("Unable to parse expression starting at: ", it->lexeme));
+      if (it->lexeme.empty()) {
+        throw parse_error(StrCat("Unable to parse expression starting at: ", it->lexeme));
       }
-      const auto nr = need_reduce(stack, false);
-      stack.push(createFactor(*it));
+      const auto nr = need_reduce(base, false);
+      stack_.push_back(factor(*it));
       if (nr) {
         // One identifier and one operator
-        reduce(stack);
+        reduce(base);
       }
     } break;
     case TokenType::add:
@@ -307,148 +344,164 @@ std::unique_ptr<AstNode> Ast::parseExpression(std::vector<Token>::iterator& it,
     case TokenType::lt:
     case TokenType::mul:
     case TokenType::ne:
-    case TokenType::sub: {
-      stack.push(createBinaryOperator(*it));
-    } break;
+    case TokenType::sub:
+      stack_.push_back({AstType::BINOP, binary_operator(*it), -1});
+      break;
     case TokenType::logical_or: 
-    case TokenType::logical_and: {
-      stack.push(createLogicalOperator(*it));
-    } break;
-    default: {
-      LOG(INFO) << "Unexpected token: " << *it;
-    } break;
+    case TokenType::logical_and:
+      stack_.push_back({AstType::LOGICAL_OP, logical_operator(*it), -1});
+      break;
+    default:
       // ignore
-    }
-  }
-  // Flatten out any repeating logical conditions here,  we should end with
-  // one single tree node at the root.
-  while (stack.size() > 1) {
-    if (!reduce(stack)) {
+      LOG(INFO) << "Unexpected token: " << *it;
       break;
     }
   }
-  if (stack.size() != 1) {
-    throw parse_error(
-        fmt::format("The Stack size should be one at the root, we have: ", stack.size()));
-  }
-  return std::move(stack.top());
+  return reduce_all(base);
 }
 
-std::unique_ptr<AstNode> Ast::parseGroup(std::vector<Token>::iterator& it,
-                                         const std::vector<Token>::iterator& end) {
-  if (it+1 == end) {
-    return std::make_unique<ErrorNode>(
-        StrCat("Unable to parse expression starting at: ", it->lexeme));
+FlatAst::Entry FlatAst::parse_group(token_iterator& it, const token_iterator& end) {
+  if (it + 1 == end) {
+    throw parse_error(StrCat("Unable to parse expression starting at: ", it->lexeme));
   }
   // Skip left paren
   ++it;
 
-  std::stack<std::unique_ptr<AstNode>> stack;
+  const auto base = stack_.size();
   while (it != end && it->type != TokenType::rparen) {
-    auto expr = parseExpression(it, end);
-    if (!expr) {
-      return std::make_unique<ErrorNode>(
-          StrCat("Unable to parse expression starting at: ", it->lexeme));
-    }
-    stack.push(std::move(expr));
+    stack_.push_back(parse_expression(it, end));
     if (it == end || it->type != TokenType::rparen) {
       VLOG(1) << "Missing right parens";
       const auto pos = it == end ? "end" : it->lexeme;
-      return std::make_unique<ErrorNode>(StrCat("Missing right parens at: ", pos));
+      throw parse_error(StrCat("Missing right parens at: ", pos));
     }
   }
-  // Flatten out any repeating logical conditions here,  we should end with
-  // one single tree node at the root.
-  while (stack.size() > 1) {
-    if (!reduce(stack)) {
+  return reduce_all(base);
+}
+
+void FlatAst::parse(const token_iterator& begin, const token_iterator& end) {
+  const auto base = stack_.size();
+  for (auto it = begin; it != end;) {
+    const auto& t = *it;
+    switch (t.type) { 
+    case TokenType::lparen: {
+      auto expr = parse_group(it, end);
+      if (it == end) {
+        throw parse_error(StrCat("Unable to parse expression starting at: ", to_string(t)));
+      }
+      stack_.push_back(expr);
+    } break;
+
+    case TokenType::logical_and:
+    case TokenType::logical_or:
+      stack_.push_back({AstType::LOGICAL_OP, logical_operator(*it), -1});
       break;
+
+    default: {
+      // Try to reduce.
+      const auto nr = need_reduce(base, true);
+      stack_.push_back(parse_expression(it, end));
+      if (nr) {
+        reduce(base);
+      }
+    } break;
+    }
+
+    if (it != end) {
+      ++it;
     }
   }
-  if (stack.size() != 1) {
+  // Unlike within an expression, what is left is not reduced here.
+  if (stack_.size() - base != 1) {
     throw parse_error(
-        fmt::format("The Stack size should be one at the root, we have: ", stack.size()));
+        fmt::format("The Stack size should be one at the root, we have: ", stack_.size() - base));
+  }
+  const auto root = stack_.back();
+  stack_.pop_back();
+  // The root must be the last node made, as FlatAst::root() assumes.
+  if ((root.type != AstType::FACTOR && root.type != AstType::EXPR) ||
+      root.node != this->root()) {
+    throw parse_error(fmt::format("Expected an expression at: {}", describe(root)));
   }
-  return std::move(stack.top());
 }
 
-/** 
- * True if we need to reduce the stack.  We only allow logical_operations to trigger
- * reduce if we are between expressions (this happens at parse, not at parseExpression
- */
-// ReSharper disable once CppMemberFunctionMayBeStatic
-bool Ast::need_reduce(const std::stack<std::unique_ptr<AstNode>>& stack, bool allow_logical) {
-  if (stack.empty()) {
-    return false;
+bool FlatAst::parse(const Lexer& l) {
+  const auto& tokens = l.tokens();
+  nodes_.clear();
+  nodes_.reserve(tokens.size());
+  strings_.clear();
+  // A power of two at least twice the number of tokens, so the table is
+  // never more than half full.
+  size_t table_size = 16;
+  while (table_size < tokens.size() * 2) {
+    table_size *= 2;
   }
-  const auto t = stack.top()->ast_type();
-  const auto nr = t == AstType::BINOP;
-  if (allow_logical && t == AstType::LOGICAL_OP) {
+  interned_.assign(table_size, {0, -1});
+  stack_.clear();
+  error_.clear();
+  tree_.reset();
+  try {
+    parse(std::begin(tokens), std::end(tokens));
     return true;
+  } catch (const parse_error& e) {
+    nodes_.clear();
+    error_ = e.what();
+    return false;
   }
-  return nr;
-}  
-
-std::unique_ptr<RootNode> Ast::parse(
-    std::vector<Token>::iterator& begin, const std::vector<Token>::iterator& end) {
-  std::stack<std::unique_ptr<AstNode>> stack;
-  try {
-    for (auto it = begin; it != end;) {
-      const auto& t = *it;
-      switch (t.type) { 
-      case TokenType::lparen: {
-        auto expr = parseGroup(it, end);
-        if (!expr || it == end) {
-          return std::make_unique<RootNode>(std::make_unique<ErrorNode>(
-              StrCat("Unable to parse expression starting at: ", t)));
-        }
-        stack.push(std::move(expr));
-        } break;
-
-      case TokenType::logical_and:
-      case TokenType::logical_or: {
-        stack.push(createLogicalOperator(*it));
-      } break;
-
-      default: {
-        // Try to reduce.
-        const auto nr = need_reduce(stack, true);
-        auto expr = parseExpression(it, end);
-        if (!expr) {
-          return std::make_unique<RootNode>(std::make_unique<ErrorNode>(
-              StrCat("Unable to parse expression starting at: ", t)));
-        }
-        stack.push(std::move(expr));
-        if (nr) {
-          reduce(stack);
-        }
-      } break;
-      }
+}
 
-      if (it != end) {
-        ++it;
-      }
-    }
-    if (stack.size() != 1) {
-      throw parse_error(
-          fmt::format("The Stack size should be one at the root, we have: ", stack.size()));
+std::unique_ptr<AstNode> FlatAst::to_tree() const {
+  if (nodes_.empty()) {
+    return std::make_unique<ErrorNode>(error_);
+  }
+  // Made in the order of the array, which is the order the parser made
+  // them, so each operand is ready when its operator is reached.
+  std::vector<std::unique_ptr<Expression>> made(nodes_.size());
+  for (size_t i = 0; i < nodes_.size(); i++) {
+    const auto& n = nodes_[i];
+    switch (n.type) {
+    case FlatNodeType::int_value:
+      made[i] = std::make_unique<Number>(n.int_value());
+      break;
+    case FlatNodeType::string_val:
+      made[i] = std::make_unique<String>(std::string(text(n)));
+      break;
+    case FlatNodeType::variable:
+      made[i] = std::make_unique<Variable>(std::string(text(n)));
+      break;
+    case FlatNodeType::expression:
+      made[i] = std::make_unique<Expression>(std::move(made[n.left()]), n.op,
+                                             std::move(made[n.right()]));
+      break;
     }
-    return std::make_unique<RootNode>(std::move(stack.top()));
-  } catch (const parse_error& e) {
-    return std::make_unique<RootNode>(std::make_unique<ErrorNode>(e.what()));
   }
+  return std::move(made.back());
 }
 
-bool Ast::parse(const Lexer& l) {
-  auto tokens = l.tokens();
-  auto it = std::begin(tokens);
-  root_ = parse(it, std::end(tokens));
-  if (!root_) {
-    return false;
+void FlatAst::accept(AstVisitor* visitor) {
+  if (!tree_) {
+    tree_ = to_tree();
   }
+  tree_->accept(visitor);
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Ast
+
+bool Ast::parse(const Lexer& l) {
+  flat_.parse(l);
+  parsed_ = true;
+  root_.reset();
   return true;
 }
 
-AstNode* Ast::root() const { 
+AstNode* Ast::root() {
+  if (!parsed_) {
+    return nullptr;
+  }
+  if (!root_) {
+    root_ = std::make_unique<RootNode>(flat_.to_tree());
+  }
   return root_->node.get();
 }
 
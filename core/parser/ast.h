@@ -21,10 +21,12 @@
 
 #include "core/parser/lexer.h"
 #include "core/parser/token.h"
+#include <cstdint>
 #include <memory>
-#include <stack>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace wwiv::core::parser {
@@ -184,23 +186,117 @@ public:
   virtual void visit(Factor* n) = 0;
 };
 
+enum class FlatNodeType : uint8_t { int_value, string_val, variable, expression };
+
+/**
+ * One node of a FlatAst: a factor, or an expression applying op to two
+ * nodes that come before it in the array.
+ */
+struct FlatNode {
+  FlatNodeType type;
+  Operator op;
+  // expression: the indexes of the left and right operands.  int_value: a
+  // is the value.  string_val and variable: a and b are the offset and
+  // length of the text in the FlatAst's string pool.
+  int32_t a;
+  int32_t b;
+
+  [[nodiscard]] int left() const noexcept { return a; }
+  [[nodiscard]] int right() const noexcept { return b; }
+  [[nodiscard]] int int_value() const noexcept { return a; }
+};
+
+/**
+ * An expression parsed into a single array of nodes, with the text of its
+ * factors interned in one string pool, so building it makes a few
+ * allocations however large the expression is.
+ *
+ * Nodes are stored in the order the parser makes them, so an operator's
+ * operands always come before it, the root is last, and walking the array
+ * in order visits the nodes as Expression::accept does: left, right and
+ * then the operator.  Evaluating an expression is one pass over the array.
+ */
+class FlatAst final {
+public:
+  FlatAst() = default;
+
+  // Parses the tokens of l.  Returns false, with error() set, when they do
+  // not form an expression.
+  bool parse(const Lexer& l);
+
+  [[nodiscard]] const std::vector<FlatNode>& nodes() const noexcept { return nodes_; }
+  // Index of the root node, or -1 when there is none.
+  [[nodiscard]] int root() const noexcept { return static_cast<int>(nodes_.size()) - 1; }
+  // The text of a string_val or variable node.
+  [[nodiscard]] std::string_view text(const FlatNode& n) const {
+    return std::string_view(strings_).substr(n.a, n.b);
+  }
+  [[nodiscard]] const std::string& error() const noexcept { return error_; }
+
+  // Builds the tree of Expression and Factor nodes for this expression, or
+  // an ErrorNode when it did not parse.  Each node is a separate
+  // allocation, so this is only for code using the tree.
+  [[nodiscard]] std::unique_ptr<AstNode> to_tree() const;
+  // Adapts an AstVisitor, which visits the nodes of the tree that to_tree()
+  // makes, in the order Expression::accept visits them.  Visitors are given
+  // Expression nodes, so the tree is made on the first call and kept until
+  // the next parse, and every visit sees the same nodes and ids.
+  void accept(AstVisitor* visitor);
+
+private:
+  // An entry on the parse stack: an operand, which is a node, or an
+  // operator waiting for its right operand.
+  struct Entry {
+    // FACTOR or EXPR for operands, otherwise BINOP or LOGICAL_OP.
+    AstType type;
+    Operator op;
+    int node;
+  };
+  typedef std::vector<Token>::const_iterator token_iterator;
+
+  // Each of these works on the entries of stack_ above base, which the
+  // caller owns, leaving the stack at base on return.
+  Entry parse_expression(token_iterator& it, const token_iterator& end);
+  Entry parse_group(token_iterator& it, const token_iterator& end);
+  void parse(const token_iterator& begin, const token_iterator& end);
+  bool need_reduce(size_t base, bool allow_logical) const;
+  void reduce(size_t base);
+  // Reduces the entries above base to the one operand they must make,
+  // and pops it.
+  Entry reduce_all(size_t base);
+  Entry factor(const Token& token);
+  // Offset of s in the string pool, adding it if it is not there.
+  int32_t intern(const std::string& s);
+  std::string describe(const Entry& e) const;
+
+  std::vector<FlatNode> nodes_;
+  std::string strings_;
+  // Hash table of the strings in strings_, as offset and length (-1 for an
+  // empty slot), so interning does not search the whole pool.  Sized in
+  // parse() for every token to be a different string.
+  std::vector<std::pair<int32_t, int32_t>> interned_;
+  std::vector<Entry> stack_;
+  std::string error_;
+  // The tree accept() visits, made on its first call.
+  std::unique_ptr<AstNode> tree_;
+};
+
 class Ast final {
 public:
   Ast() = default;
-  
+
+  // Parses the tokens of l into flat().  The tree is not built until root()
+  // is called, so callers that only use flat() never pay for it.
   bool parse(const Lexer& l);
-  AstNode* root() const;
+  // The tree for the expression, built from flat() on the first call after
+  // parse(), or null before parse().  When the tokens do not form an
+  // expression it is an ErrorNode.
+  [[nodiscard]] AstNode* root();
+  [[nodiscard]] const FlatAst& flat() const noexcept { return flat_; }
 
 private:
-  [[nodiscard]] std::unique_ptr<AstNode> parseExpression(std::vector<Token>::iterator& begin,
-                                                         const std::vector<Token>::iterator& end);
-  [[nodiscard]] std::unique_ptr<AstNode> parseGroup(std::vector<Token>::iterator& begin,
-                                                    const std::vector<Token>::iterator& end);
-  [[nodiscard]] std::unique_ptr<RootNode> parse(std::vector<Token>::iterator& begin,
-                                                const std::vector<Token>::iterator& end);
-  bool need_reduce(const std::stack<std::unique_ptr<AstNode>>& stack, bool allow_logical);
-  bool reduce(std::stack<std::unique_ptr<AstNode>>& stack);
-
+  FlatAst flat_;
+  bool parsed_{false};
   std::unique_ptr<RootNode> root_;
 };
 
@@ -22,6 +22,7 @@
 #include "core/parser/ast.h"
 #include "core/parser/lexer.h"
 #include <string>
+#include <vector>
 
 using namespace wwiv::core;
 using namespace wwiv::core::parser;
@@ -157,3 +158,105 @@ TEST_F(AstTest, Visitor) {
   LOG(INFO) << "======================================================================";
   LOG(INFO) << root->ToString();
 }
+
+TEST_F(AstTest, TreeMadeOnFirstUse) {
+  Lexer l("user.sl>200");
+
+  Ast ast;
+  EXPECT_EQ(nullptr, ast.root());
+  ASSERT_TRUE(ast.parse(l));
+  EXPECT_EQ(2, ast.flat().root());
+  auto* root = dynamic_cast<Expression*>(ast.root());
+  EXPECT_TRUE(HasExpression(root, "user.sl", Operator::gt, "200"));
+  EXPECT_EQ(root, ast.root());
+}
+
+TEST_F(AstTest, Flat_Parens) {
+  Lexer l("(user.sl>200) || user.ar == 'A' || user.sl == 255");
+
+  FlatAst ast;
+  ASSERT_TRUE(ast.parse(l));
+  const auto& nodes = ast.nodes();
+  ASSERT_EQ(11u, nodes.size());
+  ASSERT_EQ(10, ast.root());
+
+  // Operands come before their operators, and the root is last.
+  const auto& root = nodes.at(ast.root());
+  EXPECT_EQ(FlatNodeType::expression, root.type);
+  EXPECT_EQ(Operator::logical_or, root.op);
+  const auto& left = nodes.at(root.left());
+  EXPECT_EQ(Operator::gt, left.op);
+  EXPECT_EQ("user.sl", ast.text(nodes.at(left.left())));
+  EXPECT_EQ(200, nodes.at(left.right()).int_value());
+  for (int i = 0; i < ast.root(); i++) {
+    if (nodes[i].type == FlatNodeType::expression) {
+      EXPECT_LT(nodes[i].left(), i);
+      EXPECT_LT(nodes[i].right(), i);
+    }
+  }
+
+  // Both uses of user.sl share the same text.
+  EXPECT_EQ(nodes.at(0).a, nodes.at(6).a);
+  EXPECT_EQ("user.sl", ast.text(nodes.at(6)));
+}
+
+TEST_F(AstTest, Flat_Error) {
+  Lexer l("user.sl = 10");
+
+  FlatAst ast;
+  EXPECT_FALSE(ast.parse(l));
+  EXPECT_EQ(-1, ast.root());
+  EXPECT_EQ("Assignment operators are not allowed.", ast.error());
+
+  auto tree = ast.to_tree();
+  EXPECT_EQ(AstType::AST_ERROR, tree->ast_type());
+}
+
+TEST_F(AstTest, Flat_InternsStrings) {
+  Lexer l("user.sl > 10 && user.sl < 20 && user.ar == \"user.sl\"");
+
+  FlatAst ast;
+  ASSERT_TRUE(ast.parse(l));
+  const auto& n = ast.nodes();
+  // Each occurrence of the same text shares one copy in the pool.
+  ASSERT_EQ(11u, n.size());
+  EXPECT_EQ(n[0].a, n[3].a);
+  EXPECT_EQ(n[0].a, n[7].a);
+  EXPECT_EQ(FlatNodeType::string_val, n[7].type);
+  EXPECT_EQ("user.sl", ast.text(n[7]));
+  EXPECT_EQ("user.ar", ast.text(n[6]));
+}
+
+TEST_F(AstTest, Flat_VisitorAdapter) {
+  Lexer l("((user.sl>200) || user.ar == 'A') || user.sl == 255");
+
+  class OrderVisitor : public AstVisitor {
+  public:
+    void visit(AstNode*) override { order += "?"; }
+    void visit(Expression* n) override {
+      order += "(" + to_string(n->op()) + ")";
+      ids.push_back(n->id());
+    }
+    void visit(Factor* n) override { order += n->value() + " "; }
+    std::string order;
+    std::vector<int> ids;
+  };
+
+  FlatAst flat;
+  ASSERT_TRUE(flat.parse(l));
+  OrderVisitor from_flat;
+  flat.accept(&from_flat);
+
+  Ast ast;
+  ASSERT_TRUE(ast.parse(l));
+  OrderVisitor from_tree;
+  ast.root()->accept(&from_tree);
+
+  EXPECT_EQ(from_tree.order, from_flat.order);
+  EXPECT_EQ("user.sl 200 (gt)user.ar A (eq)(or)user.sl 255 (eq)(or)", from_flat.order);
+
+  // The tree is only made once, so its ids do not change between visits.
+  OrderVisitor again;
+  flat.accept(&again);
+  EXPECT_EQ(from_flat.ids, again.ids);
+}
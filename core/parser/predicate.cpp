@@ -0,0 +1,251 @@
+/**************************************************************************/
+/*                                                                        */
+/*                              WWIV Version 5.x                          */
+/*               Copyright (C)2020-2022, WWIV Software Services           */
+/*                                                                        */
+/*    Licensed  under the  Apache License, Version  2.0 (the "License");  */
+/*    you may not use this  file  except in compliance with the License.  */
+/*    You may obtain a copy of the License at                             */
+/*                                                                        */
+/*                http://www.apache.org/licenses/LICENSE-2.0              */
+/*                                                                        */
+/*    Unless  required  by  applicable  law  or agreed to  in  writing,   */
+/*    software  distributed  under  the  License  is  distributed on an   */
+/*    "AS IS"  BASIS, WITHOUT  WARRANTIES  OR  CONDITIONS OF ANY  KIND,   */
+/*    either  express  or implied.  See  the  License for  the specific   */
+/*    language governing permissions and limitations under the License.   */
+/*                                                                        */
+/**************************************************************************/
+#include "core/parser/predicate.h"
+
+#include "core/parser/lexer.h"
+#include "core/strings.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <utility>
+
+using namespace wwiv::strings;
+
+namespace wwiv::core::parser {
+
+namespace {
+
+// Deep enough for any expression a person writes, so evaluating one needs
+// no allocation.
+constexpr int kStackSize = 32;
+
+int compare(const PredicateValue& l, const PredicateValue& r) {
+  if (l.is_string() && r.is_string()) {
+    return l.as_string().compare(r.as_string());
+  }
+  const auto li = l.as_int();
+  const auto ri = r.as_int();
+  return li < ri ? -1 : (li > ri ? 1 : 0);
+}
+
+PredicateValue apply(Operator op, const PredicateValue& l, const PredicateValue& r) {
+  // In 64 bits so no operation overflows before the result is truncated.
+  const int64_t li = l.as_int();
+  const int64_t ri = r.as_int();
+  switch (op) {
+  case Operator::add: return PredicateValue(static_cast<int>(li + ri));
+  case Operator::sub: return PredicateValue(static_cast<int>(li - ri));
+  case Operator::mul: return PredicateValue(static_cast<int>(li * ri));
+  case Operator::div: return PredicateValue(ri == 0 ? 0 : static_cast<int>(li / ri));
+  case Operator::gt: return PredicateValue(compare(l, r) > 0 ? 1 : 0);
+  case Operator::ge: return PredicateValue(compare(l, r) >= 0 ? 1 : 0);
+  case Operator::lt: return PredicateValue(compare(l, r) < 0 ? 1 : 0);
+  case Operator::le: return PredicateValue(compare(l, r) <= 0 ? 1 : 0);
+  case Operator::eq: return PredicateValue(compare(l, r) == 0 ? 1 : 0);
+  case Operator::ne: return PredicateValue(compare(l, r) != 0 ? 1 : 0);
+  default: return PredicateValue();
+  }
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////
+// PredicateValue
+
+int PredicateValue::as_int() const noexcept {
+  if (!is_string_) {
+    return i_;
+  }
+  int result = 0;
+  std::from_chars(s_.data(), s_.data() + s_.size(), result);
+  return result;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// VariableSlots
+
+int VariableSlots::add(const std::string& name) {
+  const auto [it, added] = slots_.emplace(name, static_cast<int>(slots_.size()));
+  return it->second;
+}
+
+int VariableSlots::slot(std::string_view name) const {
+  const auto it = slots_.find(name);
+  return it == std::end(slots_) ? -1 : it->second;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Predicate
+
+Predicate::Predicate(const std::string& text, const VariableSlots& slots) {
+  Lexer l(text);
+  if (!l.ok()) {
+    error_ = l.state_.err;
+    return;
+  }
+  FlatAst flat;
+  if (!flat.parse(l)) {
+    error_ = flat.error();
+    return;
+  }
+  if (flat.root() < 0) {
+    error_ = "Empty expression";
+    return;
+  }
+  max_depth_ = emit(flat, flat.root(), slots);
+  if (!error_.empty()) {
+    code_.clear();
+  }
+}
+
+int Predicate::emit(const FlatAst& flat, int node, const VariableSlots& slots) {
+  const auto& n = flat.nodes()[node];
+  switch (n.type) {
+  case FlatNodeType::int_value:
+    code_.push_back({OpCode::push_int, Operator::UNKNOWN, n.int_value(), 0});
+    return 1;
+  case FlatNodeType::string_val: {
+    const auto s = flat.text(n);
+    code_.push_back({OpCode::push_string, Operator::UNKNOWN, static_cast<int32_t>(strings_.size()),
+                     static_cast<int32_t>(s.size())});
+    strings_.append(s);
+    return 1;
+  }
+  case FlatNodeType::variable: {
+    const auto name = flat.text(n);
+    const auto slot = slots.slot(name);
+    if (slot < 0 && error_.empty()) {
+      error_ = StrCat("Unknown variable: ", name);
+    }
+    code_.push_back({OpCode::load, Operator::UNKNOWN, slot, 0});
+    return 1;
+  }
+  case FlatNodeType::expression:
+    break;
+  }
+  if (n.op == Operator::logical_and || n.op == Operator::logical_or) {
+    const auto left = emit(flat, n.left(), slots);
+    const auto jump = code_.size();
+    code_.push_back({n.op == Operator::logical_and ? OpCode::and_jump : OpCode::or_jump, n.op, 0, 0});
+    const auto right = emit(flat, n.right(), slots);
+    code_.push_back({OpCode::to_bool, n.op, 0, 0});
+    code_[jump].a = static_cast<int32_t>(code_.size());
+    return std::max(left, right);
+  }
+  const auto left = emit(flat, n.left(), slots);
+  const auto right = emit(flat, n.right(), slots);
+  code_.push_back({OpCode::binary, n.op, 0, 0});
+  return std::max(left, right + 1);
+}
+
+PredicateValue Predicate::evaluate(const PredicateValue* values, size_t count) const {
+  if (code_.empty()) {
+    return {};
+  }
+  std::array<PredicateValue, kStackSize> fixed;
+  std::vector<PredicateValue> grown;
+  auto* stack = fixed.data();
+  if (max_depth_ > kStackSize) {
+    grown.resize(max_depth_);
+    stack = grown.data();
+  }
+  const std::string_view strings(strings_);
+  // Index of the next free entry of stack.
+  int sp = 0;
+  size_t pc = 0;
+  while (pc < code_.size()) {
+    const auto& in = code_[pc++];
+    switch (in.code) {
+    case OpCode::push_int:
+      stack[sp++] = PredicateValue(in.a);
+      break;
+    case OpCode::push_string:
+      stack[sp++] = PredicateValue(strings.substr(in.a, in.b));
+      break;
+    case OpCode::load:
+      stack[sp++] = static_cast<size_t>(in.a) < count ? values[in.a] : PredicateValue();
+      break;
+    case OpCode::binary:
+      sp--;
+      stack[sp - 1] = apply(in.op, stack[sp - 1], stack[sp]);
+      break;
+    case OpCode::and_jump:
+      if (!stack[sp - 1].truthy()) {
+        stack[sp - 1] = PredicateValue(0);
+        pc = in.a;
+      } else {
+        sp--;
+      }
+      break;
+    case OpCode::or_jump:
+      if (stack[sp - 1].truthy()) {
+        stack[sp - 1] = PredicateValue(1);
+        pc = in.a;
+      } else {
+        sp--;
+      }
+      break;
+    case OpCode::to_bool:
+      stack[sp - 1] = PredicateValue(stack[sp - 1].truthy() ? 1 : 0);
+      break;
+    }
+  }
+  return stack[0];
+}
+
+///////////////////////////////////////////////////////////////////////////
+// PredicateCache
+
+PredicateCache::PredicateCache(VariableSlots slots, size_t capacity)
+    : slots_(std::move(slots)), capacity_(capacity) {}
+
+std::shared_ptr<const Predicate> PredicateCache::get(const std::string& text) {
+  std::lock_guard<std::mutex> lock(mu_);
+  if (const auto it = index_.find(text); it != std::end(index_)) {
+    hits_++;
+    entries_.splice(std::begin(entries_), entries_, it->second);
+    return it->second->second;
+  }
+  misses_++;
+  auto predicate = std::make_shared<const Predicate>(text, slots_);
+  entries_.emplace_front(text, predicate);
+  index_.emplace(entries_.front().first, std::begin(entries_));
+  if (entries_.size() > capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  return predicate;
+}
+
+size_t PredicateCache::size() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return entries_.size();
+}
+
+int64_t PredicateCache::hits() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return hits_;
+}
+
+int64_t PredicateCache::misses() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return misses_;
+}
+
+} // namespace wwiv::core::parser
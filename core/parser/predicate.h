@@ -0,0 +1,177 @@
+/**************************************************************************/
+/*                                                                        */
+/*                              WWIV Version 5.x                          */
+/*               Copyright (C)2020-2022, WWIV Software Services           */
+/*                                                                        */
+/*    Licensed  under the  Apache License, Version  2.0 (the "License");  */
+/*    you may not use this  file  except in compliance with the License.  */
+/*    You may obtain a copy of the License at                             */
+/*                                                                        */
+/*                http://www.apache.org/licenses/LICENSE-2.0              */
+/*                                                                        */
+/*    Unless  required  by  applicable  law  or agreed to  in  writing,   */
+/*    software  distributed  under  the  License  is  distributed on an   */
+/*    "AS IS"  BASIS, WITHOUT  WARRANTIES  OR  CONDITIONS OF ANY  KIND,   */
+/*    either  express  or implied.  See  the  License for  the specific   */
+/*    language governing permissions and limitations under the License.   */
+/*                                                                        */
+/**************************************************************************/
+#ifndef INCLUDED_WWIV_CORE_PREDICATE_H
+#define INCLUDED_WWIV_CORE_PREDICATE_H
+
+#include "core/parser/ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace wwiv::core::parser {
+
+/**
+ * A value a predicate works with: an integer or a string.  Strings are
+ * views, of the predicate's literals or of text the caller owns, so
+ * evaluating never allocates.
+ */
+class PredicateValue final {
+public:
+  constexpr PredicateValue() noexcept = default;
+  constexpr explicit PredicateValue(int i) noexcept : i_(i) {}
+  constexpr explicit PredicateValue(std::string_view s) noexcept : is_string_(true), s_(s) {}
+
+  [[nodiscard]] bool is_string() const noexcept { return is_string_; }
+  // The integer, or for a string the number it starts with, or 0.
+  [[nodiscard]] int as_int() const noexcept;
+  [[nodiscard]] std::string_view as_string() const noexcept { return s_; }
+  // Non zero integers and non empty strings are true.
+  [[nodiscard]] bool truthy() const noexcept { return is_string_ ? !s_.empty() : i_ != 0; }
+
+private:
+  bool is_string_{false};
+  int i_{0};
+  std::string_view s_;
+};
+
+/**
+ * The variables predicates may use, each with the slot its value is passed
+ * in when a predicate is evaluated.
+ */
+class VariableSlots final {
+public:
+  VariableSlots() = default;
+
+  // Adds name with the next free slot and returns its slot, or returns the
+  // slot it already has.
+  int add(const std::string& name);
+  // The slot of name, or -1 when it has none.
+  [[nodiscard]] int slot(std::string_view name) const;
+  [[nodiscard]] size_t size() const noexcept { return slots_.size(); }
+
+private:
+  std::map<std::string, int, std::less<>> slots_;
+};
+
+/**
+ * An expression compiled once into a short program for a stack machine, so
+ * it can be evaluated any number of times without lexing or parsing it
+ * again, or building the Expression tree.
+ *
+ * Variables are resolved to their slots when compiling, so evaluating one
+ * is an index into the values passed in.  Arithmetic is on integers, and
+ * comparisons are of strings when both sides are strings and of integers
+ * otherwise.  && and || short circuit, and yield 0 or 1.  Dividing by 0
+ * yields 0.
+ */
+class Predicate final {
+public:
+  // Compiles text.  ok() is false, with error() set, when it does not
+  // parse or uses a variable slots does not have.
+  Predicate(const std::string& text, const VariableSlots& slots);
+
+  [[nodiscard]] bool ok() const noexcept { return error_.empty(); }
+  [[nodiscard]] const std::string& error() const noexcept { return error_; }
+
+  // Evaluates the expression, with values[i] the value of the variable in
+  // slot i.  Variables with no value are 0, as is a predicate that is not
+  // ok().
+  [[nodiscard]] PredicateValue evaluate(const PredicateValue* values, size_t count) const;
+  [[nodiscard]] PredicateValue evaluate(const std::vector<PredicateValue>& values) const {
+    return evaluate(values.data(), values.size());
+  }
+  [[nodiscard]] bool matches(const std::vector<PredicateValue>& values) const {
+    return evaluate(values).truthy();
+  }
+
+private:
+  enum class OpCode : uint8_t {
+    push_int,
+    push_string,
+    load,
+    binary,
+    // Jumps to a when the top of the stack is false, leaving 0 as the
+    // result, or otherwise pops it.
+    and_jump,
+    // Jumps to a when the top of the stack is true, leaving 1 as the
+    // result, or otherwise pops it.
+    or_jump,
+    to_bool,
+  };
+  struct Instruction {
+    OpCode code;
+    Operator op;
+    // push_int: the value.  push_string: the offset and length of the text
+    // in strings_.  load: the slot.  and_jump, or_jump: the target.
+    int32_t a;
+    int32_t b;
+  };
+
+  // Emits the instructions for node, returning the stack depth they need.
+  int emit(const FlatAst& flat, int node, const VariableSlots& slots);
+
+  std::vector<Instruction> code_;
+  std::string strings_;
+  int max_depth_{0};
+  std::string error_;
+};
+
+/**
+ * Compiled predicates for the most recently used expression texts, so an
+ * expression evaluated again and again, such as the same condition for
+ * each user, is only compiled the first time.  Expressions that do not
+ * compile are kept too, so they are not parsed again either.
+ */
+class PredicateCache final {
+public:
+  PredicateCache(VariableSlots slots, size_t capacity);
+
+  // The predicate for text, compiling it when it is not in the cache, and
+  // dropping the least recently used one when the cache is full.  The
+  // predicate stays valid after it is dropped.
+  [[nodiscard]] std::shared_ptr<const Predicate> get(const std::string& text);
+
+  [[nodiscard]] size_t size() const;
+  [[nodiscard]] int64_t hits() const;
+  [[nodiscard]] int64_t misses() const;
+
+private:
+  typedef std::list<std::pair<std::string, std::shared_ptr<const Predicate>>> entry_list;
+
+  const VariableSlots slots_;
+  const size_t capacity_;
+  mutable std::mutex mu_;
+  // Most recently used first.
+  entry_list entries_;
+  // Keys view the text of their entry.
+  std::unordered_map<std::string_view, entry_list::iterator> index_;
+  int64_t hits_{0};
+  int64_t misses_{0};
+};
+
+} // namespace wwiv::core::parser
+
+#endif
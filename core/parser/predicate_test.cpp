@@ -0,0 +1,121 @@
+/**************************************************************************/
+/*                                                                        */
+/*                              WWIV Version 5.x                          */
+/*               Copyright (C)2020-2022, WWIV Software Services           */
+/*                                                                        */
+/*    Licensed  under the  Apache License, Version  2.0 (the "License");  */
+/*    you may not use this  file  except in compliance with the License.  */
+/*    You may obtain a copy of the License at                             */
+/*                                                                        */
+/*                http://www.apache.org/licenses/LICENSE-2.0              */
+/*                                                                        */
+/*    Unless  required  by  applicable  law  or agreed to  in  writing,   */
+/*    software  distributed  under  the  License  is  distributed on an   */
+/*    "AS IS"  BASIS, WITHOUT  WARRANTIES  OR  CONDITIONS OF ANY  KIND,   */
+/*    either  express  or implied.  See  the  License for  the specific   */
+/*    language governing permissions and limitations under the License.   */
+/*                                                                        */
+/**************************************************************************/
+#include "gtest/gtest.h"
+
+#include "core/parser/predicate.h"
+#include <string>
+#include <vector>
+
+using namespace wwiv::core::parser;
+
+class PredicateTest : public ::testing::Test {
+public:
+  PredicateTest() {
+    slots.add("user.sl");
+    slots.add("user.name");
+    slots.add("user.age");
+  }
+
+  bool Matches(const std::string& text) {
+    Predicate p(text, slots);
+    EXPECT_TRUE(p.ok()) << p.error();
+    return p.matches(values);
+  }
+
+  VariableSlots slots;
+  std::vector<PredicateValue> values{PredicateValue(200), PredicateValue("Rushfan"),
+                                     PredicateValue(30)};
+};
+
+TEST_F(PredicateTest, Slots) {
+  EXPECT_EQ(0, slots.slot("user.sl"));
+  EXPECT_EQ(2, slots.slot("user.age"));
+  EXPECT_EQ(-1, slots.slot("user.dsl"));
+  EXPECT_EQ(1, slots.add("user.name"));
+  EXPECT_EQ(3u, slots.size());
+}
+
+TEST_F(PredicateTest, Compare) {
+  EXPECT_TRUE(Matches("user.sl > 100"));
+  EXPECT_FALSE(Matches("user.sl < 100"));
+  EXPECT_TRUE(Matches("user.sl >= 200"));
+  EXPECT_TRUE(Matches("user.sl != 201"));
+  EXPECT_TRUE(Matches("user.name == \"Rushfan\""));
+  EXPECT_FALSE(Matches("user.name == \"rushfan\""));
+}
+
+TEST_F(PredicateTest, Arithmetic) {
+  Predicate p("user.age * 2 + 5", slots);
+  ASSERT_TRUE(p.ok()) << p.error();
+  EXPECT_EQ(65, p.evaluate(values).as_int());
+  EXPECT_EQ(0, Predicate("user.age / 0", slots).evaluate(values).as_int());
+}
+
+TEST_F(PredicateTest, Logical) {
+  EXPECT_TRUE(Matches("user.sl > 100 && user.age == 30"));
+  EXPECT_FALSE(Matches("user.sl > 100 && user.age == 31"));
+  EXPECT_TRUE(Matches("user.sl < 100 || user.age == 30"));
+  EXPECT_FALSE(Matches("user.sl < 100 || user.age == 31"));
+  EXPECT_TRUE(Matches("(user.sl < 100 || user.age == 30) && user.name == \"Rushfan\""));
+  EXPECT_EQ(1, Predicate("user.sl || 0", slots).evaluate(values).as_int());
+}
+
+TEST_F(PredicateTest, MissingValues) {
+  Predicate p("user.age == 0", slots);
+  ASSERT_TRUE(p.ok()) << p.error();
+  EXPECT_TRUE(p.matches({}));
+  EXPECT_FALSE(p.matches(values));
+}
+
+TEST_F(PredicateTest, Errors) {
+  Predicate unknown("user.dsl > 10", slots);
+  EXPECT_FALSE(unknown.ok());
+  EXPECT_EQ("Unknown variable: user.dsl", unknown.error());
+  EXPECT_FALSE(unknown.matches(values));
+
+  Predicate bad("user.sl >", slots);
+  EXPECT_FALSE(bad.ok());
+  EXPECT_FALSE(bad.matches(values));
+}
+
+TEST_F(PredicateTest, Cache) {
+  PredicateCache cache(slots, 2);
+  const auto a = cache.get("user.sl > 100");
+  EXPECT_EQ(a, cache.get("user.sl > 100"));
+  EXPECT_TRUE(a->matches(values));
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+
+  EXPECT_NE(nullptr, cache.get("user.age < 10"));
+  // a is the least recently used once it is used again.
+  EXPECT_NE(nullptr, cache.get("user.sl > 100"));
+  EXPECT_NE(nullptr, cache.get("user.name == \"Rushfan\""));
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_EQ(a, cache.get("user.sl > 100"));
+  EXPECT_EQ(3, cache.misses());
+  EXPECT_NE(nullptr, cache.get("user.age < 10"));
+  EXPECT_EQ(4, cache.misses());
+}
+
+TEST_F(PredicateTest, Cache_KeepsErrors) {
+  PredicateCache cache(slots, 2);
+  EXPECT_FALSE(cache.get("user.sl >")->ok());
+  EXPECT_FALSE(cache.get("user.sl >")->ok());
+  EXPECT_EQ(1, cache.misses());
+}
@@ -49,7 +49,7 @@ int main(int argc, const char* argv[]) {
   wwivbasic::FunctionDefVisitor fd(context);
   fd.visit(tree);
 
-  context.module->native_functionl("PRINT", [](std::vector<Value> args) -> Value {
+  context.module->native_functionl("PRINT", [](Args args) -> Value {
     for (const auto& arg : args) {
       std::cout << arg.toString() << " ";
     }
@@ -0,0 +1,111 @@
+#include "array.h"
+#include "core/strings.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+
+namespace wwivbasic {
+
+using namespace wwiv::strings;
+
+Array::Array(Value::Type type, size_t size) : type_(type) {
+  if (type_ == Value::Type::STRING) {
+    strings_.resize(size);
+  } else {
+    ints_.resize(size);
+  }
+}
+
+Array::Array(const Array& that) : type_(that.type_), ints_(that.ints_), strings_(that.strings_) {}
+
+void Array::unref() noexcept {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
+Value Array::get(size_t i) const {
+  switch (type_) {
+  case Value::Type::STRING: return strings_[i];
+  case Value::Type::BOOLEAN: return Value(ints_[i] != 0);
+  default: return Value(ints_[i]);
+  }
+}
+
+void Array::set(size_t i, const Value& v) {
+  switch (type_) {
+  case Value::Type::STRING:
+    if (v.is_string()) {
+      strings_[i] = v;
+    } else {
+      char buf[16];
+      strings_[i] = Value(v.text(buf));
+    }
+    break;
+  case Value::Type::BOOLEAN:
+    ints_[i] = v.toBool() ? 1 : 0;
+    break;
+  default:
+    ints_[i] = v.toInt();
+    break;
+  }
+}
+
+int64_t Array::sum() const noexcept {
+  if (type_ == Value::Type::STRING) {
+    int64_t total = 0;
+    for (const auto& s : strings_) {
+      total += s.toInt();
+    }
+    return total;
+  }
+  return std::accumulate(std::begin(ints_), std::end(ints_), int64_t{0});
+}
+
+void Array::fill(const Value& v) {
+  if (type_ == Value::Type::STRING) {
+    char buf[16];
+    std::fill(std::begin(strings_), std::end(strings_), v.is_string() ? v : Value(v.text(buf)));
+    return;
+  }
+  std::fill(std::begin(ints_), std::end(ints_),
+            type_ == Value::Type::BOOLEAN ? (v.toBool() ? 1 : 0) : v.toInt());
+}
+
+int Array::find(const Value& v) const {
+  if (type_ == Value::Type::STRING) {
+    char buf[16];
+    const auto s = v.text(buf);
+    const auto it = std::find_if(std::begin(strings_), std::end(strings_),
+                                 [s](const Value& e) { return e.view() == s; });
+    return it == std::end(strings_) ? -1 : static_cast<int>(it - std::begin(strings_));
+  }
+  const int32_t n = type_ == Value::Type::BOOLEAN ? (v.toBool() ? 1 : 0) : v.toInt();
+  const auto it = std::find(std::begin(ints_), std::end(ints_), n);
+  return it == std::end(ints_) ? -1 : static_cast<int>(it - std::begin(ints_));
+}
+
+void Array::sort() {
+  if (type_ == Value::Type::STRING) {
+    std::sort(std::begin(strings_), std::end(strings_),
+              [](const Value& a, const Value& b) { return a.view() < b.view(); });
+    return;
+  }
+  std::sort(std::begin(ints_), std::end(ints_));
+}
+
+std::optional<Value::Type> element_type(const std::string& name) {
+  if (iequals(name, "INTEGER")) {
+    return Value::Type::INTEGER;
+  }
+  if (iequals(name, "STRING")) {
+    return Value::Type::STRING;
+  }
+  if (iequals(name, "BOOLEAN")) {
+    return Value::Type::BOOLEAN;
+  }
+  return std::nullopt;
+}
+
+} // namespace wwivbasic
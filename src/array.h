@@ -0,0 +1,70 @@
+#pragma once
+
+#include "value.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wwivbasic {
+
+/**
+ * The elements of a DIM array.
+ *
+ * All the elements have the array's type, and are stored contiguously:
+ * integers and booleans (as 0 or 1) in a vector of int32_t, and strings as
+ * string Values.  Storing an element converts it to the array's type.
+ *
+ * Arrays are shared between Values by reference count, and a Value copies
+ * a shared array before changing it, so arrays have value semantics like
+ * every other Value.  The bulk operations are plain loops over the
+ * elements, with no per element dispatch on their type.
+ */
+class Array {
+public:
+  Array(Value::Type type, size_t size);
+  Array(const Array& that);
+  Array& operator=(const Array&) = delete;
+
+  Value::Type type() const noexcept { return type_; }
+  size_t size() const noexcept {
+    return type_ == Value::Type::STRING ? strings_.size() : ints_.size();
+  }
+  bool in_range(int i) const noexcept { return i >= 0 && static_cast<size_t>(i) < size(); }
+
+  // Element i, which must be in range.
+  Value get(size_t i) const;
+  // Sets element i, which must be in range, to v converted to this
+  // array's type.
+  void set(size_t i, const Value& v);
+
+  // Sum of the elements, as integers.
+  int64_t sum() const noexcept;
+  void fill(const Value& v);
+  // Index of the first element equal to v, or -1.
+  int find(const Value& v) const;
+  // Sorts into ascending order, FALSE before TRUE.
+  void sort();
+
+  void ref() noexcept { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void unref() noexcept;
+  // True when the caller holds the only reference, so may modify this array.
+  bool unique() const noexcept { return refs_.load(std::memory_order_acquire) == 1; }
+
+private:
+  std::atomic<int32_t> refs_{1};
+  const Value::Type type_;
+  // INTEGER and BOOLEAN elements.
+  std::vector<int32_t> ints_;
+  // STRING elements.
+  std::vector<Value> strings_;
+};
+
+// The element type named by name in DIM name[size] AS type: INTEGER, STRING
+// or BOOLEAN, in any case.
+std::optional<Value::Type> element_type(const std::string& name);
+
+} // namespace wwivbasic
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "value.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wwivbasic::ast {
+
+// Compact, ANTLR free representation of a BASIC source unit.  The parse tree
+// is lowered into this form once, and the compiler works from it.
+
+enum class ExprKind { INT, STRING, BOOLEAN, VARIABLE, CALL, BINARY, INDEX, DICT };
+
+enum class BinaryOp { ADD, SUB, MUL, DIV, MOD, AND, OR, EQ, NE, LT, LE, GT, GE };
+
+class Expr {
+public:
+  Expr(ExprKind k, int l) : kind(k), line(l) {}
+  virtual ~Expr() = default;
+
+  const ExprKind kind;
+  int line{0};
+};
+
+class IntLiteral final : public Expr {
+public:
+  IntLiteral(int v, int l) : Expr(ExprKind::INT, l), value(v) {}
+  int value;
+};
+
+class StringLiteral final : public Expr {
+public:
+  StringLiteral(std::string v, int l) : Expr(ExprKind::STRING, l), value(std::move(v)) {}
+  std::string value;
+};
+
+class BoolLiteral final : public Expr {
+public:
+  BoolLiteral(bool v, int l) : Expr(ExprKind::BOOLEAN, l), value(v) {}
+  bool value;
+};
+
+class VariableRef final : public Expr {
+public:
+  VariableRef(std::string n, int l) : Expr(ExprKind::VARIABLE, l), name(std::move(n)) {}
+  std::string name;
+};
+
+class CallExpr final : public Expr {
+public:
+  CallExpr(std::string n, int l) : Expr(ExprKind::CALL, l), name(std::move(n)) {}
+  std::string name;
+  std::vector<std::unique_ptr<Expr>> args;
+};
+
+// name[index]: an element of an array, or the value for a key of a
+// dictionary.
+class IndexExpr final : public Expr {
+public:
+  IndexExpr(std::string n, std::unique_ptr<Expr>&& i, int l)
+      : Expr(ExprKind::INDEX, l), name(std::move(n)), index(std::move(i)) {}
+  std::string name;
+  std::unique_ptr<Expr> index;
+};
+
+class DictEntry {
+public:
+  std::unique_ptr<Expr> key;
+  std::unique_ptr<Expr> value;
+};
+
+// { key : value, ... }
+class DictExpr final : public Expr {
+public:
+  explicit DictExpr(int l) : Expr(ExprKind::DICT, l) {}
+  std::vector<DictEntry> entries;
+};
+
+class BinaryExpr final : public Expr {
+public:
+  BinaryExpr(BinaryOp o, std::unique_ptr<Expr>&& lhs, std::unique_ptr<Expr>&& rhs, int l)
+      : Expr(ExprKind::BINARY, l), op(o), left(std::move(lhs)), right(std::move(rhs)) {}
+  BinaryOp op;
+  std::unique_ptr<Expr> left;
+  std::unique_ptr<Expr> right;
+};
+
+enum class StmtKind { ASSIGN, CALL, IF, FOR, BREAK, RETURN, IMPORT, DIM };
+
+class Stmt {
+public:
+  Stmt(StmtKind k, int l) : kind(k), line(l) {}
+  virtual ~Stmt() = default;
+
+  const StmtKind kind;
+  int line{0};
+};
+
+typedef std::vector<std::unique_ptr<Stmt>> Block;
+
+class AssignStmt final : public Stmt {
+public:
+  AssignStmt(std::string n, std::unique_ptr<Expr>&& v, int l)
+      : Stmt(StmtKind::ASSIGN, l), name(std::move(n)), value(std::move(v)) {}
+  std::string name;
+  // Null unless assigning to an element of an array or dictionary,
+  // name[index].
+  std::unique_ptr<Expr> index;
+  std::unique_ptr<Expr> value;
+};
+
+class CallStmt final : public Stmt {
+public:
+  CallStmt(std::unique_ptr<CallExpr>&& c, int l) : Stmt(StmtKind::CALL, l), call(std::move(c)) {}
+  std::unique_ptr<CallExpr> call;
+};
+
+class IfBranch {
+public:
+  std::unique_ptr<Expr> condition;
+  Block body;
+};
+
+// IF/ELSEIF/ELSE chain.  The first branch is the IF clause.
+class IfStmt final : public Stmt {
+public:
+  explicit IfStmt(int l) : Stmt(StmtKind::IF, l) {}
+  std::vector<IfBranch> branches;
+  bool has_else{false};
+  Block else_body;
+};
+
+class ForStmt final : public Stmt {
+public:
+  ForStmt(std::string v, int l) : Stmt(StmtKind::FOR, l), var(std::move(v)) {}
+  std::string var;
+  std::unique_ptr<Expr> start;
+  std::unique_ptr<Expr> end;
+  // Null for the default STEP of 1.
+  std::unique_ptr<Expr> step;
+  Block body;
+};
+
+// Leaves the innermost FOR loop.
+class BreakStmt final : public Stmt {
+public:
+  explicit BreakStmt(int l) : Stmt(StmtKind::BREAK, l) {}
+};
+
+class ReturnStmt final : public Stmt {
+public:
+  ReturnStmt(std::unique_ptr<Expr>&& v, int l) : Stmt(StmtKind::RETURN, l), value(std::move(v)) {}
+  std::unique_ptr<Expr> value;
+};
+
+// IMPORT @module or IMPORT "file"
+class ImportStmt final : public Stmt {
+public:
+  ImportStmt(std::string n, bool f, int l) : Stmt(StmtKind::IMPORT, l), name(std::move(n)), file(f) {}
+  std::string name;
+  bool file{false};
+};
+
+// DIM name[size] AS type
+class DimStmt final : public Stmt {
+public:
+  DimStmt(std::string n, Value::Type t, std::unique_ptr<Expr>&& s, int l)
+      : Stmt(StmtKind::DIM, l), name(std::move(n)), type(t), size(std::move(s)) {}
+  std::string name;
+  Value::Type type;
+  std::unique_ptr<Expr> size;
+};
+
+class ProcedureDef {
+public:
+  std::string name;
+  // Name of the module from the closest preceding MODULE statement.
+  std::string module;
+  std::vector<std::string> params;
+  Block body;
+  int line{0};
+};
+
+class Unit {
+public:
+  std::string filename;
+  Block statements;
+  std::vector<ProcedureDef> procedures;
+};
+
+} // namespace wwivbasic::ast
@@ -0,0 +1,278 @@
+#include "ast_builder.h"
+#include "BasicLexer.h"
+#include "array.h"
+#include "utils.h"
+#include "core/strings.h"
+#include "fmt/format.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace wwivbasic {
+
+using namespace wwiv::strings;
+
+static int line_of(antlr4::ParserRuleContext* ctx) {
+  return ctx->getStart() ? static_cast<int>(ctx->getStart()->getLine()) : 0;
+}
+
+static ast::BinaryOp to_binary_op(size_t token_type) {
+  switch (token_type) {
+  case BasicLexer::PLUS: return ast::BinaryOp::ADD;
+  case BasicLexer::MINUS: return ast::BinaryOp::SUB;
+  case BasicLexer::STAR: return ast::BinaryOp::MUL;
+  case BasicLexer::SLASH: return ast::BinaryOp::DIV;
+  case BasicLexer::MOD: return ast::BinaryOp::MOD;
+  case BasicLexer::EQ: return ast::BinaryOp::EQ;
+  case BasicLexer::NE: return ast::BinaryOp::NE;
+  case BasicLexer::LT: return ast::BinaryOp::LT;
+  case BasicLexer::LE: return ast::BinaryOp::LE;
+  case BasicLexer::GT: return ast::BinaryOp::GT;
+  case BasicLexer::GE: return ast::BinaryOp::GE;
+  }
+  throw std::invalid_argument(fmt::format("Unknown binary operator token: {}", token_type));
+}
+
+// The left operand of a binary operator, or null when ctx is not one.
+static BasicParser::ExprContext* left_operand(BasicParser::ExprContext* ctx) {
+  if (auto* c = dynamic_cast<BasicParser::RelationContext*>(ctx)) {
+    return c->expr(0);
+  }
+  if (auto* c = dynamic_cast<BasicParser::MulDivContext*>(ctx)) {
+    return c->expr(0);
+  }
+  if (auto* c = dynamic_cast<BasicParser::AddSubContext*>(ctx)) {
+    return c->expr(0);
+  }
+  if (auto* c = dynamic_cast<BasicParser::LogicalAndContext*>(ctx)) {
+    return c->expr(0);
+  }
+  if (auto* c = dynamic_cast<BasicParser::LogicalOrContext*>(ctx)) {
+    return c->expr(0);
+  }
+  return nullptr;
+}
+
+std::unique_ptr<ast::Unit> AstBuilder::build(const std::string& filename,
+                                             BasicParser::MainContext* ctx) {
+  auto unit = std::make_unique<ast::Unit>();
+  unit->filename = filename;
+  module_.clear();
+  for (auto* child : ctx->children) {
+    if (auto* stmt = dynamic_cast<BasicParser::StatementContext*>(child)) {
+      if (auto s = statement(stmt)) {
+        unit->statements.push_back(std::move(s));
+      }
+    } else if (auto* proc = dynamic_cast<BasicParser::ProcedureDefinitionContext*>(child)) {
+      unit->procedures.push_back(procedure(proc));
+    } else if (auto* imp = dynamic_cast<BasicParser::ImportModuleContext*>(child)) {
+      if (imp->ID()) {
+        unit->statements.push_back(
+            std::make_unique<ast::ImportStmt>(imp->ID()->getText(), false, line_of(imp)));
+      } else if (imp->STRING()) {
+        unit->statements.push_back(std::make_unique<ast::ImportStmt>(
+            remove_quotes(imp->STRING()->getText()), true, line_of(imp)));
+      }
+    } else if (auto* mod = dynamic_cast<BasicParser::ModuleDefinitionContext*>(child)) {
+      module_ = remove_quotes(mod->STRING()->getText());
+    }
+  }
+  return unit;
+}
+
+ast::ProcedureDef AstBuilder::procedure(BasicParser::ProcedureDefinitionContext* ctx) {
+  ast::ProcedureDef def;
+  def.name = ctx->procedureName()->getText();
+  def.module = module_;
+  def.line = line_of(ctx);
+  if (auto* params = ctx->parameterDefinitionList()) {
+    for (auto* id : params->id()) {
+      def.params.push_back(id->ID()->getText());
+    }
+  }
+  def.body = statements(ctx->statements());
+  return def;
+}
+
+ast::Block AstBuilder::statements(BasicParser::StatementsContext* ctx) {
+  ast::Block block;
+  if (!ctx) {
+    return block;
+  }
+  for (auto* stmt : ctx->statement()) {
+    if (auto s = statement(stmt)) {
+      block.push_back(std::move(s));
+    }
+  }
+  return block;
+}
+
+std::unique_ptr<ast::Stmt> AstBuilder::statement(BasicParser::StatementContext* ctx) {
+  if (auto* a = ctx->assignmentStatement()) {
+    return assignment(a);
+  }
+  if (auto* i = ctx->ifStatement()) {
+    return if_statement(i);
+  }
+  if (auto* f = ctx->forStatement()) {
+    return for_statement(f);
+  }
+  if (auto* c = ctx->procedureCall()) {
+    return std::make_unique<ast::CallStmt>(call(c), line_of(c));
+  }
+  if (auto* r = ctx->returnStatement()) {
+    return std::make_unique<ast::ReturnStmt>(expr(r->expr()), line_of(r));
+  }
+  if (auto* b = ctx->breakStatement()) {
+    return std::make_unique<ast::BreakStmt>(line_of(b));
+  }
+  if (auto* d = ctx->dimStatement()) {
+    return dim_statement(d);
+  }
+  // emptyStatement
+  return {};
+}
+
+std::unique_ptr<ast::Stmt>
+AstBuilder::assignment(BasicParser::AssignmentStatementContext* ctx) {
+  auto* lvalue = ctx->lvalue();
+  std::unique_ptr<ast::Expr> value;
+  if (ctx->expr()) {
+    value = expr(ctx->expr());
+  } else {
+    value = std::make_unique<ast::VariableRef>(ctx->rvalue()->getText(), line_of(ctx->rvalue()));
+  }
+  auto stmt = std::make_unique<ast::AssignStmt>(lvalue->variable()->getText(), std::move(value),
+                                                line_of(ctx));
+  if (lvalue->expr()) {
+    stmt->index = expr(lvalue->expr());
+  }
+  return stmt;
+}
+
+std::unique_ptr<ast::Stmt> AstBuilder::if_statement(BasicParser::IfStatementContext* ctx) {
+  auto stmt = std::make_unique<ast::IfStmt>(line_of(ctx));
+  if (auto* c = ctx->ifThenStatement()) {
+    stmt->branches.push_back({expr(c->expr()), statements(c->statements())});
+  } else if (auto* c = ctx->ifThenElseStatement()) {
+    stmt->branches.push_back({expr(c->expr()), statements(c->statements(0))});
+    stmt->has_else = true;
+    stmt->else_body = statements(c->statements(1));
+  } else if (auto* c = ctx->ifThenElseIfElseStatement()) {
+    for (size_t i = 0; i < c->expr().size(); i++) {
+      stmt->branches.push_back({expr(c->expr(i)), statements(c->statements(i))});
+    }
+    if (c->ELSE()) {
+      stmt->has_else = true;
+      stmt->else_body = statements(c->statements().back());
+    }
+  }
+  return stmt;
+}
+
+std::unique_ptr<ast::Stmt> AstBuilder::for_statement(BasicParser::ForStatementContext* ctx) {
+  auto stmt = std::make_unique<ast::ForStmt>(ctx->ID()->getText(), line_of(ctx));
+  stmt->start = expr(ctx->expr(0));
+  stmt->end = expr(ctx->expr(1));
+  if (ctx->STEP()) {
+    stmt->step = expr(ctx->expr(2));
+    if (ctx->MINUS()) {
+      // The minus applies to the first operand of the step, as a unary minus
+      // binding more tightly than any operator would, so STEP -a + b is
+      // (0 - a) + b.  Each binary operator in the parse tree is a
+      // BinaryExpr, so the operand is found by following both down their
+      // left operands.  0 - n is folded by the optimizer when n is a literal.
+      auto* operand = &stmt->step;
+      for (auto* c = left_operand(ctx->expr(2)); c; c = left_operand(c)) {
+        operand = &static_cast<ast::BinaryExpr&>(**operand).left;
+      }
+      *operand = std::make_unique<ast::BinaryExpr>(ast::BinaryOp::SUB,
+                                                   std::make_unique<ast::IntLiteral>(0, stmt->line),
+                                                   std::move(*operand), stmt->line);
+    }
+  }
+  stmt->body = statements(ctx->statements());
+  return stmt;
+}
+
+std::unique_ptr<ast::Stmt> AstBuilder::dim_statement(BasicParser::DimStatementContext* ctx) {
+  auto type = Value::Type::INTEGER;
+  if (ctx->ID()) {
+    const auto t = element_type(ctx->ID()->getText());
+    if (!t) {
+      throw std::invalid_argument(fmt::format("Unknown DIM type: '{}'", ctx->ID()->getText()));
+    }
+    type = *t;
+  }
+  return std::make_unique<ast::DimStmt>(ctx->variable()->getText(), type, expr(ctx->expr()),
+                                        line_of(ctx));
+}
+
+std::unique_ptr<ast::CallExpr> AstBuilder::call(BasicParser::ProcedureCallContext* ctx) {
+  auto c = std::make_unique<ast::CallExpr>(ctx->procedureName()->getText(), line_of(ctx));
+  if (auto* params = ctx->parameterList()) {
+    for (auto* e : params->expr()) {
+      c->args.push_back(expr(e));
+    }
+  }
+  return c;
+}
+
+std::unique_ptr<ast::Expr> AstBuilder::expr(BasicParser::ExprContext* ctx) {
+  const auto line = line_of(ctx);
+  if (auto* c = dynamic_cast<BasicParser::RelationContext*>(ctx)) {
+    return std::make_unique<ast::BinaryExpr>(
+        to_binary_op(c->relationaloperator()->getStart()->getType()), expr(c->expr(0)),
+        expr(c->expr(1)), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::MulDivContext*>(ctx)) {
+    return std::make_unique<ast::BinaryExpr>(
+        to_binary_op(c->multiplicativeoperator()->getStart()->getType()), expr(c->expr(0)),
+        expr(c->expr(1)), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::AddSubContext*>(ctx)) {
+    return std::make_unique<ast::BinaryExpr>(
+        to_binary_op(c->additiveoperator()->getStart()->getType()), expr(c->expr(0)),
+        expr(c->expr(1)), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::LogicalAndContext*>(ctx)) {
+    return std::make_unique<ast::BinaryExpr>(ast::BinaryOp::AND, expr(c->expr(0)),
+                                             expr(c->expr(1)), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::LogicalOrContext*>(ctx)) {
+    return std::make_unique<ast::BinaryExpr>(ast::BinaryOp::OR, expr(c->expr(0)),
+                                             expr(c->expr(1)), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::ProcCallContext*>(ctx)) {
+    return call(c->procedureCall());
+  }
+  if (auto* c = dynamic_cast<BasicParser::ParensContext*>(ctx)) {
+    return expr(c->expr());
+  }
+  if (auto* c = dynamic_cast<BasicParser::IndexContext*>(ctx)) {
+    return std::make_unique<ast::IndexExpr>(c->rvalue()->getText(), expr(c->expr()), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::DictContext*>(ctx)) {
+    auto d = std::make_unique<ast::DictExpr>(line);
+    for (auto* entry : c->dictionary()->dictionaryEntry()) {
+      d->entries.push_back({expr(entry->expr(0)), expr(entry->expr(1))});
+    }
+    return d;
+  }
+  if (auto* c = dynamic_cast<BasicParser::IdentContext*>(ctx)) {
+    return std::make_unique<ast::VariableRef>(c->rvalue()->getText(), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::IntContext*>(ctx)) {
+    return std::make_unique<ast::IntLiteral>(to_number<int>(c->INT()->getText()), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::StringContext*>(ctx)) {
+    return std::make_unique<ast::StringLiteral>(remove_quotes(c->STRING()->getText()), line);
+  }
+  if (auto* c = dynamic_cast<BasicParser::BooleanContext*>(ctx)) {
+    return std::make_unique<ast::BoolLiteral>(c->booleanExpr()->TRUE() != nullptr, line);
+  }
+  throw std::invalid_argument(fmt::format("Unknown expression: '{}'", ctx->getText()));
+}
+
+} // namespace wwivbasic
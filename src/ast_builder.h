@@ -0,0 +1,35 @@
+#pragma once
+#include "BasicParser.h"
+#include "antlr4-runtime.h"
+#include "ast.h"
+
+#include <memory>
+#include <string>
+
+namespace wwivbasic {
+
+/**
+ * Lowers the ANTLR parse tree of a source unit into the compact AST
+ * used by the bytecode compiler.
+ */
+class AstBuilder {
+public:
+  AstBuilder() = default;
+
+  std::unique_ptr<ast::Unit> build(const std::string& filename, BasicParser::MainContext* ctx);
+
+private:
+  ast::ProcedureDef procedure(BasicParser::ProcedureDefinitionContext* ctx);
+  ast::Block statements(BasicParser::StatementsContext* ctx);
+  std::unique_ptr<ast::Stmt> statement(BasicParser::StatementContext* ctx);
+  std::unique_ptr<ast::Stmt> assignment(BasicParser::AssignmentStatementContext* ctx);
+  std::unique_ptr<ast::Stmt> if_statement(BasicParser::IfStatementContext* ctx);
+  std::unique_ptr<ast::Stmt> for_statement(BasicParser::ForStatementContext* ctx);
+  std::unique_ptr<ast::Stmt> dim_statement(BasicParser::DimStatementContext* ctx);
+  std::unique_ptr<ast::CallExpr> call(BasicParser::ProcedureCallContext* ctx);
+  std::unique_ptr<ast::Expr> expr(BasicParser::ExprContext* ctx);
+
+  std::string module_;
+};
+
+} // namespace wwivbasic
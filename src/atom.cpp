@@ -0,0 +1,80 @@
+#include "atom.h"
+
+#include <cctype>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace wwivbasic {
+
+namespace {
+
+// Every name interned by any Context.  Names are never removed, so atoms
+// stay valid for the life of the process.
+class Interner {
+public:
+  Interner() { names_.emplace_back(); }
+
+  uint32_t intern(std::string_view name) {
+    if (name.empty()) {
+      return 0;
+    }
+    std::string key(name);
+    for (auto& c : key) {
+      c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    auto [it, inserted] = ids_.try_emplace(std::move(key), static_cast<uint32_t>(names_.size()));
+    if (inserted) {
+      names_.emplace_back(name);
+    }
+    return it->second;
+  }
+
+  // Elements of a deque do not move as it grows, so the reference stays
+  // valid after the lock is released.
+  const std::string& name(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mu_);
+    return names_[id];
+  }
+
+private:
+  std::mutex mu_;
+  // Case folded name to atom id.
+  std::unordered_map<std::string, uint32_t> ids_;
+  // Spelling of each atom, indexed by id.
+  std::deque<std::string> names_;
+};
+
+Interner& interner() {
+  static Interner* i = new Interner();
+  return *i;
+}
+
+} // namespace
+
+Atom::Atom(std::string_view name) : id_(interner().intern(name)) {}
+
+const std::string& Atom::name() const { return interner().name(id_); }
+
+std::ostream& operator<<(std::ostream& os, Atom atom) { return os << atom.name(); }
+
+Name::Name(std::string_view name) {
+  if (const auto idx = name.rfind('.'); idx != std::string_view::npos) {
+    module = Atom(name.substr(0, idx));
+    id = Atom(name.substr(idx + 1));
+  } else {
+    id = Atom(name);
+  }
+}
+
+std::ostream& operator<<(std::ostream& os, const Name& name) {
+  if (name.qualified()) {
+    os << name.module << '.';
+  }
+  return os << name.id;
+}
+
+} // namespace wwivbasic
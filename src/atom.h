@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace wwivbasic {
+
+/**
+ * An interned identifier.
+ *
+ * BASIC names are case insensitive, so every spelling of a name interns to
+ * the same atom.  Atoms compare and hash as integers, so symbol tables keyed
+ * by them never compare strings.  Interning takes a lock, so intern a name
+ * once (when it is parsed or compiled) and keep the atom.
+ *
+ * The default atom is the empty name.
+ */
+class Atom {
+public:
+  constexpr Atom() noexcept = default;
+  explicit Atom(std::string_view name);
+
+  uint32_t id() const noexcept { return id_; }
+  // The spelling this name was first interned with.
+  const std::string& name() const;
+  bool empty() const noexcept { return id_ == 0; }
+
+  friend bool operator==(Atom a, Atom b) noexcept { return a.id_ == b.id_; }
+  friend bool operator!=(Atom a, Atom b) noexcept { return a.id_ != b.id_; }
+  friend bool operator<(Atom a, Atom b) noexcept { return a.id_ < b.id_; }
+
+private:
+  uint32_t id_{0};
+};
+
+std::ostream& operator<<(std::ostream& os, Atom atom);
+
+/**
+ * An identifier that may be qualified by a module, i.e "foo.bar.baz" is the
+ * id "baz" in the module "foo.bar".  module is empty when unqualified.
+ */
+class Name {
+public:
+  Name() = default;
+  explicit Name(std::string_view name);
+  Name(Atom m, Atom i) noexcept : module(m), id(i) {}
+
+  bool qualified() const noexcept { return !module.empty(); }
+  bool empty() const noexcept { return id.empty(); }
+
+  friend bool operator==(const Name& a, const Name& b) noexcept {
+    return a.module == b.module && a.id == b.id;
+  }
+  friend bool operator!=(const Name& a, const Name& b) noexcept { return !(a == b); }
+
+  Atom module;
+  Atom id;
+};
+
+std::ostream& operator<<(std::ostream& os, const Name& name);
+
+} // namespace wwivbasic
+
+namespace std {
+template <> struct hash<wwivbasic::Atom> {
+  size_t operator()(wwivbasic::Atom atom) const noexcept { return atom.id(); }
+};
+} // namespace std
@@ -0,0 +1,111 @@
+#include "gtest/gtest.h"
+#include "atom.h"
+#include "flat_map.h"
+
+#include <string>
+#include <vector>
+
+using namespace wwivbasic;
+
+TEST(AtomTest, CaseInsensitive) {
+  const Atom a("Counter");
+  EXPECT_EQ(a, Atom("COUNTER"));
+  EXPECT_EQ(a, Atom("counter"));
+  EXPECT_NE(a, Atom("Counter2"));
+  // The first spelling is kept.
+  EXPECT_EQ(a.name(), "Counter");
+}
+
+TEST(AtomTest, Empty) {
+  EXPECT_TRUE(Atom().empty());
+  EXPECT_EQ(Atom(""), Atom());
+  EXPECT_FALSE(Atom("x").empty());
+}
+
+TEST(AtomTest, Name) {
+  const Name q("wwiv.io.print");
+  EXPECT_TRUE(q.qualified());
+  EXPECT_EQ(q.module, Atom("WWIV.IO"));
+  EXPECT_EQ(q.id, Atom("PRINT"));
+
+  const Name u("print");
+  EXPECT_FALSE(u.qualified());
+  EXPECT_EQ(u.id, q.id);
+}
+
+TEST(FlatMapTest, InsertAndFind) {
+  FlatMap<Atom, int> m;
+  EXPECT_EQ(m.find(Atom("a")), nullptr);
+  for (int i = 0; i < 100; i++) {
+    auto [v, inserted] = m.try_emplace(Atom("v" + std::to_string(i)), i);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(*v, i);
+  }
+  EXPECT_EQ(m.size(), 100u);
+  for (int i = 0; i < 100; i++) {
+    const auto* v = m.find(Atom("V" + std::to_string(i)));
+    ASSERT_NE(v, nullptr);
+    EXPECT_EQ(*v, i);
+  }
+  EXPECT_FALSE(m.try_emplace(Atom("v1"), 5).second);
+  m.insert_or_assign(Atom("v1"), 5);
+  EXPECT_EQ(*m.find(Atom("v1")), 5);
+  EXPECT_EQ(m.size(), 100u);
+}
+
+TEST(FlatMapTest, StableAndInsertionOrder) {
+  FlatMap<std::string, int> m;
+  auto* first = m.try_emplace("z", 1).first;
+  m.try_emplace("a", 2);
+  m.try_emplace("m", 3);
+  for (int i = 0; i < 50; i++) {
+    m.try_emplace(std::to_string(i), i);
+  }
+  // Growing the table does not move the entries.
+  EXPECT_EQ(m.find("z"), first);
+
+  std::vector<std::string> keys;
+  for (const auto& [k, v] : m) {
+    keys.push_back(k);
+  }
+  ASSERT_EQ(keys.size(), 53u);
+  EXPECT_EQ(keys[0], "z");
+  EXPECT_EQ(keys[1], "a");
+  EXPECT_EQ(keys[2], "m");
+  EXPECT_EQ(keys[3], "0");
+}
+
+TEST(FlatMapTest, Copy) {
+  FlatMap<std::string, int> m;
+  for (int i = 0; i < 10; i++) {
+    m.try_emplace(std::to_string(i), i);
+  }
+  FlatMap<std::string, int> assigned;
+  assigned.try_emplace("x", -1);
+  assigned = m;
+  EXPECT_EQ(assigned.size(), 10u);
+  EXPECT_EQ(assigned.find("x"), nullptr);
+
+  FlatMap<std::string, int> copy(m);
+  for (int i = 0; i < 10; i++) {
+    const auto key = std::to_string(i);
+    ASSERT_NE(copy.find(key), nullptr) << key;
+    EXPECT_EQ(*copy.find(key), i);
+    ASSERT_NE(assigned.find(key), nullptr) << key;
+    EXPECT_EQ(*assigned.find(key), i);
+    EXPECT_FALSE(copy.try_emplace(key, -1).second);
+  }
+  // Enough to grow the copy's table more than once.
+  for (int i = 10; i < 100; i++) {
+    EXPECT_TRUE(copy.try_emplace(std::to_string(i), i).second);
+  }
+  EXPECT_EQ(copy.size(), 100u);
+  for (int i = 0; i < 100; i++) {
+    const auto* v = copy.find(std::to_string(i));
+    ASSERT_NE(v, nullptr) << i;
+    EXPECT_EQ(*v, i);
+  }
+  // The original is unchanged.
+  EXPECT_EQ(m.size(), 10u);
+  EXPECT_EQ(m.find("50"), nullptr);
+}
@@ -2,6 +2,7 @@
 #include "BasicParser.h"
 #include "BasicParserBaseVisitor.h"
 #include "antlr4-runtime.h"
+#include "compiler.h"
 #include "core/command_line.h"
 #include "core/log.h"
 #include "core/textfile.h"
@@ -9,8 +10,12 @@
 #include "executor.h"
 #include "fmt/format.h"
 #include "function_def_visitor.h"
+#include "optimizer.h"
+#include "program_cache.h"
+#include "vm.h"
 #include <cerrno>
 #include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <optional>
 #include <string>
@@ -29,6 +34,41 @@ std::string easy2(std::string s, std::string s1) {
   return {};
 }
 
+// Registers the native functions available to scripts run by basicrun.
+static void register_natives(Context& ec) {
+  auto& io = ec.add_module("wwiv.io");
+  io.native_functionl("PRINT", [](Args args) -> Value {
+    if (!args.empty()) {
+      fmt::print("WWIV.IO: {}\r\n", args.front().toString());
+    }
+    return {};
+    });
+
+  REGISTER_NATIVE(ec.root, easy);
+  REGISTER_NATIVE(ec.root, easy2);
+  ec.root->native_function("EASY3", [](int a, int b) -> int {
+    return a + b;
+    });
+  ec.root->native_functionl("PRINT", [](Args args) -> Value {
+    for (const auto& arg : args) {
+      std::cout << arg.toString() << " ";
+    }
+    std::cout << std::endl;
+    return {};
+    });
+}
+
+static int run_program(Context& ec, const Program& program, const CommandLine& cmdline) {
+  if (cmdline.barg("disassemble")) {
+    fmt::print("{}\r\n", disassemble(program));
+  }
+  if (cmdline.barg("execute")) {
+    VM vm(ec, program);
+    vm.run();
+  }
+  return 0;
+}
+
 int main(int argc, char* argv[]) {
   LoggerConfig config;
 
@@ -38,6 +78,20 @@ int main(int argc, char* argv[]) {
     "show_parsetree", 't', "Display the parse tree before executing", false));
   cmdline.add_argument(BooleanCommandLineArgument(
     "execute", 'e', "Execute the script", true));
+  cmdline.add_argument(BooleanCommandLineArgument(
+    "vm", 'm', "Compile the script to bytecode and execute it on the VM", false));
+  cmdline.add_argument(BooleanCommandLineArgument(
+    "disassemble", 'd', "Display the compiled bytecode before executing", false));
+  cmdline.add_argument(BooleanCommandLineArgument(
+    "optimize", 'O', "Fold constants and remove dead IF branches before compiling", true));
+  cmdline.add_argument(BooleanCommandLineArgument(
+    "dump_optimized", 'o', "Display the script as it is after optimizing", false));
+  cmdline.add_argument({"cache_dir", 'c',
+    "Cache compiled scripts in this directory and run them on the VM", ""});
+  cmdline.add_argument(BooleanCommandLineArgument(
+    "warm_parser", 'w', "Warm up the parser on a built in corpus before parsing", false));
+  cmdline.add_argument({"max_call_depth",
+    "How deeply calls to BASIC functions may nest", std::to_string(kDefaultMaxCallDepth)});
   if (!cmdline.Parse()) {
     return 2;
   }
@@ -47,10 +101,70 @@ int main(int argc, char* argv[]) {
     return 2;
   }
 
+  if (cmdline.barg("warm_parser")) {
+    warm_up_parser();
+  }
+
   const auto& filename = cmdline.remaining().front();
+  if (const auto cache_dir = cmdline.sarg("cache_dir"); !cache_dir.empty()) {
+    // Only parses the script when there is no current compiled copy.
+    ProgramCache cache(cache_dir);
+    std::vector<std::string> errors;
+    auto program = cache.compile(filename, errors);
+    if (!program) {
+      for (const auto& err : errors) {
+        fmt::print("ERROR: {}\r\n", err);
+      }
+      return 1;
+    }
+    wwivbasic::Context ec;
+    ec.max_call_depth = cmdline.iarg<size_t>("max_call_depth");
+    register_natives(ec);
+    return run_program(ec, *program, cmdline);
+  }
+
+  if (cmdline.barg("vm") || cmdline.barg("disassemble") || cmdline.barg("dump_optimized")) {
+    // The VM only needs the compiled program, so nothing of the parse is
+    // kept while it runs.
+    TextFile f(std::filesystem::path(filename), "rb");
+    if (!f) {
+      fmt::print("Unable to open file: {}\r\n", filename);
+      return 1;
+    }
+    const auto text = f.ReadFileIntoString();
+    if (cmdline.barg("show_parsetree")) {
+      SourceUnit su(filename, text);
+      fmt::print("Parse Tree: {}\r\n\n\n", su.tree()->toStringTree(su.parser(), true));
+    }
+    std::vector<std::string> errors;
+    auto unit = parse_source(filename, text, errors);
+    if (!unit) {
+      for (const auto& err : errors) {
+        fmt::print("ERROR: {}\r\n", err);
+      }
+      return 1;
+    }
+    if (cmdline.barg("optimize")) {
+      Optimizer opt;
+      opt.optimize(*unit);
+      VLOG(1) << "Optimizer folded " << opt.folded << " expressions and removed "
+              << opt.removed_branches << " branches";
+    }
+    if (cmdline.barg("dump_optimized")) {
+      fmt::print("{}\r\n", dump(*unit));
+    }
+    auto program = Compiler().compile(*unit);
+    unit.reset();
+    wwivbasic::Context ec;
+    ec.max_call_depth = cmdline.iarg<size_t>("max_call_depth");
+    register_natives(ec);
+    return run_program(ec, *program, cmdline);
+  }
+
+  // ExecutionVisitor walks the parse tree, so keeps the source unit loaded.
   wwivbasic::Context ec(filename);
+  ec.max_call_depth = cmdline.iarg<size_t>("max_call_depth");
   auto tree = ec.parseTree(filename);
-
   if (!tree) {
     fmt::print("Unable to parse tree");
     return 1;
@@ -64,35 +178,7 @@ int main(int argc, char* argv[]) {
 
   wwivbasic::FunctionDefVisitor fd(ec);
   fd.visit(tree.value());
-
-  Module io("wwiv.io");
-  io.native_functionl("PRINT", [](std::vector<Value> args) -> Value {
-    if (!args.empty()) {
-      fmt::print("WWIV.IO: {}\r\n", args.front().toString());
-    }
-    return {};
-    });
-  ec.modules.insert_or_assign("wwiv.io", io);
-
-  ec.root->native_functionl("PRINT", [](std::vector<Value> args) -> Value {
-    for (const auto& arg : args) {
-      std::cout << arg.toString() << " ";
-    }
-    std::cout << std::endl;
-    return {};
-  });
-  REGISTER_NATIVE(ec.root, easy);
-  REGISTER_NATIVE(ec.root, easy2);
-  ec.root->native_function("EASY3", [](int a, int b) -> int {
-    return a + b;
-    });
-  ec.root->native_functionl("PRINT", [](std::vector<Value> args) -> Value {
-    for (const auto& arg : args) {
-      std::cout << arg.toString() << " ";
-    }
-    std::cout << std::endl;
-    return {};
-    });
+  register_natives(ec);
 
   if (cmdline.barg("execute")) {
     ExecutionVisitor v(ec);
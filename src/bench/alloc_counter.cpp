@@ -0,0 +1,49 @@
+#include "bench/alloc_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions so that benchmarks can report
+// the number of heap allocations per operation and the memory held.  Each
+// allocation is preceded by a header holding its size, sized to keep the
+// allocation itself aligned as malloc's is.
+
+static std::atomic<uint64_t> allocation_count{0};
+static std::atomic<int64_t> allocated{0};
+
+static constexpr std::size_t kHeader = alignof(std::max_align_t);
+
+namespace wwivbasic::bench {
+
+uint64_t allocations() { return allocation_count.load(std::memory_order_relaxed); }
+
+int64_t allocated_bytes() { return allocated.load(std::memory_order_relaxed); }
+
+} // namespace wwivbasic::bench
+
+void* operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (auto* p = static_cast<char*>(std::malloc(kHeader + size))) {
+    *reinterpret_cast<std::size_t*>(p) = size;
+    allocated.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    return p + kHeader;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return ::operator new(size); }
+
+void operator delete(void* p) noexcept {
+  if (!p) {
+    return;
+  }
+  auto* block = static_cast<char*>(p) - kHeader;
+  allocated.fetch_sub(static_cast<int64_t>(*reinterpret_cast<std::size_t*>(block)),
+                      std::memory_order_relaxed);
+  std::free(block);
+}
+void operator delete[](void* p) noexcept { ::operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept { ::operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { ::operator delete(p); }
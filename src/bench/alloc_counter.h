@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+namespace wwivbasic::bench {
+
+// Number of calls to the global operator new made by this process.
+uint64_t allocations();
+
+// Bytes currently allocated by the global operator new and not yet
+// deleted, as requested (without allocator overhead).
+int64_t allocated_bytes();
+
+} // namespace wwivbasic::bench
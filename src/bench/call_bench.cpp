@@ -0,0 +1,125 @@
+#include "benchmark/benchmark.h"
+#include "bench/alloc_counter.h"
+#include "context.h"
+#include "executor.h"
+#include "function_def_visitor.h"
+#include "value.h"
+
+#include <string>
+
+// Measures the cost of entering and leaving function and FOR loop scopes,
+// with the heap allocations made per call.  Once the scope stack has
+// reached its deepest level, scopes are reused and allocs_per_op should
+// stay at zero.
+
+using namespace wwivbasic;
+using namespace wwivbasic::bench;
+
+namespace {
+
+void report_allocs(benchmark::State& state, int64_t start, int64_t calls_per_iteration) {
+  state.counters["allocs_per_op"] =
+      benchmark::Counter(static_cast<double>(allocations() - start) / calls_per_iteration,
+                         benchmark::Counter::kAvgIterations);
+}
+
+} // namespace
+
+// Pushes state.range(0) nested scopes, as recursion would, each with two
+// parameters, then pops them all.
+static void BM_Scope_PushPop(benchmark::State& state) {
+  const auto depth = state.range(0);
+  ScopeStack scopes;
+  scopes.push(Atom("<GLOBAL>"));
+  const Atom fn_name("fib");
+  const Atom a("a");
+  const Atom b("b");
+  const Value long_string("a string that is stored on the heap");
+  const auto start = allocations();
+  for (auto _ : state) {
+    for (int64_t i = 0; i < depth; i++) {
+      auto& scope = scopes.push(fn_name);
+      scope.upsert(a, Value(static_cast<int>(i)));
+      scope.upsert(b, long_string);
+    }
+    for (int64_t i = 0; i < depth; i++) {
+      scopes.pop();
+    }
+  }
+  report_allocs(state, start, depth);
+}
+BENCHMARK(BM_Scope_PushPop)->Arg(1)->Arg(16)->Arg(256);
+
+// Module::call on a native function, as the tree walker calls it.
+static void BM_ModuleCall_Native(benchmark::State& state) {
+  Context ec;
+  const Name fn_name("ABS");
+  const Value args[] = {Value(-12)};
+  ExecutionVisitor visitor(ec);
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto result = ec.call(fn_name, Args(args, 1), &visitor);
+    benchmark::DoNotOptimize(result);
+  }
+  report_allocs(state, start, 1);
+}
+BENCHMARK(BM_ModuleCall_Native);
+
+// The same call through an inline cache, as a call site makes it once it
+// has been resolved.
+static void BM_CallSite_Native(benchmark::State& state) {
+  Context ec;
+  const Name fn_name("ABS");
+  const Value args[] = {Value(-12)};
+  ExecutionVisitor visitor(ec);
+  CallSite site;
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto* fn = site.get(ec.module, ec.generation);
+    if (!fn) {
+      fn = ec.resolve(site, fn_name);
+    }
+    auto result = site.module()->call(*fn, Args(args, 1), &visitor);
+    benchmark::DoNotOptimize(result);
+  }
+  report_allocs(state, start, 1);
+}
+BENCHMARK(BM_CallSite_Native);
+
+// Calls to a BASIC function from a FOR loop and through recursion on the
+// tree walker.  allocs_per_op is per BASIC function call.
+static void BM_Execute_Calls(benchmark::State& state, const char* text, int64_t calls) {
+  Context ec;
+  ec.add_source("bench.bas", text);
+  FunctionDefVisitor fd(ec);
+  fd.visit(ec.sources.at("bench.bas")->tree());
+  ec.module = ec.root;
+  auto* main = ec.sources.at("bench.bas")->main();
+  ExecutionVisitor visitor(ec);
+  // Warm up, so that the scopes and argument stack reach their full size.
+  visitor.visit(main);
+  const auto start = allocations();
+  for (auto _ : state) {
+    visitor.visit(main);
+  }
+  report_allocs(state, start, calls);
+}
+
+BENCHMARK_CAPTURE(BM_Execute_Calls, loop, R"(def add(a, b)
+  return a + b
+enddef
+total = 0
+FOR i = 1 to 1000
+  total = add(total, i)
+NEXT
+)", 1000);
+
+// fib(12) makes 465 calls.
+BENCHMARK_CAPTURE(BM_Execute_Calls, recursion, R"(def fib(n)
+  if n < 2 then
+    return n
+  endif
+  return fib(n - 1) + fib(n - 2)
+enddef
+r = fib(12)
+)", 465);
@@ -0,0 +1,62 @@
+#include "benchmark/benchmark.h"
+#include "bench/alloc_counter.h"
+#include "context.h"
+#include "native.h"
+#include "value.h"
+
+#include <array>
+#include <string>
+
+using namespace wwivbasic;
+using namespace wwivbasic::bench;
+
+// Calls the native function registered as name through the same path the
+// VM uses: a lookup in the Context and a call with a view of the arguments.
+template <size_t N>
+static void call_native(benchmark::State& state, const std::string& name,
+                        const std::array<Value, N>& args) {
+  Context ec;
+  auto [m, fn] = ec.find_fn(name);
+  if (!fn) {
+    state.SkipWithError("Unknown function");
+    return;
+  }
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto result = fn->cpp_fn(Args(args.data(), args.size()));
+    benchmark::DoNotOptimize(result);
+  }
+  state.counters["allocs_per_op"] = benchmark::Counter(static_cast<double>(allocations() - start),
+                                                       benchmark::Counter::kAvgIterations);
+}
+
+static void BM_Native_Len(benchmark::State& state) {
+  call_native<1>(state, "LEN", {Value("a string that is stored on the heap")});
+}
+BENCHMARK(BM_Native_Len);
+
+static void BM_Native_Asc(benchmark::State& state) {
+  call_native<1>(state, "ASC", {Value("a string that is stored on the heap")});
+}
+BENCHMARK(BM_Native_Asc);
+
+static void BM_Native_Mid(benchmark::State& state) {
+  call_native<3>(state, "MID", {Value("a string that is stored on the heap"), Value(2), Value(6)});
+}
+BENCHMARK(BM_Native_Mid);
+
+static void BM_Native_Left(benchmark::State& state) {
+  call_native<2>(state, "LEFT", {Value("a string that is stored on the heap"), Value(8)});
+}
+BENCHMARK(BM_Native_Left);
+
+// A field of a fixed width record, as when reading user or message headers.
+static void BM_Native_MidRecord(benchmark::State& state) {
+  call_native<3>(state, "MID", {Value(std::string(200, 'r')), Value(40), Value(60)});
+}
+BENCHMARK(BM_Native_MidRecord);
+
+static void BM_Native_Abs(benchmark::State& state) {
+  call_native<1>(state, "ABS", {Value(-12)});
+}
+BENCHMARK(BM_Native_Abs);
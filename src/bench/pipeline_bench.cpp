@@ -0,0 +1,301 @@
+#include "benchmark/benchmark.h"
+#include "BasicLexer.h"
+#include "antlr4-runtime.h"
+#include "ast_builder.h"
+#include "bench/alloc_counter.h"
+#include "compiler.h"
+#include "context.h"
+#include "executor.h"
+#include "function_def_visitor.h"
+#include "parser.h"
+#include "program_cache.h"
+#include "vm.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Times each stage of running a script separately: lexing, parsing
+// (SourceUnit construction), FunctionDefVisitor registration and execution,
+// both on the tree-walking ExecutionVisitor and on the bytecode VM, and
+// loading a compiled program as the program cache does.
+//
+// BM_Parse uses the default two stage SLL then LL prediction with a warm
+// DFA, as after warm_up_parser(), BM_ParseLL uses LL prediction alone, and
+// BM_ParseCold clears the DFA before each parse, as the first parse in a
+// process without warm_up_parser() has it.
+//
+// BM_ParseToAst and BM_ParseNative compare the two front ends from text to
+// AST: ANTLR's parse tree lowered by AstBuilder, and the hand written
+// Parser.  Both report the heap allocations made per parse.
+//
+// BM_SourceUnitMemory and BM_ProgramMemory report the heap memory a loaded
+// script holds ("bytes_per_script"): its SourceUnit, which the tree-walking
+// ExecutionVisitor needs for as long as the script runs, and its compiled
+// Program, which is all the VM needs once compile_source has released the
+// ANTLR objects.
+//
+// Use --benchmark_format=json (or --benchmark_out=FILE
+// --benchmark_out_format=json) to record results for comparison.
+
+using namespace wwivbasic;
+using namespace wwivbasic::bench;
+
+namespace {
+
+constexpr const char* kForLoop = R"(total = 0
+FOR i = 1 to 1000
+  total = total + i * 2
+NEXT
+)";
+
+constexpr const char* kRecursion = R"(def fib(n)
+  if n < 2 then
+    return n
+  endif
+  return fib(n - 1) + fib(n - 2)
+enddef
+r = fib(15)
+)";
+
+constexpr const char* kStrings = R"(s = ""
+FOR i = 1 to 200
+  s = s + MID("abcdefghij", i MOD 10, 1)
+  t = LEFT(s, 3) + RIGHT(s, 3)
+NEXT
+)";
+
+// Builds a 100KB string by appending to it.
+constexpr const char* kBuildString = R"(s = ""
+FOR i = 1 to 10000
+  s = s + "0123456789"
+NEXT
+)";
+
+// Fills, sorts and searches an array.
+constexpr const char* kArrays = R"(DIM a[1000]
+FOR i = 0 to 999
+  a[i] = (i * 7919) MOD 1000
+NEXT
+a = SORT(a)
+total = SUM(a)
+at = FIND(a, 500)
+)";
+
+constexpr const char* kDicts = R"(counts = {}
+FOR i = 1 to 1000
+  name = "user" + (i * 7919) MOD 100
+  counts[name] = GET(counts, name, 0) + 1
+NEXT
+users = LEN(counts)
+top = counts["user42"]
+)";
+
+constexpr const char* kModules = R"(MODULE "util"
+def twice(n)
+  return n * 2
+enddef
+total = 0
+FOR i = 1 to 200
+  total = util.twice(total MOD 1000) + i
+NEXT
+)";
+
+// Guards whose right operand is only evaluated for one value in ten.
+constexpr const char* kGuards = R"(def expensive(n)
+  total = 0
+  FOR j = 1 to 20
+    total = total + j
+  NEXT
+  return total
+enddef
+hits = 0
+FOR i = 1 to 200
+  IF i MOD 10 = 0 AND expensive(i) > 0 THEN
+    hits = hits + 1
+  ENDIF
+  IF i MOD 10 <> 0 OR expensive(i) > 0 THEN
+    hits = hits + 1
+  ENDIF
+NEXT
+)";
+
+// A parsed script with its functions registered, ready to execute.
+class Loaded {
+public:
+  explicit Loaded(const char* text) {
+    ec.add_source("bench.bas", text);
+    FunctionDefVisitor fd(ec);
+    fd.visit(ec.sources.at("bench.bas")->tree());
+    ec.module = ec.root;
+  }
+
+  BasicParser::MainContext* main() { return ec.sources.at("bench.bas")->main(); }
+
+  Context ec;
+};
+
+void BM_Lex(benchmark::State& state, const char* text) {
+  for (auto _ : state) {
+    antlr4::ANTLRInputStream input(text);
+    BasicLexer lexer(&input);
+    antlr4::CommonTokenStream tokens(&lexer);
+    tokens.fill();
+    benchmark::DoNotOptimize(tokens.size());
+  }
+}
+
+void BM_Parse(benchmark::State& state, const char* text) {
+  for (auto _ : state) {
+    SourceUnit su("bench.bas", text);
+    benchmark::DoNotOptimize(su.main());
+  }
+}
+
+void BM_ParseLL(benchmark::State& state, const char* text) {
+  for (auto _ : state) {
+    SourceUnit su("bench.bas", text, ParseMode::LL);
+    benchmark::DoNotOptimize(su.main());
+  }
+}
+
+void BM_ParseCold(benchmark::State& state, const char* text) {
+  // The DFA is shared by every parser, so any parser can clear it.
+  SourceUnit empty("bench.bas", text);
+  auto* interpreter = empty.parser()->getInterpreter<antlr4::atn::ParserATNSimulator>();
+  for (auto _ : state) {
+    state.PauseTiming();
+    interpreter->clearDFA();
+    state.ResumeTiming();
+    SourceUnit su("bench.bas", text);
+    benchmark::DoNotOptimize(su.main());
+  }
+}
+
+// Adds an "allocs_per_op" counter with the heap allocations made since start.
+void report_allocations(benchmark::State& state, uint64_t start) {
+  state.counters["allocs_per_op"] = benchmark::Counter(static_cast<double>(allocations() - start),
+                                                       benchmark::Counter::kAvgIterations);
+}
+
+void BM_ParseToAst(benchmark::State& state, const char* text) {
+  const auto start = allocations();
+  for (auto _ : state) {
+    SourceUnit su("bench.bas", text);
+    auto unit = AstBuilder().build("bench.bas", su.main());
+    benchmark::DoNotOptimize(unit.get());
+  }
+  report_allocations(state, start);
+}
+
+void BM_ParseNative(benchmark::State& state, const char* text) {
+  const auto start = allocations();
+  for (auto _ : state) {
+    Parser parser("bench.bas", text);
+    auto unit = parser.parse();
+    benchmark::DoNotOptimize(unit.get());
+  }
+  report_allocations(state, start);
+}
+
+// Adds a "bytes_per_script" counter with the heap memory held since start.
+void report_bytes(benchmark::State& state, int64_t start) {
+  state.counters["bytes_per_script"] = static_cast<double>(allocated_bytes() - start);
+}
+
+void BM_SourceUnitMemory(benchmark::State& state, const char* text) {
+  for (auto _ : state) {
+    const auto start = allocated_bytes();
+    auto su = std::make_unique<SourceUnit>("bench.bas", text);
+    state.PauseTiming();
+    report_bytes(state, start);
+    su.reset();
+    state.ResumeTiming();
+  }
+}
+
+void BM_ProgramMemory(benchmark::State& state, const char* text) {
+  std::vector<std::string> errors;
+  for (auto _ : state) {
+    const auto start = allocated_bytes();
+    auto program = compile_source("bench.bas", text, errors);
+    state.PauseTiming();
+    report_bytes(state, start);
+    program.reset();
+    state.ResumeTiming();
+  }
+}
+
+void BM_FunctionDefs(benchmark::State& state, const char* text) {
+  Loaded script(text);
+  for (auto _ : state) {
+    FunctionDefVisitor fd(script.ec);
+    fd.visit(script.main());
+    script.ec.module = script.ec.root;
+  }
+}
+
+void BM_Execute(benchmark::State& state, const char* text) {
+  Loaded script(text);
+  for (auto _ : state) {
+    ExecutionVisitor v(script.ec);
+    v.visit(script.main());
+  }
+}
+
+void BM_Compile(benchmark::State& state, const char* text) {
+  Loaded script(text);
+  for (auto _ : state) {
+    auto unit = AstBuilder().build("bench.bas", script.main());
+    auto program = Compiler().compile(*unit);
+    benchmark::DoNotOptimize(program.get());
+  }
+}
+
+// A warm start from the program cache, with the file I/O left out.
+void BM_LoadCompiled(benchmark::State& state, const char* text) {
+  Loaded script(text);
+  auto unit = AstBuilder().build("bench.bas", script.main());
+  const auto data = serialize(*Compiler().compile(*unit));
+  for (auto _ : state) {
+    auto program = deserialize(data);
+    benchmark::DoNotOptimize(program.get());
+  }
+}
+
+void BM_VMExecute(benchmark::State& state, const char* text) {
+  Loaded script(text);
+  auto unit = AstBuilder().build("bench.bas", script.main());
+  auto program = Compiler().compile(*unit);
+  for (auto _ : state) {
+    VM vm(script.ec, *program);
+    vm.run();
+  }
+}
+
+} // namespace
+
+#define BENCHMARK_WORKLOADS(fn)                                                                    \
+  BENCHMARK_CAPTURE(fn, for_loop, kForLoop);                                                       \
+  BENCHMARK_CAPTURE(fn, recursion, kRecursion);                                                    \
+  BENCHMARK_CAPTURE(fn, strings, kStrings);                                                        \
+  BENCHMARK_CAPTURE(fn, build_string, kBuildString);                                               \
+  BENCHMARK_CAPTURE(fn, arrays, kArrays);                                                          \
+  BENCHMARK_CAPTURE(fn, dicts, kDicts);                                                            \
+  BENCHMARK_CAPTURE(fn, modules, kModules);                                                        \
+  BENCHMARK_CAPTURE(fn, guards, kGuards)
+
+BENCHMARK_WORKLOADS(BM_Lex);
+BENCHMARK_WORKLOADS(BM_Parse);
+BENCHMARK_WORKLOADS(BM_ParseLL);
+BENCHMARK_WORKLOADS(BM_ParseCold);
+BENCHMARK_WORKLOADS(BM_ParseToAst);
+BENCHMARK_WORKLOADS(BM_ParseNative);
+BENCHMARK_WORKLOADS(BM_SourceUnitMemory);
+BENCHMARK_WORKLOADS(BM_ProgramMemory);
+BENCHMARK_WORKLOADS(BM_FunctionDefs);
+BENCHMARK_WORKLOADS(BM_Execute);
+BENCHMARK_WORKLOADS(BM_Compile);
+BENCHMARK_WORKLOADS(BM_LoadCompiled);
+BENCHMARK_WORKLOADS(BM_VMExecute);
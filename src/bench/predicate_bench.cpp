@@ -0,0 +1,73 @@
+#include "benchmark/benchmark.h"
+#include "bench/alloc_counter.h"
+#include "core/parser/ast.h"
+#include "core/parser/lexer.h"
+#include "core/parser/predicate.h"
+
+#include <string>
+#include <vector>
+
+using namespace wwiv::core::parser;
+using namespace wwivbasic::bench;
+
+namespace {
+
+constexpr const char* kCondition = "user.sl >= 100 && user.age > 18 && user.name != \"guest\"";
+
+VariableSlots user_slots() {
+  VariableSlots slots;
+  slots.add("user.sl");
+  slots.add("user.age");
+  slots.add("user.name");
+  return slots;
+}
+
+const std::vector<PredicateValue> kUser{PredicateValue(200), PredicateValue(30),
+                                        PredicateValue("rushfan")};
+
+} // namespace
+
+// Adds an "allocs_per_op" counter with the heap allocations made since start.
+static void report_allocations(benchmark::State& state, uint64_t start) {
+  state.counters["allocs_per_op"] = benchmark::Counter(static_cast<double>(allocations() - start),
+                                                       benchmark::Counter::kAvgIterations);
+}
+
+// What each evaluation costs without a compiled predicate: lexing and
+// parsing the condition again, before walking it.
+static void BM_Predicate_Parse(benchmark::State& state) {
+  const auto start = allocations();
+  for (auto _ : state) {
+    Lexer l(kCondition);
+    Ast ast;
+    auto ok = ast.parse(l);
+    benchmark::DoNotOptimize(ok);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Predicate_Parse);
+
+static void BM_Predicate_Evaluate(benchmark::State& state) {
+  const Predicate predicate(kCondition, user_slots());
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto r = predicate.matches(kUser);
+    benchmark::DoNotOptimize(r);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Predicate_Evaluate);
+
+// The condition looked up by its text each time, as a caller holding only
+// the text does.
+static void BM_Predicate_Cached(benchmark::State& state) {
+  PredicateCache cache(user_slots(), 64);
+  const std::string text(kCondition);
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto r = cache.get(text)->matches(kUser);
+    benchmark::DoNotOptimize(r);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Predicate_Cached);
@@ -0,0 +1,60 @@
+#include "benchmark/benchmark.h"
+#include "context.h"
+#include "core/log.h"
+#include "executor.h"
+#include "function_def_visitor.h"
+#include "trace.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace wwivbasic;
+using namespace wwiv::core;
+
+namespace {
+
+constexpr const char* kLoopScript = R"(def add(a, b)
+  return a + b
+enddef
+total = 0
+FOR i = 1 to 200
+  total = add(total, i * 2)
+  If total > 1000 Then
+    x = total MOD 7
+  EndIf
+NEXT
+)";
+
+// Appender that drops messages, so traced runs measure formatting, not I/O.
+class NullAppender : public Appender {
+public:
+  bool append(const std::string&) override { return true; }
+};
+
+// Runs kLoopScript on the tree-walking interpreter at the given verbosity.
+void run_traced(benchmark::State& state, int verbosity) {
+  Context ec;
+  ec.add_source("bench.bas", kLoopScript);
+  auto tree = ec.parseTree("bench.bas");
+  FunctionDefVisitor fd(ec);
+  fd.visit(tree.value());
+
+  auto appender = std::make_shared<NullAppender>();
+  Logger::config().add_appender(LoggerLevel::verbose, appender);
+  Logger::set_cmdline_verbosity(verbosity);
+  for (auto _ : state) {
+    ExecutionVisitor v(ec);
+    v.visit(tree.value());
+  }
+  Logger::set_cmdline_verbosity(0);
+  Logger::config().log_to[LoggerLevel::verbose].erase(appender);
+}
+
+} // namespace
+
+// Executes a script with trace verbosity 0 (off) through TRACE_EXPRESSIONS.
+static void BM_Execute_Trace(benchmark::State& state) {
+  run_traced(state, static_cast<int>(state.range(0)));
+}
+BENCHMARK(BM_Execute_Trace)->DenseRange(0, TRACE_EXPRESSIONS);
@@ -0,0 +1,154 @@
+#include "benchmark/benchmark.h"
+#include "bench/alloc_counter.h"
+#include "type_feedback.h"
+#include "value.h"
+
+#include <string>
+
+using namespace wwivbasic;
+using namespace wwivbasic::bench;
+
+// Adds an "allocs_per_op" counter with the heap allocations made since start.
+static void report_allocations(benchmark::State& state, uint64_t start) {
+  state.counters["allocs_per_op"] = benchmark::Counter(static_cast<double>(allocations() - start),
+                                                       benchmark::Counter::kAvgIterations);
+}
+
+static void BM_Value_IntAdd(benchmark::State& state) {
+  Value a(1);
+  const Value b(2);
+  const auto start = allocations();
+  for (auto _ : state) {
+    a = a + b;
+    benchmark::DoNotOptimize(a);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_IntAdd);
+
+static void BM_Value_IntCompare(benchmark::State& state) {
+  const Value a(1);
+  const Value b(2);
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto r = a < b;
+    benchmark::DoNotOptimize(r);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_IntCompare);
+
+static void BM_Value_CopySmallString(benchmark::State& state) {
+  const Value a("Hello");
+  const auto start = allocations();
+  for (auto _ : state) {
+    Value b(a);
+    benchmark::DoNotOptimize(b);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_CopySmallString);
+
+static void BM_Value_CopyLongString(benchmark::State& state) {
+  const Value a(std::string(200, 'x'));
+  const auto start = allocations();
+  for (auto _ : state) {
+    Value b(a);
+    benchmark::DoNotOptimize(b);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_CopyLongString);
+
+static void BM_Value_StringCompare(benchmark::State& state) {
+  const Value a(std::string(40, 'x'));
+  const Value b(std::string(40, 'y'));
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto r = a == b;
+    benchmark::DoNotOptimize(r);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_StringCompare);
+
+static void BM_Value_StringToInt(benchmark::State& state) {
+  const Value a("12345");
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto r = a.toInt();
+    benchmark::DoNotOptimize(r);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_StringToInt);
+
+static void BM_Value_SmallConcat(benchmark::State& state) {
+  const Value a("Hello, ");
+  const Value b("World");
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto r = a + b;
+    benchmark::DoNotOptimize(r);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_SmallConcat);
+
+// Builds a 100KB string ten characters at a time, copying it each time as
+// s = s + x did, and then appending in place as it does now.
+static void BM_Value_BuildStringConcat(benchmark::State& state) {
+  const Value piece("0123456789");
+  const auto start = allocations();
+  for (auto _ : state) {
+    Value s("");
+    for (int i = 0; i < 10000; i++) {
+      s = s + piece;
+    }
+    benchmark::DoNotOptimize(s);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_BuildStringConcat);
+
+static void BM_Value_BuildStringAppend(benchmark::State& state) {
+  const Value piece("0123456789");
+  const auto start = allocations();
+  for (auto _ : state) {
+    Value s("");
+    for (int i = 0; i < 10000; i++) {
+      s.append(piece);
+    }
+    benchmark::DoNotOptimize(s);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_Value_BuildStringAppend);
+
+// The same operations through a TypeFeedback, as the VM and tree walker
+// apply them once a site has only seen integers.
+static void BM_TypeFeedback_IntAdd(benchmark::State& state) {
+  TypeFeedback feedback;
+  Value a(1);
+  const Value b(2);
+  const auto start = allocations();
+  for (auto _ : state) {
+    a = feedback.apply(ast::BinaryOp::ADD, a, b);
+    benchmark::DoNotOptimize(a);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_TypeFeedback_IntAdd);
+
+static void BM_TypeFeedback_IntCompare(benchmark::State& state) {
+  TypeFeedback feedback;
+  const Value a(1);
+  const Value b(2);
+  const auto start = allocations();
+  for (auto _ : state) {
+    auto r = feedback.apply(ast::BinaryOp::LT, a, b);
+    benchmark::DoNotOptimize(r);
+  }
+  report_allocations(state, start);
+}
+BENCHMARK(BM_TypeFeedback_IntCompare);
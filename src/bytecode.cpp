@@ -0,0 +1,180 @@
+#include "bytecode.h"
+#include "core/stl.h"
+#include "core/strings.h"
+#include "fmt/format.h"
+#include "utils.h"
+
+#include <string>
+
+namespace wwivbasic {
+
+int Chunk::emit(OpCode op, int32_t a, int32_t b, int line) {
+  code.push_back(Instruction{op, a, b});
+  lines.push_back(line);
+  return size() - 1;
+}
+
+void Chunk::patch(int at) { code.at(at).a = size(); }
+
+int Chunk::add_constant(const Value& v) {
+  constants.push_back(v);
+  return wwiv::stl::size_int(constants) - 1;
+}
+
+int Chunk::add_name(const std::string& n) {
+  for (int i = 0; i < wwiv::stl::size_int(names); i++) {
+    if (names[i] == n) {
+      return i;
+    }
+  }
+  names.push_back(n);
+  return wwiv::stl::size_int(names) - 1;
+}
+
+std::string to_string(OpCode op) {
+  switch (op) {
+  case OpCode::CONST: return "CONST";
+  case OpCode::POP: return "POP";
+  case OpCode::LOAD_LOCAL: return "LOAD_LOCAL";
+  case OpCode::STORE_LOCAL: return "STORE_LOCAL";
+  case OpCode::LOAD_GLOBAL: return "LOAD_GLOBAL";
+  case OpCode::STORE_GLOBAL: return "STORE_GLOBAL";
+  case OpCode::LOAD_NAME: return "LOAD_NAME";
+  case OpCode::STORE_NAME: return "STORE_NAME";
+  case OpCode::ADD: return "ADD";
+  case OpCode::SUB: return "SUB";
+  case OpCode::MUL: return "MUL";
+  case OpCode::DIV: return "DIV";
+  case OpCode::MOD: return "MOD";
+  case OpCode::BOOL: return "BOOL";
+  case OpCode::EQ: return "EQ";
+  case OpCode::NE: return "NE";
+  case OpCode::LT: return "LT";
+  case OpCode::LE: return "LE";
+  case OpCode::GT: return "GT";
+  case OpCode::GE: return "GE";
+  case OpCode::JUMP: return "JUMP";
+  case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+  case OpCode::JUMP_IF_FALSE_OR_POP: return "JUMP_IF_FALSE_OR_POP";
+  case OpCode::JUMP_IF_TRUE_OR_POP: return "JUMP_IF_TRUE_OR_POP";
+  case OpCode::APPEND_LOCAL: return "APPEND_LOCAL";
+  case OpCode::APPEND_GLOBAL: return "APPEND_GLOBAL";
+  case OpCode::NEW_ARRAY: return "NEW_ARRAY";
+  case OpCode::NEW_DICT: return "NEW_DICT";
+  case OpCode::LOAD_ELEMENT: return "LOAD_ELEMENT";
+  case OpCode::STORE_ELEMENT_LOCAL: return "STORE_ELEMENT_LOCAL";
+  case OpCode::STORE_ELEMENT_GLOBAL: return "STORE_ELEMENT_GLOBAL";
+  case OpCode::STORE_ELEMENT_NAME: return "STORE_ELEMENT_NAME";
+  case OpCode::FOR_PREP: return "FOR_PREP";
+  case OpCode::FOR_NEXT: return "FOR_NEXT";
+  case OpCode::CALL: return "CALL";
+  case OpCode::RETURN: return "RETURN";
+  case OpCode::IMPORT: return "IMPORT";
+  case OpCode::HALT: return "HALT";
+  }
+  return fmt::format("UNKNOWN ({})", static_cast<int>(op));
+}
+
+void Program::link() {
+  auto link_chunk = [this](Chunk& chunk) {
+    chunk.callees.clear();
+    for (const auto& n : chunk.names) {
+      chunk.callees.push_back(find_function(n));
+    }
+  };
+  link_chunk(main);
+  main.index = 0;
+  for (size_t i = 0; i < functions.size(); i++) {
+    link_chunk(*functions[i]);
+    functions[i]->index = static_cast<int>(i) + 1;
+  }
+}
+
+const Chunk* Program::find_function(const std::string& name) const {
+  // Unqualified names are functions of the root module.
+  const auto [module, id] = split_package_from_id(name);
+  for (const auto& fn : functions) {
+    if (wwiv::strings::iequals(fn->module, module) && wwiv::strings::iequals(fn->name, id)) {
+      return fn.get();
+    }
+  }
+  return nullptr;
+}
+
+int Program::global_index(const std::string& name) const {
+  for (int i = 0; i < wwiv::stl::size_int(globals); i++) {
+    if (wwiv::strings::iequals(globals[i], name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+std::string disassemble(const Program& program, const Chunk& chunk) {
+  std::string s = fmt::format("== {} ==\n", chunk.name);
+  for (int i = 0; i < chunk.size(); i++) {
+    const auto& ins = chunk.code[i];
+    std::string operand;
+    switch (ins.op) {
+    case OpCode::CONST:
+      operand = fmt::format("{} ({})", ins.a, chunk.constants.at(ins.a));
+      break;
+    case OpCode::LOAD_LOCAL:
+    case OpCode::STORE_LOCAL:
+    case OpCode::STORE_ELEMENT_LOCAL:
+      operand = fmt::format("{} ({})", ins.a, chunk.local_names.at(ins.a));
+      break;
+    case OpCode::LOAD_GLOBAL:
+    case OpCode::STORE_GLOBAL:
+    case OpCode::STORE_ELEMENT_GLOBAL:
+      operand = fmt::format("{} ({})", ins.a, program.globals.at(ins.a));
+      break;
+    case OpCode::APPEND_LOCAL:
+      operand = fmt::format("{} ({}) values: {}", ins.a, chunk.local_names.at(ins.a), ins.b);
+      break;
+    case OpCode::APPEND_GLOBAL:
+      operand = fmt::format("{} ({}) values: {}", ins.a, program.globals.at(ins.a), ins.b);
+      break;
+    case OpCode::LOAD_NAME:
+    case OpCode::STORE_NAME:
+    case OpCode::STORE_ELEMENT_NAME:
+    case OpCode::IMPORT:
+      operand = fmt::format("{} ({})", ins.a, chunk.names.at(ins.a));
+      break;
+    case OpCode::NEW_ARRAY:
+      operand = fmt::format("type: {}", ins.a);
+      break;
+    case OpCode::NEW_DICT:
+      operand = fmt::format("entries: {}", ins.a);
+      break;
+    case OpCode::CALL:
+      operand = fmt::format("{} ({}) args: {}", ins.a, chunk.names.at(ins.a), ins.b);
+      break;
+    case OpCode::JUMP:
+    case OpCode::JUMP_IF_FALSE:
+    case OpCode::JUMP_IF_FALSE_OR_POP:
+    case OpCode::JUMP_IF_TRUE_OR_POP:
+      operand = fmt::format("-> {:04}", ins.a);
+      break;
+    case OpCode::FOR_PREP:
+    case OpCode::FOR_NEXT:
+      operand = fmt::format("-> {:04} var: {}", ins.a, ins.b);
+      break;
+    default:
+      break;
+    }
+    s += fmt::format("{:04} {:4} {:<20} {}\n", i, chunk.lines.at(i), to_string(ins.op), operand);
+  }
+  return s;
+}
+
+std::string disassemble(const Program& program) {
+  auto s = disassemble(program, program.main);
+  for (const auto& fn : program.functions) {
+    s += "\n";
+    s += disassemble(program, *fn);
+  }
+  return s;
+}
+
+} // namespace wwivbasic
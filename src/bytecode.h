@@ -0,0 +1,143 @@
+#pragma once
+
+#include "value.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wwivbasic {
+
+enum class OpCode : uint8_t {
+  // Stack
+  CONST,         // push constants[a]
+  POP,           // discard top of stack
+  // Variables
+  LOAD_LOCAL,    // push frame slot a
+  STORE_LOCAL,   // pop into frame slot a
+  LOAD_GLOBAL,   // push global slot a
+  STORE_GLOBAL,  // pop into global slot a
+  LOAD_NAME,     // push variable names[a], looked up by name at runtime
+  STORE_NAME,    // pop into variable names[a], looked up by name at runtime
+  // var = var + x + y ... where var has a slot: pop b values and append them,
+  // in order, to the variable in place (Value::append).
+  APPEND_LOCAL,  // append to local slot a
+  APPEND_GLOBAL, // append to global slot a
+  // DIM arrays and dictionaries, whose elements are indexed by key.  Stores
+  // pop the value, then the index or key.
+  NEW_ARRAY,            // replace the size on top with an array of type a (Value::Type)
+  NEW_DICT,             // pop a key, value pairs, push a dictionary of them in order
+  LOAD_ELEMENT,         // pop the index, replace the array on top with its element
+  STORE_ELEMENT_LOCAL,  // store into an element of the array in local slot a
+  STORE_ELEMENT_GLOBAL, // store into an element of the array in global slot a
+  STORE_ELEMENT_NAME,   // store into an element of the array in variable names[a]
+  // Arithmetic operators.  All pop right, then left.
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  MOD,
+  BOOL,          // replace top of stack with TRUE or FALSE (Value::toBool)
+  // Relational operators
+  EQ,
+  NE,
+  LT,
+  LE,
+  GT,
+  GE,
+  // Control flow
+  JUMP,          // ip = a
+  JUMP_IF_FALSE, // pop; if false ip = a
+  // Short circuit AND and OR: the left operand decides the result, leaving
+  // it on the stack, or is popped so the right operand can be evaluated.
+  JUMP_IF_FALSE_OR_POP, // if top is false, replace it with FALSE and ip = a; else pop
+  JUMP_IF_TRUE_OR_POP,  // if top is true, replace it with TRUE and ip = a; else pop
+  // Counted FOR loops.  Slot b holds the loop variable, and the two slots
+  // after it hold the end and the step.  The slots are globals in the main
+  // chunk and locals in a DEF.
+  FOR_PREP,      // make the loop slots integers; if the loop runs no times ip = a
+  FOR_NEXT,      // add the step to the loop variable; if still in range ip = a
+  CALL,          // call names[a] with b arguments from the stack, push result
+  RETURN,        // pop the result and return from the chunk
+  IMPORT,        // import module names[a]
+  HALT
+};
+
+struct Instruction {
+  OpCode op;
+  int32_t a{0};
+  int32_t b{0};
+};
+
+/**
+ * A compiled sequence of instructions along with the constants and names
+ * it references.  The main body and each DEF are compiled into their
+ * own chunk.
+ */
+class Chunk {
+public:
+  explicit Chunk(const std::string& n) : name(n) {}
+
+  // Appends an instruction, returning its index.
+  int emit(OpCode op, int32_t a, int32_t b, int line);
+  int emit(OpCode op, int line) { return emit(op, 0, 0, line); }
+  int emit(OpCode op, int32_t a, int line) { return emit(op, a, 0, line); }
+  // Points the jump at index "at" to the next instruction emitted.
+  void patch(int at);
+  int add_constant(const Value& v);
+  int add_name(const std::string& n);
+  int size() const noexcept { return static_cast<int>(code.size()); }
+
+  std::string name;
+  // Module owning this function, empty for the root module.
+  std::string module;
+  std::vector<std::string> params;
+  // Number of frame slots, the parameters occupy the first slots.
+  int num_locals{0};
+  // Variable name for each frame slot, used for debugging.
+  std::vector<std::string> local_names;
+  std::vector<Instruction> code;
+  // Source line for each instruction in code.
+  std::vector<int> lines;
+  std::vector<Value> constants;
+  std::vector<std::string> names;
+  // For each of names, the DEF in the same program that it calls, or null.
+  // Filled in by Program::link.
+  std::vector<const Chunk*> callees;
+  // Position of this chunk in its program: 0 for main, then 1 + its index in
+  // functions.  Filled in by Program::link.
+  int index{0};
+};
+
+/**
+ * The compiled form of a source unit.
+ *
+ * Once linked a program is never modified, all execution state lives in
+ * the VM, so one program may be shared by any number of VMs running on any
+ * number of threads.
+ */
+class Program {
+public:
+  Program() : main("<MAIN>") {}
+
+  // Resolves the calls in every chunk to the DEFs of this program.  Must be
+  // called after the last chunk is added.
+  void link();
+  // Returns the DEF called by name (which may be module qualified), or null.
+  const Chunk* find_function(const std::string& name) const;
+  // Returns the global slot for a variable name, or -1 if none exists.
+  int global_index(const std::string& name) const;
+
+  Chunk main;
+  std::vector<std::unique_ptr<Chunk>> functions;
+  // Variable name for each global slot.  Slots used by FOR loops in the
+  // main body shadow any global of the same name.
+  std::vector<std::string> globals;
+};
+
+std::string to_string(OpCode op);
+std::string disassemble(const Program& program, const Chunk& chunk);
+std::string disassemble(const Program& program);
+
+} // namespace wwivbasic
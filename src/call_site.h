@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+namespace wwivbasic {
+
+class BasicFunction;
+class Module;
+
+// Generation of the functions and modules of one Context.  It changes
+// whenever a function or module of that Context is added or replaced, so
+// that cached function lookups can tell when a name may resolve
+// differently.  Other Contexts have their own, so building or changing one
+// leaves the call sites of the rest alone.
+class FunctionGeneration {
+public:
+  uint64_t value() const noexcept { return value_; }
+  // Marks every CallSite set at this generation as stale.
+  void invalidate() noexcept { value_++; }
+
+private:
+  // Starts at 1 so that a CallSite that was never set is never current.
+  uint64_t value_{1};
+};
+
+/**
+ * Inline cache of the function called at one call site.
+ *
+ * The cached function is only used while the function generation of the
+ * Context and the module making the call are the same as when it was
+ * resolved, so a resolved call costs two comparisons rather than looking
+ * the function up by name.
+ */
+class CallSite {
+public:
+  // Returns the cached function when called from module "from" of the
+  // Context at generation, or null if the call must be resolved again.
+  BasicFunction* get(const Module* from, const FunctionGeneration& generation) const noexcept {
+    return from_ == from && generation_ == generation.value() ? fn_ : nullptr;
+  }
+  // Module owning the cached function.
+  Module* module() const noexcept { return module_; }
+
+  void set(const Module* from, Module* module, BasicFunction* fn,
+           const FunctionGeneration& generation) noexcept {
+    generation_ = generation.value();
+    from_ = from;
+    module_ = module;
+    fn_ = fn;
+  }
+
+private:
+  uint64_t generation_{0};
+  const Module* from_{nullptr};
+  Module* module_{nullptr};
+  BasicFunction* fn_{nullptr};
+};
+
+} // namespace wwivbasic
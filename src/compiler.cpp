@@ -0,0 +1,489 @@
+#include "compiler.h"
+#include "ast_builder.h"
+#include "context.h"
+#include "core/stl.h"
+#include "core/strings.h"
+#include "fmt/format.h"
+#include "optimizer.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace wwivbasic {
+
+using namespace wwiv::stl;
+using namespace wwiv::strings;
+
+static OpCode to_opcode(ast::BinaryOp op) {
+  switch (op) {
+  case ast::BinaryOp::ADD: return OpCode::ADD;
+  case ast::BinaryOp::SUB: return OpCode::SUB;
+  case ast::BinaryOp::MUL: return OpCode::MUL;
+  case ast::BinaryOp::DIV: return OpCode::DIV;
+  case ast::BinaryOp::MOD: return OpCode::MOD;
+  case ast::BinaryOp::EQ: return OpCode::EQ;
+  case ast::BinaryOp::NE: return OpCode::NE;
+  case ast::BinaryOp::LT: return OpCode::LT;
+  case ast::BinaryOp::LE: return OpCode::LE;
+  case ast::BinaryOp::GT: return OpCode::GT;
+  case ast::BinaryOp::GE: return OpCode::GE;
+  case ast::BinaryOp::AND:
+  case ast::BinaryOp::OR:
+    // Short circuit, see compile_logical.
+    break;
+  }
+  throw std::invalid_argument(fmt::format("Unknown binary op: {}", static_cast<int>(op)));
+}
+
+// True if evaluating e may call a function, which may change any variable.
+static bool contains_call(const ast::Expr& e) {
+  switch (e.kind) {
+  case ast::ExprKind::CALL:
+    return true;
+  case ast::ExprKind::BINARY: {
+    const auto& b = static_cast<const ast::BinaryExpr&>(e);
+    return contains_call(*b.left) || contains_call(*b.right);
+  }
+  case ast::ExprKind::INDEX:
+    return contains_call(*static_cast<const ast::IndexExpr&>(e).index);
+  case ast::ExprKind::DICT:
+    for (const auto& entry : static_cast<const ast::DictExpr&>(e).entries) {
+      if (contains_call(*entry.key) || contains_call(*entry.value)) {
+        return true;
+      }
+    }
+    return false;
+  default:
+    return false;
+  }
+}
+
+std::unique_ptr<Program> Compiler::compile(const ast::Unit& unit) {
+  auto program = std::make_unique<Program>();
+  program_ = program.get();
+  globals_.clear();
+  // Every variable assigned in the main body is a global, so that DEFs can
+  // reference them no matter the order of definition.
+  chunk_ = &program->main;
+  std::vector<std::string> loop_vars;
+  std::vector<std::string> names;
+  collect_assigned(unit.statements, loop_vars, names);
+  for (const auto& n : names) {
+    globals_.emplace(n, new_slot(n));
+  }
+
+  for (const auto& def : unit.procedures) {
+    auto chunk = std::make_unique<Chunk>(def.name);
+    compile_procedure(def, *chunk);
+    program->functions.push_back(std::move(chunk));
+  }
+
+  chunk_ = &program->main;
+  scopes_.clear();
+  compile_block(unit.statements);
+  chunk_->emit(OpCode::HALT, 0);
+  chunk_ = nullptr;
+  program_ = nullptr;
+  program->link();
+  return program;
+}
+
+void Compiler::collect_assigned(const ast::Block& block, std::vector<std::string>& loop_vars,
+                                std::vector<std::string>& names) {
+  const auto add = [&](const std::string& name) {
+    const auto eq = [&](const auto& v) { return iequals(v, name); };
+    if (name.find('.') == std::string::npos &&
+        std::none_of(std::begin(loop_vars), std::end(loop_vars), eq) &&
+        std::none_of(std::begin(names), std::end(names), eq)) {
+      names.push_back(name);
+    }
+  };
+  for (const auto& stmt : block) {
+    switch (stmt->kind) {
+    case ast::StmtKind::ASSIGN: {
+      const auto& s = static_cast<const ast::AssignStmt&>(*stmt);
+      // Storing into an element does not create the array.
+      if (!s.index) {
+        add(s.name);
+      }
+    } break;
+    case ast::StmtKind::DIM:
+      add(static_cast<const ast::DimStmt&>(*stmt).name);
+      break;
+    case ast::StmtKind::IF: {
+      const auto& s = static_cast<const ast::IfStmt&>(*stmt);
+      for (const auto& branch : s.branches) {
+        collect_assigned(branch.body, loop_vars, names);
+      }
+      collect_assigned(s.else_body, loop_vars, names);
+    } break;
+    case ast::StmtKind::FOR: {
+      const auto& s = static_cast<const ast::ForStmt&>(*stmt);
+      loop_vars.push_back(s.var);
+      collect_assigned(s.body, loop_vars, names);
+      loop_vars.pop_back();
+    } break;
+    default:
+      break;
+    }
+  }
+}
+
+void Compiler::compile_procedure(const ast::ProcedureDef& def, Chunk& chunk) {
+  chunk.module = def.module;
+  chunk.params = def.params;
+  chunk_ = &chunk;
+  scopes_.clear();
+  scopes_.emplace_back();
+  for (const auto& p : def.params) {
+    scopes_.back().insert_or_assign(p, new_slot(p));
+  }
+  // Assigning to a variable that is not a parameter or global creates a
+  // local variable.
+  std::vector<std::string> loop_vars;
+  std::vector<std::string> names;
+  collect_assigned(def.body, loop_vars, names);
+  for (const auto& n : names) {
+    if (resolve(n).type == SlotType::NAME) {
+      scopes_.back().emplace(n, new_slot(n));
+    }
+  }
+  compile_block(def.body);
+  // Falling off the end of a DEF returns an empty value.
+  chunk_->emit(OpCode::CONST, chunk_->add_constant(Value()), def.line);
+  chunk_->emit(OpCode::RETURN, def.line);
+  scopes_.clear();
+}
+
+Compiler::Slot Compiler::new_slot(const std::string& name) {
+  if (chunk_ == &program_->main) {
+    program_->globals.push_back(name);
+    return Slot{SlotType::GLOBAL, size_int(program_->globals) - 1};
+  }
+  chunk_->local_names.push_back(name);
+  return Slot{SlotType::LOCAL, chunk_->num_locals++};
+}
+
+Compiler::Slot Compiler::resolve(const std::string& name) const {
+  for (auto it = std::rbegin(scopes_); it != std::rend(scopes_); ++it) {
+    if (const auto f = it->find(name); f != std::end(*it)) {
+      return f->second;
+    }
+  }
+  if (const auto f = globals_.find(name); f != std::end(globals_)) {
+    return f->second;
+  }
+  return Slot{SlotType::NAME, -1};
+}
+
+Compiler::Slot Compiler::resolve_for_store(const std::string& name) {
+  auto slot = resolve(name);
+  if (slot.type != SlotType::NAME || name.find('.') != std::string::npos) {
+    return slot;
+  }
+  slot = new_slot(name);
+  if (chunk_ == &program_->main) {
+    globals_.emplace(name, slot);
+  } else {
+    scopes_.front().emplace(name, slot);
+  }
+  return slot;
+}
+
+void Compiler::emit_load(const Slot& slot, int line) {
+  chunk_->emit(slot.type == SlotType::LOCAL ? OpCode::LOAD_LOCAL : OpCode::LOAD_GLOBAL, slot.index,
+               line);
+}
+
+void Compiler::emit_store(const Slot& slot, int line) {
+  chunk_->emit(slot.type == SlotType::LOCAL ? OpCode::STORE_LOCAL : OpCode::STORE_GLOBAL,
+               slot.index, line);
+}
+
+void Compiler::emit_load(const std::string& name, int line) {
+  if (const auto slot = resolve(name); slot.type != SlotType::NAME) {
+    emit_load(slot, line);
+    return;
+  }
+  chunk_->emit(OpCode::LOAD_NAME, chunk_->add_name(name), line);
+}
+
+void Compiler::emit_store(const std::string& name, int line) {
+  if (const auto slot = resolve_for_store(name); slot.type != SlotType::NAME) {
+    emit_store(slot, line);
+    return;
+  }
+  chunk_->emit(OpCode::STORE_NAME, chunk_->add_name(name), line);
+}
+
+void Compiler::compile_block(const ast::Block& block) {
+  for (const auto& stmt : block) {
+    compile_stmt(*stmt);
+  }
+}
+
+void Compiler::compile_stmt(const ast::Stmt& stmt) {
+  switch (stmt.kind) {
+  case ast::StmtKind::ASSIGN: {
+    const auto& s = static_cast<const ast::AssignStmt&>(stmt);
+    if (s.index) {
+      compile_store_element(s);
+    } else if (!compile_append(s)) {
+      compile_expr(*s.value);
+      emit_store(s.name, s.line);
+    }
+  } break;
+  case ast::StmtKind::DIM: {
+    const auto& s = static_cast<const ast::DimStmt&>(stmt);
+    compile_expr(*s.size);
+    chunk_->emit(OpCode::NEW_ARRAY, static_cast<int32_t>(s.type), s.line);
+    emit_store(s.name, s.line);
+  } break;
+  case ast::StmtKind::CALL: {
+    const auto& s = static_cast<const ast::CallStmt&>(stmt);
+    compile_call(*s.call);
+    chunk_->emit(OpCode::POP, s.line);
+  } break;
+  case ast::StmtKind::IF:
+    compile_if(static_cast<const ast::IfStmt&>(stmt));
+    break;
+  case ast::StmtKind::FOR:
+    compile_for(static_cast<const ast::ForStmt&>(stmt));
+    break;
+  case ast::StmtKind::BREAK:
+    // Jumps past the end of the innermost loop.  Outside of a loop BREAK
+    // does nothing.
+    if (!breaks_.empty()) {
+      breaks_.back().push_back(chunk_->emit(OpCode::JUMP, stmt.line));
+    }
+    break;
+  case ast::StmtKind::RETURN: {
+    const auto& s = static_cast<const ast::ReturnStmt&>(stmt);
+    compile_expr(*s.value);
+    chunk_->emit(OpCode::RETURN, s.line);
+  } break;
+  case ast::StmtKind::IMPORT: {
+    const auto& s = static_cast<const ast::ImportStmt&>(stmt);
+    if (!s.file) {
+      chunk_->emit(OpCode::IMPORT, chunk_->add_name(s.name), s.line);
+    }
+  } break;
+  }
+}
+
+// var = var + x + y ...
+//
+// Compiles x, y, ... and appends them to var in place, rather than loading
+// (copying) var to add to it, which makes building a long string with
+// repeated appends linear rather than quadratic.  Only done for variables
+// with slots, and only when none of x, y, ... calls a function, since var
+// must be read before a call that may change it.  Returns false, compiling
+// nothing, for any other assignment.
+bool Compiler::compile_append(const ast::AssignStmt& stmt) {
+  std::vector<const ast::Expr*> tail;
+  const auto* e = stmt.value.get();
+  while (e->kind == ast::ExprKind::BINARY &&
+         static_cast<const ast::BinaryExpr*>(e)->op == ast::BinaryOp::ADD) {
+    const auto* add = static_cast<const ast::BinaryExpr*>(e);
+    tail.push_back(add->right.get());
+    e = add->left.get();
+  }
+  if (tail.empty() || e->kind != ast::ExprKind::VARIABLE ||
+      !iequals(static_cast<const ast::VariableRef*>(e)->name, stmt.name)) {
+    return false;
+  }
+  if (std::any_of(std::begin(tail), std::end(tail),
+                  [](const ast::Expr* x) { return contains_call(*x); })) {
+    return false;
+  }
+  const auto slot = resolve(stmt.name);
+  if (slot.type == SlotType::NAME) {
+    return false;
+  }
+  for (auto it = std::rbegin(tail); it != std::rend(tail); ++it) {
+    compile_expr(**it);
+  }
+  chunk_->emit(slot.type == SlotType::LOCAL ? OpCode::APPEND_LOCAL : OpCode::APPEND_GLOBAL,
+               slot.index, size_int(tail), stmt.line);
+  return true;
+}
+
+// name[index] = value
+//
+// Stores into the array or dictionary in place, so that it is only copied
+// when another variable shares it.
+void Compiler::compile_store_element(const ast::AssignStmt& stmt) {
+  compile_expr(*stmt.index);
+  compile_expr(*stmt.value);
+  switch (const auto slot = resolve(stmt.name); slot.type) {
+  case SlotType::LOCAL:
+    chunk_->emit(OpCode::STORE_ELEMENT_LOCAL, slot.index, stmt.line);
+    break;
+  case SlotType::GLOBAL:
+    chunk_->emit(OpCode::STORE_ELEMENT_GLOBAL, slot.index, stmt.line);
+    break;
+  case SlotType::NAME:
+    chunk_->emit(OpCode::STORE_ELEMENT_NAME, chunk_->add_name(stmt.name), stmt.line);
+    break;
+  }
+}
+
+void Compiler::compile_if(const ast::IfStmt& stmt) {
+  std::vector<int> end_jumps;
+  for (const auto& branch : stmt.branches) {
+    compile_expr(*branch.condition);
+    const auto next = chunk_->emit(OpCode::JUMP_IF_FALSE, stmt.line);
+    compile_block(branch.body);
+    end_jumps.push_back(chunk_->emit(OpCode::JUMP, stmt.line));
+    chunk_->patch(next);
+  }
+  if (stmt.has_else) {
+    compile_block(stmt.else_body);
+  }
+  for (const auto j : end_jumps) {
+    chunk_->patch(j);
+  }
+}
+
+// FOR var = start TO end STEP step
+//
+// start, end and step are evaluated once, before the loop, and kept as
+// integers in the two slots after the loop variable's, which can not be
+// referenced from BASIC.  The body runs while var <= end, or var >= end
+// when step is negative.  The body may modify the loop variable.  The loop
+// variable gets its own slot, shadowing any variable of the same name.
+void Compiler::compile_for(const ast::ForStmt& stmt) {
+  const auto line = stmt.line;
+  compile_expr(*stmt.start);
+  compile_expr(*stmt.end);
+  if (stmt.step) {
+    compile_expr(*stmt.step);
+  } else {
+    chunk_->emit(OpCode::CONST, chunk_->add_constant(Value(1)), line);
+  }
+  // new_slot numbers slots in order, so these are adjacent.
+  const auto var = new_slot(stmt.var);
+  const auto end = new_slot("");
+  const auto step = new_slot("");
+  emit_store(step, line);
+  emit_store(end, line);
+  emit_store(var, line);
+  scopes_.emplace_back();
+  scopes_.back().emplace(stmt.var, var);
+  breaks_.emplace_back();
+
+  const auto prep = chunk_->emit(OpCode::FOR_PREP, 0, var.index, line);
+  const auto top = chunk_->size();
+  compile_block(stmt.body);
+  chunk_->emit(OpCode::FOR_NEXT, top, var.index, line);
+  chunk_->patch(prep);
+  for (const auto b : breaks_.back()) {
+    chunk_->patch(b);
+  }
+  breaks_.pop_back();
+  scopes_.pop_back();
+}
+
+void Compiler::compile_expr(const ast::Expr& expr) {
+  switch (expr.kind) {
+  case ast::ExprKind::INT: {
+    const auto& e = static_cast<const ast::IntLiteral&>(expr);
+    chunk_->emit(OpCode::CONST, chunk_->add_constant(Value(e.value)), e.line);
+  } break;
+  case ast::ExprKind::STRING: {
+    const auto& e = static_cast<const ast::StringLiteral&>(expr);
+    chunk_->emit(OpCode::CONST, chunk_->add_constant(Value(e.value)), e.line);
+  } break;
+  case ast::ExprKind::BOOLEAN: {
+    const auto& e = static_cast<const ast::BoolLiteral&>(expr);
+    chunk_->emit(OpCode::CONST, chunk_->add_constant(Value(e.value)), e.line);
+  } break;
+  case ast::ExprKind::VARIABLE: {
+    const auto& e = static_cast<const ast::VariableRef&>(expr);
+    emit_load(e.name, e.line);
+  } break;
+  case ast::ExprKind::CALL:
+    compile_call(static_cast<const ast::CallExpr&>(expr));
+    break;
+  case ast::ExprKind::INDEX: {
+    const auto& e = static_cast<const ast::IndexExpr&>(expr);
+    emit_load(e.name, e.line);
+    compile_expr(*e.index);
+    chunk_->emit(OpCode::LOAD_ELEMENT, e.line);
+  } break;
+  case ast::ExprKind::DICT: {
+    const auto& e = static_cast<const ast::DictExpr&>(expr);
+    for (const auto& entry : e.entries) {
+      compile_expr(*entry.key);
+      compile_expr(*entry.value);
+    }
+    chunk_->emit(OpCode::NEW_DICT, size_int(e.entries), e.line);
+  } break;
+  case ast::ExprKind::BINARY: {
+    const auto& e = static_cast<const ast::BinaryExpr&>(expr);
+    if (e.op == ast::BinaryOp::AND || e.op == ast::BinaryOp::OR) {
+      compile_logical(e);
+      break;
+    }
+    compile_expr(*e.left);
+    compile_expr(*e.right);
+    chunk_->emit(to_opcode(e.op), e.line);
+  } break;
+  }
+}
+
+// left AND right, left OR right
+//
+// The right operand is only evaluated when the left one does not decide
+// the result.  The result is always TRUE or FALSE.
+void Compiler::compile_logical(const ast::BinaryExpr& expr) {
+  compile_expr(*expr.left);
+  const auto end = chunk_->emit(expr.op == ast::BinaryOp::AND ? OpCode::JUMP_IF_FALSE_OR_POP
+                                                              : OpCode::JUMP_IF_TRUE_OR_POP,
+                                expr.line);
+  compile_expr(*expr.right);
+  chunk_->emit(OpCode::BOOL, expr.line);
+  chunk_->patch(end);
+}
+
+void Compiler::compile_call(const ast::CallExpr& call) {
+  for (const auto& arg : call.args) {
+    compile_expr(*arg);
+  }
+  chunk_->emit(OpCode::CALL, chunk_->add_name(call.name), size_int(call.args), call.line);
+}
+
+std::unique_ptr<ast::Unit> parse_source(const std::string& filename, const std::string& text,
+                                        std::vector<std::string>& errors) {
+#ifdef WWIVBASIC_NATIVE_PARSER
+  Parser parser(filename, text);
+  auto unit = parser.parse();
+  if (!unit) {
+    errors.insert(std::end(errors), std::begin(parser.errors()), std::end(parser.errors()));
+  }
+  return unit;
+#else
+  SourceUnit su(filename, text);
+  if (!su.errors.empty()) {
+    errors.insert(std::end(errors), std::begin(su.errors), std::end(su.errors));
+    return nullptr;
+  }
+  return AstBuilder().build(filename, su.main());
+#endif
+}
+
+std::unique_ptr<Program> compile_source(const std::string& filename, const std::string& text,
+                                        std::vector<std::string>& errors) {
+  auto unit = parse_source(filename, text, errors);
+  if (!unit) {
+    return nullptr;
+  }
+  Optimizer().optimize(*unit);
+  return Compiler().compile(*unit);
+}
+
+} // namespace wwivbasic
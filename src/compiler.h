@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include "core/stl.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wwivbasic {
+
+/**
+ * Compiles the AST of a source unit into bytecode for the VM.
+ *
+ * Variables are resolved while compiling: parameters, locals and FOR loop
+ * variables of a DEF get frame slots, variables of the main body get
+ * global slots.  Only names that can not be resolved statically (such as
+ * module qualified names) are looked up by name at runtime.
+ */
+class Compiler {
+public:
+  Compiler() = default;
+
+  std::unique_ptr<Program> compile(const ast::Unit& unit);
+
+private:
+  enum class SlotType { LOCAL, GLOBAL, NAME };
+  struct Slot {
+    SlotType type;
+    int index;
+  };
+  typedef std::map<std::string, Slot, wwiv::stl::ci_less> names_t;
+
+  // Collects the names of variables assigned in a block, outside of FOR
+  // loops using the same name as their loop variable.
+  void collect_assigned(const ast::Block& block, std::vector<std::string>& loop_vars,
+                        std::vector<std::string>& names);
+  void compile_procedure(const ast::ProcedureDef& def, Chunk& chunk);
+  void compile_block(const ast::Block& block);
+  void compile_stmt(const ast::Stmt& stmt);
+  bool compile_append(const ast::AssignStmt& stmt);
+  void compile_store_element(const ast::AssignStmt& stmt);
+  void compile_if(const ast::IfStmt& stmt);
+  void compile_for(const ast::ForStmt& stmt);
+  void compile_expr(const ast::Expr& expr);
+  void compile_logical(const ast::BinaryExpr& expr);
+  void compile_call(const ast::CallExpr& call);
+
+  // Allocates a new frame slot (in a DEF) or global slot (in the main body).
+  Slot new_slot(const std::string& name);
+  Slot resolve(const std::string& name) const;
+  Slot resolve_for_store(const std::string& name);
+  void emit_load(const std::string& name, int line);
+  void emit_store(const std::string& name, int line);
+  void emit_load(const Slot& slot, int line);
+  void emit_store(const Slot& slot, int line);
+
+  Program* program_{nullptr};
+  Chunk* chunk_{nullptr};
+  // Global variables of the main body.
+  names_t globals_;
+  // Block scopes of the chunk being compiled, innermost last.  For a DEF
+  // the first scope holds the parameters and local variables.
+  std::vector<names_t> scopes_;
+  // For each FOR loop being compiled, innermost last, the jumps of its
+  // BREAK statements, to be patched to the end of the loop.
+  std::vector<std::vector<int>> breaks_;
+};
+
+// Parses the source text of a unit into its AST.  Nothing of the parse is
+// kept: the ANTLR token stream, parser and parse tree are released before
+// returning, leaving the AST self-contained.  Returns null, adding to
+// errors, when text does not parse.  Builds with WWIVBASIC_NATIVE_PARSER
+// parse with Parser rather than ANTLR.
+std::unique_ptr<ast::Unit> parse_source(const std::string& filename, const std::string& text,
+                                        std::vector<std::string>& errors);
+
+// Parses, optimizes and compiles the source text of a unit, as
+// parse_source does.  Returns null, adding to errors, when text does not
+// parse.
+std::unique_ptr<Program> compile_source(const std::string& filename, const std::string& text,
+                                        std::vector<std::string>& errors);
+
+} // namespace wwivbasic
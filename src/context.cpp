@@ -1,15 +1,20 @@
 #include "context.h"
 #include "core/textfile.h"
 #include "core/stl.h"
+#include "core/strings.h"
 #include "executor.h"
 #include "utils.h"
 #include "fmt/format.h"
+#include "stdlib/arrays.h"
 #include "stdlib/common.h"
+#include "stdlib/dicts.h"
 #include "stdlib/numbers.h"
 #include "stdlib/strings.h"
+#include "trace.h"
 
 #include <any>
 #include <map>
+#include <memory>
 #include <stack>
 #include <string>
 #include <vector>
@@ -18,101 +23,138 @@ using namespace wwiv::stl;
 
 namespace wwivbasic {
 
-void Module::upsert(const std::string& name, const Value& value) {
+Var* Scope::find(Atom name) {
+  for (size_t i = 0; i < size_; i++) {
+    if (vars_[i].name() == name) {
+      return &vars_[i];
+    }
+  }
+  return nullptr;
+}
+
+const Var* Scope::find(Atom name) const {
+  return const_cast<Scope*>(this)->find(name);
+}
+
+Var& Scope::upsert(Atom name, const Value& value) {
+  if (auto* v = find(name)) {
+    v->value(value);
+    return *v;
+  }
+  if (size_ < vars_.size()) {
+    vars_[size_].reset(name, value);
+  } else {
+    vars_.emplace_back(name, value);
+  }
+  return vars_[size_++];
+}
+
+void Scope::clear() {
+  for (size_t i = 0; i < size_; i++) {
+    // Release the value now rather than when the slot is next used.
+    vars_[i].value(Value());
+  }
+  size_ = 0;
+}
+
+Scope& ScopeStack::push(Atom fn_name) {
+  if (depth_ < scopes_.size()) {
+    scopes_[depth_].fn_name = fn_name;
+  } else {
+    scopes_.emplace_back(fn_name);
+  }
+  return scopes_[depth_++];
+}
+
+void ScopeStack::pop() {
+  scopes_.at(--depth_).clear();
+}
+
+void Module::upsert(Atom name, const Value& value) {
   for (auto it = std::rbegin(scopes); it != std::rend(scopes); it++) {
-    if (contains(it->local_vars, name)) {
-      auto& var = it->local_vars.at(name);
-      var.value(value);
+    if (auto* v = it->find(name)) {
+      v->value(value);
       // updated existing.
       return;
     }
   }
 
-  auto& scope = scopes.back();
-  scope.local_vars.emplace(name, Var(name, value));
+  scopes.back().upsert(name, value);
 }
 
-std::optional<Var> Module::var(const std::string& name) {
+Var* Module::var(Atom name) {
   for (auto it = std::rbegin(scopes); it != std::rend(scopes); it++) {
-    if (contains(it->local_vars, name)) {
-      auto& var = it->local_vars.at(name);
-      fmt::print("Found Var: {}={} at scope: {}\n", name, var.value(), it->fn_name);
+    if (auto* var = it->find(name)) {
+      BASIC_TRACE(TRACE_EXPRESSIONS) << "Found Var: " << name << "=" << var->value()
+                                     << " at scope: " << it->fn_name;
       return var;
     }
   }
   std::cout << "UNKNOWN VARIABLE REFERENCED: " << name << std::endl;
-  return std::nullopt;
+  return nullptr;
 }
 
-bool Module::has_var(const std::string& name) const {
+bool Module::has_var(Atom name) const {
   for (auto it = std::rbegin(scopes); it != std::rend(scopes); it++) {
-    if (contains(it->local_vars, name)) {
+    if (it->find(name)) {
       return true;
     }
   }
   return false;
 }
 
-bool Module::has_fn(const std::string& name) const {
-  return contains(functions, name);
-}
-
-Value Module::call(const std::string& function_name, const std::vector<Value>& params,
-                             ExecutionVisitor* visitor) {
-  if (!contains(functions, function_name)) {
+Value Module::call(Atom function_name, Args params, ExecutionVisitor* visitor) {
+  auto* fn = functions.find(function_name);
+  if (!fn) {
     std::cout << "Unknown function: " << function_name << std::endl;
     return Value(false);
   }
+  return call(*fn, params, visitor);
+}
 
-  auto& fn = functions.at(function_name);
+Value Module::call(BasicFunction& fn, Args params, ExecutionVisitor* visitor) {
+  if (fn.type == BasicFunction::Type::NATIVE) {
+    // Native functions never see BASIC variables, so need no scope.
+    auto result = fn.cpp_fn(params);
+    BASIC_TRACE(TRACE_CALLS) << fn.name << " RETURNED: '" << result << "'";
+    return result;
+  }
 
   // Validate params
   const auto want_count = fn.params.size();
   const auto have_count = params.size();
-  if (fn.type == BasicFunction::Type::BASIC && have_count != want_count) {
+  if (have_count != want_count) {
     // Only bail on wrong args on BASIC functions.
-    std::cout << "Wrong number of parameter to function: " << function_name << std::endl;
+    std::cout << "Wrong number of parameter to function: " << fn.name << std::endl;
     std::cout << "have: " << have_count << std::endl;
     std::cout << "want: " << want_count << std::endl;
     std::cout << std::endl;
     return Value(false);
   }
 
-  // Create a new scope for the function body
-  Scope fnscope(function_name);
+  // Put a scope for the function body on top of the stack, reusing one
+  // from an earlier call when there is one.
+  auto& fnscope = scopes.push(fn.atom);
 
   // Add variables for parameters
-  if (fn.type == BasicFunction::Type::BASIC) {
-    for (int i = 0; i < want_count; i++) {
-      const auto& n = fn.params.at(i);
-      const auto& v = params.at(i);
-      fnscope.local_vars.insert_or_assign(n, Var(n, v));
-    }
+  for (size_t i = 0; i < want_count; i++) {
+    fnscope.upsert(fn.params[i], params[i]);
   }
 
-  // Put the scope on top fo the stack
-  scopes.push_back(fnscope);
+  // Visit the body of the function call
+  Value result(visitor->visit(fn.def_fn->statements()));
 
-  Value result;
-  if (fn.type == BasicFunction::Type::BASIC) {
-    // Visit the body of the function call
-    result = Value(visitor->visit(fn.def_fn->statements()));
-  } else if (fn.type == BasicFunction::Type::NATIVE) {
-    result = fn.cpp_fn(params);
-  }
-
-  fmt::print("{} RETURNED: '{}'\n", fn.name, Value(result));
+  BASIC_TRACE(TRACE_CALLS) << fn.name << " RETURNED: '" << result << "'";
 
   // remove latest scope.
-  scopes.pop_back();
+  scopes.pop();
   return result;
 }
 
 Context::Context() {
   // Start off with only global scope
-  modules.emplace("", Module("") );
-  modules.at("").scopes.emplace_back("<GLOBAL>");
-  root = module = &modules.at("");
+  root = module = &add_module("");
+  root->scopes.push(Atom("<GLOBAL>"));
 
   // Load default modules.
 
@@ -130,12 +172,45 @@ Context::Context() {
   REGISTER_NATIVE(root, stdlib::left);
   REGISTER_NATIVE(root, stdlib::right);
   REGISTER_NATIVEL(root, stdlib::mid);
+
+  // arrays
+  REGISTER_NATIVE(root, stdlib::sort);
+  REGISTER_NATIVE(root, stdlib::fill);
+  REGISTER_NATIVE(root, stdlib::sum);
+  REGISTER_NATIVE(root, stdlib::find);
+
+  // dictionaries
+  REGISTER_NATIVEL(root, stdlib::get);
+  REGISTER_NATIVE(root, stdlib::set);
+  REGISTER_NATIVE(root, stdlib::has);
+  REGISTER_NATIVE(root, stdlib::keys);
 }
 
 Context::Context(const std::filesystem::path& path) : Context() {
   add_source(path);
 }
 
+BasicParser::MainContext* SourceUnit::parse(ParseMode mode) {
+  auto* interpreter = parser_.getInterpreter<antlr4::atn::ParserATNSimulator>();
+  if (mode == ParseMode::SLL_THEN_LL) {
+    // The error listener is not added yet, so a failed SLL parse reports
+    // nothing.
+    interpreter->setPredictionMode(antlr4::atn::PredictionMode::SLL);
+    parser_.setErrorHandler(std::make_shared<antlr4::BailErrorStrategy>());
+    try {
+      return parser_.main();
+    } catch (const antlr4::ParseCancellationException&) {
+      reparsed_ = true;
+      // Discards the partial tree and rewinds the tokens.
+      parser_.reset();
+      parser_.setErrorHandler(std::make_shared<antlr4::DefaultErrorStrategy>());
+    }
+  }
+  interpreter->setPredictionMode(antlr4::atn::PredictionMode::LL);
+  parser_.addErrorListener(&parserError_);
+  return parser_.main();
+}
+
 void BasicParserErrorListener::syntaxError(antlr4::Recognizer* recognizer, antlr4::Token* offendingSymbol, size_t line,
   size_t charPositionInLine, const std::string& msg,
   std::exception_ptr e) {
@@ -143,13 +218,10 @@ void BasicParserErrorListener::syntaxError(antlr4::Recognizer* recognizer, antlr
 }
 
 
-void Context::upsert(const std::string& name, const Value& value) {
-  
-  if (const auto [pkg, id] = split_package_from_id(name); !pkg.empty()) {
-    // fully qualified
-    if (contains(modules, pkg)) {
-      // we have a module.
-      modules.at(pkg).upsert(id, value);
+void Context::upsert(const Name& name, const Value& value) {
+  if (name.qualified()) {
+    if (auto* m = find_module(name.module)) {
+      m->upsert(name.id, value);
       return;
     }
     // TODO(rushfan): Error that we don't have a module loaded for this.
@@ -157,53 +229,76 @@ void Context::upsert(const std::string& name, const Value& value) {
   }
 
   // Not fully qualified case.
-  if (!module->has_var(name) && root->has_var(name)) {
+  if (!module->has_var(name.id) && root->has_var(name.id)) {
     // No existing variable in current module, but one at the root, update it.
-    root->upsert(name, value);
+    root->upsert(name.id, value);
   }
   else {
     // Add it to the current module.
-    module->upsert(name, value);
+    module->upsert(name.id, value);
   }
 }
 
-std::optional<Var> Context::var(const std::string& name) {
-  
-  if (const auto [pkg, id] = split_package_from_id(name); !pkg.empty()) {
-    // fully qualified
-    if (contains(modules, pkg)) {
-      // we have a module.
-      return modules.at(pkg).var(id);
+Var* Context::var(const Name& name) {
+  if (name.qualified()) {
+    if (auto* m = find_module(name.module)) {
+      return m->var(name.id);
     }
-    return std::nullopt;
+    return nullptr;
   }
   // Not fully qualified case.
-  if (!module->has_var(name) && root->has_var(name)) {
+  if (!module->has_var(name.id) && root->has_var(name.id)) {
     // No existing variable in current module, but one at the root, update it.
-    return root->var(name);
+    return root->var(name.id);
   }
-  return module->var(name);
+  return module->var(name.id);
 }
 
-Value Context::call(const std::string& function_name, const std::vector<Value>& params,
-                             ExecutionVisitor* visitor) {
-  
-  if (const auto [pkg, id] = split_package_from_id(function_name); !pkg.empty()) {
-    // fully qualified
-    if (contains(modules, pkg)) {
-      // we have a module.
-      return modules.at(pkg).call(id, params, visitor);
+Value Context::call(const Name& function_name, Args params, ExecutionVisitor* visitor) {
+  if (function_name.qualified()) {
+    if (auto* m = find_module(function_name.module)) {
+      return m->call(function_name.id, params, visitor);
     }
     // TODO(rushfan): Error that we don't have a module loaded for this.
     return Value(false);
   }
   // Not fully qualified case.
-  if (!module->has_fn(function_name) && root->has_fn(function_name)) {
+  if (!module->has_fn(function_name.id) && root->has_fn(function_name.id)) {
     // No existing variable in current module, but one at the root, update it.
-    return root->call(function_name, params, visitor);
+    return root->call(function_name.id, params, visitor);
+  }
+  return module->call(function_name.id, params, visitor);
+}
+
+std::tuple<Module*, BasicFunction*> Context::find_fn(const Name& function_name) {
+  if (function_name.qualified()) {
+    auto* m = find_module(function_name.module);
+    return std::make_tuple(m, m ? m->functions.find(function_name.id) : nullptr);
+  }
+  // Not fully qualified case.
+  if (auto* fn = module->functions.find(function_name.id)) {
+    return std::make_tuple(module, fn);
+  }
+  if (auto* fn = root->functions.find(function_name.id)) {
+    return std::make_tuple(root, fn);
   }
-  return module->call(function_name, params, visitor);
+  return std::make_tuple(module, nullptr);
+}
 
+BasicFunction* Context::resolve(CallSite& site, const Name& function_name) {
+  auto [m, fn] = find_fn(function_name);
+  if (fn) {
+    site.set(module, m, fn, generation);
+  }
+  return fn;
+}
+
+Module& Context::add_module(const std::string& name) {
+  auto [m, inserted] = modules.try_emplace(Atom(name), name, &generation);
+  if (inserted) {
+    generation.invalidate();
+  }
+  return *m;
 }
 
 bool Context::add_source(const std::filesystem::path& path) {
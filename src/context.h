@@ -2,14 +2,17 @@
 
 #include "BasicLexer.h"
 #include "BasicParser.h"
+#include "atom.h"
+#include "call_site.h"
+#include "flat_map.h"
+#include "native.h"
 #include "value.h"
 #include "core/stl.h"
 #include "fmt/format.h"
 
 #include <any>
-#include <deque>
+#include <iterator>
 #include <filesystem>
-#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -20,23 +23,87 @@ namespace wwivbasic {
 
 class Var {
 public:
-  Var(const std::string& n, const Value& v) : name_(n), value_(v) {}
+  Var(Atom n, const Value& v) : name_(n), value_(v) {}
+  Atom name() const { return name_; }
   Value& value() { return value_; }
   Value& value(const Value& v) { value_ = v;  return value_; }
+  // Reuses this variable for another name.
+  void reset(Atom n, const Value& v) {
+    name_ = n;
+    value_ = v;
+  }
 
 private:
-  std::string name_;
+  Atom name_;
   Value value_;
 };
 
+/**
+ * The variables of one function call or FOR loop.
+ *
+ * Scopes hold few variables, so they are kept in a flat array and searched
+ * in order.  Clearing a scope keeps the array, so that a reused scope does
+ * not allocate.
+ */
 class Scope {
 public:
-  Scope(const std::string& name) : fn_name(name) {}
-  std::string fn_name;
-  std::map<std::string, Var, wwiv::stl::ci_less> local_vars;
+  Scope(Atom name) : fn_name(name) {}
+
+  // Finds a variable by name, or null.
+  Var* find(Atom name);
+  const Var* find(Atom name) const;
+  // Sets a variable in this scope, adding it if needed.  Adding a variable
+  // invalidates pointers to the others.
+  Var& upsert(Atom name, const Value& value);
+  // Gets the variable at index, in the order they were added.
+  Var& at(size_t index) { return vars_.at(index); }
+  size_t size() const noexcept { return size_; }
+  // Removes all variables, releasing their values but not their storage.
+  void clear();
+
+  Atom fn_name;
+
+private:
+  std::vector<Var> vars_;
+  size_t size_{0};
 };
 
-typedef std::function<Value(std::vector<Value>)> basic_function_fn;
+/**
+ * Stack of scopes, innermost last, stored contiguously.  Popped scopes are
+ * kept and reused by the next push, so once the stack has reached its
+ * deepest level, calls and loops push and pop scopes without allocating.
+ *
+ * Pushing may move the scopes, so hold depths rather than references to
+ * scopes or variables across anything that can push.
+ */
+class ScopeStack {
+public:
+  typedef std::vector<Scope>::iterator iterator;
+  typedef std::vector<Scope>::const_iterator const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  Scope& push(Atom fn_name);
+  void pop();
+
+  Scope& back() { return scopes_.at(depth_ - 1); }
+  Scope& at(size_t depth) { return scopes_.at(depth); }
+  size_t size() const noexcept { return depth_; }
+  bool empty() const noexcept { return depth_ == 0; }
+
+  iterator begin() { return scopes_.begin(); }
+  iterator end() { return scopes_.begin() + depth_; }
+  const_iterator begin() const { return scopes_.begin(); }
+  const_iterator end() const { return scopes_.begin() + depth_; }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+  const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+private:
+  std::vector<Scope> scopes_;
+  size_t depth_{0};
+};
 
 class BasicFunction {
 public:
@@ -44,129 +111,98 @@ public:
 
   BasicFunction(const std::string& n, BasicParser::ProcedureDefinitionContext* fn,
                 const std::vector<std::string>& p)
-      : name(n), type(Type::BASIC), def_fn(fn), params(p) {}
+      : name(n), atom(n), type(Type::BASIC), def_fn(fn), params(atoms(p)) {}
 
-  BasicFunction(const std::string& n, const basic_function_fn& fn,
+  BasicFunction(const std::string& n, const NativeFunction& fn,
                 const std::vector<std::string>& p)
-      : name(n), type(Type::NATIVE), cpp_fn(fn), params(p) {}
+      : name(n), atom(n), type(Type::NATIVE), cpp_fn(fn), params(atoms(p)) {}
 
   std::string name;
+  // name, interned.
+  Atom atom;
   Type type{Type::BASIC};
   BasicParser::ProcedureDefinitionContext* def_fn{nullptr};
-  basic_function_fn cpp_fn;
-  std::vector<std::string> params;
+  NativeFunction cpp_fn;
+  std::vector<Atom> params;
+
+private:
+  static std::vector<Atom> atoms(const std::vector<std::string>& names) {
+    return std::vector<Atom>(std::begin(names), std::end(names));
+  }
 };
 
 #define REGISTER_NATIVE(module, func)                                                              \
   do {                                                                                             \
-    module->native_functionl(#func, make_basic_fn(func));                                           \
+    module->native_functionl(std::string(native_name(#func)), make_basic_fn(func));                \
   } while (0)
-#define REGISTER_NATIVEL(module, func)                                                              \
+#define REGISTER_NATIVEL(module, func)                                                             \
   do {                                                                                             \
-    module->native_functionl(#func, func);                                           \
+    module->native_functionl(std::string(native_name(#func)), func);                               \
   } while (0)
 
-template<class T>
-struct AsFunction
-  : public AsFunction<decltype(&T::operator())>
-{};
-
-template<class ReturnType, class... Args>
-struct AsFunction<ReturnType(Args...)> {
-  using type = std::function<ReturnType(Args...)>;
-};
-
-template<class ReturnType, class... Args>
-struct AsFunction<ReturnType(*)(Args...)> {
-  using type = std::function<ReturnType(Args...)>;
-};
-
-template<class Class, class ReturnType, class... Args>
-struct AsFunction<ReturnType(Class::*)(Args...) const> {
-  using type = std::function<ReturnType(Args...)>;
-};
-
-// makes various types of functions into a std::function
-template<class F>
-auto as_fn(F f) -> typename AsFunction<F>::type {
-  return { f };
-}
-
-template<typename F, typename R, typename P1>
-basic_function_fn make_basic_fn_(std::function<R(P1)> f) {
-  basic_function_fn f1 = [=](std::vector<Value> params) -> Value {
-    if (params.size() < 1) {
-      return Value(false); // ERROR
-    }
-    return Value(f(params.at(0).get<P1>()));
-  };
-  return f1;
-}
-
-template<typename F, typename R, typename P1, typename P2>
-basic_function_fn make_basic_fn_(std::function<R(P1, P2)> f) {
-  basic_function_fn f1 = [=](std::vector<Value> params) -> Value {
-    if (params.size() < 2) {
-      return Value(false); // ERROR
-    }
-    return Value(f(params.at(0).get<P1>(), params.at(1).get<P2>()));
-  };
-  return f1;
-}
-
-template<class F>
-basic_function_fn make_basic_fn(F f) {
-  return make_basic_fn_<F>(as_fn(std::forward<F>(f)));
-}
-
 
 class ExecutionVisitor;
 
 class Module {
 public:
-  Module(const std::string& name) : name_(name) {}
+  // Adding functions to the module invalidates generation, which is that of
+  // the Context owning the module, when there is one.
+  Module(const std::string& name, FunctionGeneration* generation = nullptr)
+      : name_(name), generation_(generation) {}
 
   // Creates a variable at the top scope or updates existing variable.
-  void upsert(const std::string& name, const Value& value);
-  // Gets the value of a variable.
-  std::optional<Var> var(const std::string& name);
-  // Calls a function
-  Value call(const std::string& function_name, const std::vector<Value>& params,
-    ExecutionVisitor* visitor);
-
-  bool has_var(const std::string& name) const;
-  bool has_fn(const std::string& name) const;
+  void upsert(Atom name, const Value& value);
+  // Gets a variable, or null if there is none.  Adding a variable may
+  // invalidate the pointer.
+  Var* var(Atom name);
+  // Calls a function.  params need only remain valid until they have been
+  // bound to the function's parameters.
+  Value call(Atom function_name, Args params, ExecutionVisitor* visitor);
+  // Calls fn, which must be one of this module's functions.
+  Value call(BasicFunction& fn, Args params, ExecutionVisitor* visitor);
+
+  bool has_var(Atom name) const;
+  bool has_fn(Atom name) const { return functions.contains(name); }
+
+  // Adds or replaces a function.
+  void add_function(const BasicFunction& fn) {
+    functions.insert_or_assign(fn.atom, fn);
+    if (generation_) {
+      generation_->invalidate();
+    }
+  }
 
-  void native_functionl(const std::string& name, const basic_function_fn& fn,
+  void native_functionl(const std::string& name, const NativeFunction& fn,
     const std::vector<std::string>& params) {
-    functions.insert_or_assign(name, BasicFunction(name, fn, params));
+    add_function(BasicFunction(name, fn, params));
   }
 
-  void native_functionl(const std::string& name, const basic_function_fn& fn) {
+  void native_functionl(const std::string& name, const NativeFunction& fn) {
     std::vector<std::string> v;
     native_functionl(name, fn, v);
   }
 
   template<class F>
   void native_function(const std::string& name, F f, const std::vector<std::string>& params) {
-    functions.insert_or_assign(name, BasicFunction(name, make_basic_fn_<F>(as_fn(std::forward<F>(f))), params));
+    add_function(BasicFunction(name, make_basic_fn(std::move(f)), params));
   }
 
   template<class F>
   void native_function(const std::string& name, F f) {
     std::vector<std::string> params;
-    //native_functionl(name, make_basic_fn_<F>(as_fn(std::forward<F>(f))), params);
-    functions.insert_or_assign(name, BasicFunction(name, make_basic_fn_<F>(as_fn(std::forward<F>(f))), params));
+    native_function(name, std::move(f), params);
   }
 
 
-  std::deque<Scope> scopes;
-  std::map<std::string, BasicFunction, wwiv::stl::ci_less> functions;
+  ScopeStack scopes;
+  // Use add_function to change, so that cached calls are invalidated.
+  FlatMap<Atom, BasicFunction> functions;
   // list of modules currently imported using "IMPORT @module"
-  std::set<std::string, wwiv::stl::ci_less> imported_modules;
+  FlatSet<Atom> imported_modules;
 
 private:
   std::string name_;
+  FunctionGeneration* generation_{nullptr};
 };
 
 class SourceUnit;
@@ -180,43 +216,98 @@ public:
   SourceUnit* su_{ nullptr };
 };
 
+// How SourceUnit predicts which alternative of a rule the text matches.
+enum class ParseMode {
+  // SLL prediction first, giving up at the first syntax error, and then LL
+  // prediction only if that failed.  SLL is much cheaper than LL on the
+  // left recursive expr rule, and only fails on text that LL rejects too or
+  // (rarely) on text that needs LL's full context, so the tree and errors
+  // are the same as LL alone gives.
+  SLL_THEN_LL,
+  // LL prediction only.
+  LL,
+};
+
 class SourceUnit {
 public:
-  SourceUnit(const std::string& filename, const std::string& text)
-      : filename_(filename), text_(text), input_(text), lexer_(&input_), tokens_(&lexer_),
+  SourceUnit(const std::string& filename, const std::string& text,
+             ParseMode mode = ParseMode::SLL_THEN_LL)
+      : filename_(filename), input_(text), lexer_(&input_), tokens_(&lexer_),
         parser_(&tokens_), parserError_(this) {
     parser_.removeErrorListeners();
-    parser_.addErrorListener(&parserError_);
-    tree_ = parser_.main();
+    tree_ = parse(mode);
   }
 
   // Gets the parse tree for this source unit.
   antlr4::tree::ParseTree* tree() { return tree_; }
+  BasicParser::MainContext* main() { return tree_; }
   BasicParser* parser() { return &parser_; }
+  // True when SLL prediction failed, so the text was parsed again with LL.
+  bool reparsed() const { return reparsed_; }
 
   std::string filename_;
-  std::string text_;
+  // Holds its own copy of the text, which tokens read their text from.
   antlr4::ANTLRInputStream input_;
   BasicLexer lexer_;
   antlr4::CommonTokenStream tokens_;
   BasicParser parser_;
-  antlr4::tree::ParseTree* tree_{nullptr};
+  BasicParser::MainContext* tree_{nullptr};
   BasicParserErrorListener parserError_;
   std::vector<std::string> errors;
+
+private:
+  BasicParser::MainContext* parse(ParseMode mode);
+
+  bool reparsed_{false};
 };
 
+// Parses a built in corpus that uses all of the grammar, so that the
+// prediction cache (the DFA, which every BasicParser in the process
+// shares) is warm before the first script is parsed.  Long running hosts
+// should call this at startup.  Only the first call does anything.
+void warm_up_parser();
+
+// Default for Context::max_call_depth.
+constexpr size_t kDefaultMaxCallDepth = 1000;
+
 class Context {
 public:
   Context(const std::filesystem::path& path);
   Context();
 
+  // The overloads taking a std::string intern the name on each call, so
+  // callers that look the same name up repeatedly should keep a Name.
+
   // Creates a variable at the top scope or updates existing variable.
-  void upsert(const std::string& name, const Value& value);
-  // Gets the value of a variable.
-  std::optional<Var> var(const std::string& name);
+  void upsert(const Name& name, const Value& value);
+  void upsert(const std::string& name, const Value& value) { upsert(Name(name), value); }
+  // Gets a variable, or null if there is none.  Adding a variable may
+  // invalidate the pointer.
+  Var* var(const Name& name);
+  Var* var(const std::string& name) { return var(Name(name)); }
   // Calls a function
-  Value call(const std::string& function_name, const std::vector<Value>& params,
-    ExecutionVisitor* visitor);
+  Value call(const Name& function_name, Args params, ExecutionVisitor* visitor);
+  Value call(const std::string& function_name, Args params, ExecutionVisitor* visitor) {
+    return call(Name(function_name), params, visitor);
+  }
+  // Finds a function along with the module that owns it.  Either may be
+  // null when nothing matches.
+  std::tuple<Module*, BasicFunction*> find_fn(const Name& function_name);
+  std::tuple<Module*, BasicFunction*> find_fn(const std::string& function_name) {
+    return find_fn(Name(function_name));
+  }
+  // Finds a function as find_fn does, caching the result in site.  Once
+  // cached, site.get(module, generation) returns it until a function or
+  // module is added to this Context.
+  BasicFunction* resolve(CallSite& site, const Name& function_name);
+  BasicFunction* resolve(CallSite& site, const std::string& function_name) {
+    return resolve(site, Name(function_name));
+  }
+
+  // Gets the module called name, creating it if needed.
+  Module& add_module(const std::string& name);
+  // Gets the module called name, or null.
+  Module* find_module(Atom name) { return modules.find(name); }
 
   bool add_source(const std::filesystem::path& path, const std::string& text) {
     auto su = std::make_unique<SourceUnit>(path.string(), text);
@@ -244,12 +335,20 @@ public:
     return su->tree();
   }
 
-  // All registered modules
-  std::map<std::string, Module, wwiv::stl::ci_less> modules;
+  // Changes whenever a function or module of this Context is added.
+  FunctionGeneration generation;
+  // All registered modules.  Use add_module to add one, so that cached calls
+  // are invalidated.  Modules never move once added.
+  FlatMap<Atom, Module> modules;
   std::map<std::filesystem::path, std::unique_ptr<SourceUnit>> sources;
   Module* root{ nullptr };
   Module* module{ nullptr };
   std::vector<std::string> errors;
+  // How deeply calls to BASIC functions may nest before a call fails with
+  // an error.  The VM keeps its frames on the heap, so this is the only
+  // bound there; ExecutionVisitor recurses on the native stack for each
+  // call, so it needs to stay well within what the native stack can hold.
+  size_t max_call_depth{kDefaultMaxCallDepth};
 };
 
 } // namespace wwivbasic
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "gtest/gtest.h"
+#include "context.h"
+
+#include <string>
+
+using namespace wwivbasic;
+
+TEST(ScopeStackTest, FindIsCaseInsensitive) {
+  ScopeStack scopes;
+  scopes.push(Atom("<GLOBAL>")).upsert(Atom("Total"), Value(1));
+  auto& scope = scopes.back();
+  ASSERT_NE(scope.find(Atom("TOTAL")), nullptr);
+  EXPECT_EQ(scope.find(Atom("total"))->value().toInt(), 1);
+  scope.upsert(Atom("tOtAl"), Value(2));
+  EXPECT_EQ(scope.size(), 1u);
+  EXPECT_EQ(scope.find(Atom("Total"))->value().toInt(), 2);
+  EXPECT_EQ(scope.find(Atom("other")), nullptr);
+}
+
+TEST(ScopeStackTest, PopClearsAndPushReuses) {
+  ScopeStack scopes;
+  scopes.push(Atom("<GLOBAL>"));
+  {
+    auto& fn = scopes.push(Atom("fn"));
+    fn.upsert(Atom("a"), Value(1));
+    fn.upsert(Atom("b"), Value("a string that is stored on the heap"));
+  }
+  EXPECT_EQ(scopes.size(), 2u);
+  const auto* first = &scopes.back();
+  scopes.pop();
+  EXPECT_EQ(scopes.size(), 1u);
+
+  auto& again = scopes.push(Atom("other"));
+  EXPECT_EQ(&again, first);
+  EXPECT_EQ(again.fn_name, Atom("other"));
+  EXPECT_EQ(again.size(), 0u);
+  EXPECT_EQ(again.find(Atom("a")), nullptr);
+  EXPECT_EQ(again.upsert(Atom("c"), Value(3)).name(), Atom("c"));
+}
+
+TEST(ScopeStackTest, ModuleVarsInnermostFirst) {
+  Module m("");
+  const Atom x("x");
+  m.scopes.push(Atom("<GLOBAL>"));
+  m.upsert(x, Value(1));
+  m.scopes.push(Atom("fn"));
+  m.scopes.back().upsert(x, Value(2));
+  EXPECT_EQ(m.var(x)->value().toInt(), 2);
+  // Assigning to x updates the innermost x.
+  m.upsert(x, Value(3));
+  m.scopes.pop();
+  EXPECT_EQ(m.var(x)->value().toInt(), 1);
+  EXPECT_FALSE(m.has_var(Atom("y")));
+}
+
+TEST(CallSiteTest, CachesUntilFunctionsChange) {
+  Context ec;
+  CallSite site;
+  EXPECT_EQ(site.get(ec.module, ec.generation), nullptr);
+  auto* fn = ec.resolve(site, "LEN");
+  ASSERT_NE(fn, nullptr);
+  EXPECT_EQ(site.get(ec.module, ec.generation), fn);
+  EXPECT_EQ(site.module(), ec.root);
+
+  // Calls from another module must resolve again.
+  auto& other = ec.add_module("other");
+  EXPECT_EQ(site.get(&other, ec.generation), nullptr);
+
+  EXPECT_EQ(ec.resolve(site, "LEN"), fn);
+  ec.root->native_function("LEN", [](int) { return 0; });
+  EXPECT_EQ(site.get(ec.module, ec.generation), nullptr);
+}
+
+TEST(CallSiteTest, OtherContextsLeaveSitesAlone) {
+  Context ec;
+  CallSite site;
+  auto* fn = ec.resolve(site, "LEN");
+  ASSERT_NE(fn, nullptr);
+
+  // Building a second Context registers all of its native functions.
+  Context other;
+  other.add_module("other").native_function("twice", [](int x) { return x * 2; });
+  other.root->native_function("LEN", [](int) { return 0; });
+  EXPECT_EQ(site.get(ec.module, ec.generation), fn);
+}
+
+TEST(CallSiteTest, UnknownFunctionIsNotCached) {
+  Context ec;
+  CallSite site;
+  EXPECT_EQ(ec.resolve(site, "NOSUCHFN"), nullptr);
+  EXPECT_EQ(site.get(ec.module, ec.generation), nullptr);
+  EXPECT_EQ(ec.resolve(site, "nosuchmodule.fn"), nullptr);
+}
+
+TEST(ContextTest, QualifiedNamesUseTheirModule) {
+  Context ec;
+  auto& io = ec.add_module("wwiv.io");
+  io.scopes.push(Atom("<GLOBAL>"));
+  ec.upsert("WWIV.IO.width", Value(80));
+  EXPECT_EQ(io.var(Atom("WIDTH"))->value().toInt(), 80);
+  EXPECT_EQ(ec.var(Name("wwiv.io.Width"))->value().toInt(), 80);
+  EXPECT_EQ(ec.var("nosuchmodule.width"), nullptr);
+
+  io.native_function("twice", [](int x) { return x * 2; });
+  auto [m, fn] = ec.find_fn("Wwiv.Io.TWICE");
+  EXPECT_EQ(m, &io);
+  ASSERT_NE(fn, nullptr);
+  EXPECT_EQ(fn->name, "twice");
+}
+
+TEST(SourceUnitTest, TwoStageParseMatchesLL) {
+  const std::string text = R"(total = 0
+FOR i = 1 to 10
+  total = total + i * 2 - (i MOD 3)
+  IF total > 20 AND i < 8 OR i = 9 THEN
+    BREAK
+  ENDIF
+NEXT
+def add(a, b)
+  return a + b
+enddef
+print(add(total, LEN("abc")))
+)";
+  SourceUnit two_stage("test.bas", text);
+  SourceUnit ll("test.bas", text, ParseMode::LL);
+  EXPECT_FALSE(two_stage.reparsed());
+  EXPECT_TRUE(two_stage.errors.empty());
+  EXPECT_EQ(two_stage.tree()->toStringTree(two_stage.parser()),
+            ll.tree()->toStringTree(ll.parser()));
+}
+
+TEST(SourceUnitTest, SyntaxErrorFallsBackToLL) {
+  const std::string text = "x = (1 +\nprint(x)\n";
+  SourceUnit two_stage("test.bas", text);
+  SourceUnit ll("test.bas", text, ParseMode::LL);
+  // The failed SLL parse reports nothing, so the errors are LL's alone.
+  EXPECT_TRUE(two_stage.reparsed());
+  EXPECT_FALSE(two_stage.errors.empty());
+  EXPECT_EQ(two_stage.errors, ll.errors);
+}
@@ -0,0 +1,38 @@
+#include "dict.h"
+#include "array.h"
+
+namespace wwivbasic {
+
+// key as a string.  Integer and boolean keys are short enough to be stored
+// inline, so converting them does not allocate.
+static Value text_key(const Value& key) {
+  if (key.is_string()) {
+    return key;
+  }
+  char buf[16];
+  return Value(key.text(buf));
+}
+
+void Dict::unref() noexcept {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
+const Value* Dict::find(const Value& key) const {
+  return key.is_string() ? entries_.find(key) : entries_.find(text_key(key));
+}
+
+void Dict::set(const Value& key, const Value& v) { entries_.insert_or_assign(text_key(key), v); }
+
+Value Dict::keys() const {
+  auto result = Value::dim(Value::Type::STRING, static_cast<int>(entries_.size()));
+  auto* a = result.mutable_array();
+  size_t i = 0;
+  for (const auto& [k, v] : entries_) {
+    a->set(i++, k);
+  }
+  return result;
+}
+
+} // namespace wwivbasic
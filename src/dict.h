@@ -0,0 +1,62 @@
+#pragma once
+
+#include "flat_map.h"
+#include "value.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace wwivbasic {
+
+/**
+ * The entries of a dictionary.
+ *
+ * Keys are compared as text, so d[1] and d["1"] are the same entry, and are
+ * stored as string Values, which keeps keys of up to 14 bytes inline.  The
+ * entries are held in a FlatMap, so lookups probe a small table of entry
+ * indexes and iterating (as KEYS does) follows insertion order.  Each entry
+ * takes 32 bytes plus its share of the table, which is at most 4/3 of a
+ * 4 byte slot.
+ *
+ * Dictionaries are shared between Values by reference count, and a Value
+ * copies a shared dictionary before changing it, as it does arrays.
+ */
+class Dict {
+public:
+  Dict() = default;
+  Dict(const Dict& that) : entries_(that.entries_) {}
+  Dict& operator=(const Dict&) = delete;
+
+  size_t size() const noexcept { return entries_.size(); }
+  // The value for key, or null when there is none.
+  const Value* find(const Value& key) const;
+  // Sets the value for key, adding key after the others when it is new.
+  void set(const Value& key, const Value& v);
+  // The keys, in the order they were added, as a STRING array.
+  Value keys() const;
+
+  void ref() noexcept { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void unref() noexcept;
+  // True when the caller holds the only reference, so may modify this
+  // dictionary.
+  bool unique() const noexcept { return refs_.load(std::memory_order_acquire) == 1; }
+
+private:
+  struct KeyHash {
+    size_t operator()(const Value& key) const noexcept {
+      return std::hash<std::string_view>()(key.view());
+    }
+  };
+  struct KeyEq {
+    bool operator()(const Value& a, const Value& b) const noexcept { return a.view() == b.view(); }
+  };
+
+  std::atomic<int32_t> refs_{1};
+  // Keys are always strings.
+  FlatMap<Value, Value, KeyHash, KeyEq> entries_;
+};
+
+} // namespace wwivbasic
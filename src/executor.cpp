@@ -1,15 +1,97 @@
 #include "executor.h"
+#include "array.h"
+#include "dict.h"
 #include "utils.h"
 #include "BasicLexer.h"
 #include "core/stl.h"
 #include "core/strings.h"
 #include "fmt/format.h"
+#include "trace.h"
+
+#include <stdexcept>
 
 namespace wwivbasic {
 
 using namespace wwiv::stl;
 using namespace wwiv::strings;
 
+namespace {
+
+// Gets the name interned in a node's name local, interning the text of
+// node the first time.  Later visits of the node compare atoms only.
+const Name& cached_name(Name& name, antlr4::tree::ParseTree* node) {
+  if (name.empty()) {
+    name = Name(node->getText());
+  }
+  return name;
+}
+
+ast::BinaryOp to_binary_op(size_t token_type) {
+  switch (token_type) {
+  case BasicLexer::PLUS: return ast::BinaryOp::ADD;
+  case BasicLexer::MINUS: return ast::BinaryOp::SUB;
+  case BasicLexer::STAR: return ast::BinaryOp::MUL;
+  case BasicLexer::SLASH: return ast::BinaryOp::DIV;
+  case BasicLexer::MOD: return ast::BinaryOp::MOD;
+  case BasicLexer::EQ: return ast::BinaryOp::EQ;
+  case BasicLexer::NE: return ast::BinaryOp::NE;
+  case BasicLexer::LT: return ast::BinaryOp::LT;
+  case BasicLexer::LE: return ast::BinaryOp::LE;
+  case BasicLexer::GT: return ast::BinaryOp::GT;
+  case BasicLexer::GE: return ast::BinaryOp::GE;
+  }
+  throw std::invalid_argument(fmt::format("Unknown binary operator token: {}", token_type));
+}
+
+// expr as a + operator, or null if it is anything else.
+BasicParser::AddSubContext* plus(BasicParser::ExprContext* expr) {
+  auto* add = dynamic_cast<BasicParser::AddSubContext*>(expr);
+  if (add && add->additiveoperator()->getStart()->getType() == BasicLexer::PLUS) {
+    return add;
+  }
+  return nullptr;
+}
+
+// The variable that is the first operand of a chain of + operators, such as
+// s in s + a + b, or null if expr is not such a chain.
+BasicParser::RvalueContext* first_addend(BasicParser::ExprContext* expr) {
+  if (!plus(expr)) {
+    return nullptr;
+  }
+  while (auto* add = plus(expr)) {
+    expr = add->expr(0);
+  }
+  auto* ident = dynamic_cast<BasicParser::IdentContext*>(expr);
+  return ident ? ident->rvalue() : nullptr;
+}
+
+// True if tree calls a function, which may change any variable.
+bool contains_call(antlr4::tree::ParseTree* tree) {
+  if (dynamic_cast<BasicParser::ProcCallContext*>(tree)) {
+    return true;
+  }
+  for (auto* child : tree->children) {
+    if (contains_call(child)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// True if any but the first operand of a chain of + operators calls a
+// function.
+bool addend_calls(BasicParser::ExprContext* expr) {
+  while (auto* add = plus(expr)) {
+    if (contains_call(add->expr(1))) {
+      return true;
+    }
+    expr = add->expr(0);
+  }
+  return false;
+}
+
+} // namespace
+
 std::any ExecutionVisitor::visitMain(BasicParser::MainContext* context) {
   // When starting, reset the module to the root.
   ec_.module = ec_.root;
@@ -21,14 +103,41 @@ std::any ExecutionVisitor::visitProcedureCall(BasicParser::ProcedureCallContext*
   if (!ctx->procedureName()) {
     return {};
   }
-  const auto fn_name = ctx->procedureName()->getText();
-  std::cout << "Procedure Call: " << fn_name << std::endl;
-  std::vector<Value> params;
-  if (ctx->parameterList()) {
-    const auto ctxparams = visit(ctx->parameterList());
-    params = std::any_cast<std::vector<Value>>(ctxparams);
+  // Only look the function up by name when the cached one is stale.
+  auto* fn = ctx->site.get(ec_.module, ec_.generation);
+  if (!fn) {
+    const auto& fn_name = cached_name(ctx->name, ctx->procedureName());
+    fn = ec_.resolve(ctx->site, fn_name);
+    if (!fn) {
+      std::cout << "Unknown function: " << fn_name << std::endl;
+      return Value(false).toAny();
+    }
+  }
+  // Evaluating the arguments may call through this site again.
+  auto* owner = ctx->site.module();
+  BASIC_TRACE(TRACE_CALLS) << "Procedure Call: " << fn->name;
+  // Arguments are evaluated onto the end of args_, so nested calls stack
+  // theirs above these, and the space is reused by the next call.
+  const auto base = args_.size();
+  if (auto* list = ctx->parameterList()) {
+    for (auto* expr : list->expr()) {
+      args_.emplace_back(visit(expr));
+    }
   }
-  auto val = ec_.call(fn_name, params, this);
+  if (fn->type == BasicFunction::Type::BASIC && depth_ >= ec_.max_call_depth) {
+    std::cout << "CALL DEPTH LIMIT REACHED: " << fn->name << " (LIMIT " << ec_.max_call_depth
+              << ")" << std::endl;
+    args_.resize(base);
+    return Value(false).toAny();
+  }
+  // A BREAK in the function can not leave the caller's loops.
+  const auto loops = loops_;
+  loops_ = 0;
+  depth_++;
+  auto val = owner->call(*fn, Args(args_.data() + base, args_.size() - base), this);
+  depth_--;
+  args_.resize(base);
+  loops_ = loops;
   return_ = false;
   return val.toAny();
 }
@@ -52,12 +161,12 @@ std::any ExecutionVisitor::visitImportModule(BasicParser::ImportModuleContext* c
   if (context->ID()) {
     // import package
     auto modulename = context->ID()->getText();
-    fmt::print("Import module: '{}'\n", modulename);
-    ec_.module->imported_modules.emplace(modulename);
+    BASIC_TRACE(TRACE_CALLS) << "Import module: '" << modulename << "'";
+    ec_.module->imported_modules.insert(Atom(modulename));
   }
   else if (context->STRING()) {
     auto fn = remove_quotes(context->STRING()->getText());
-    fmt::print("Import file: '{}'\n", fn);
+    BASIC_TRACE(TRACE_CALLS) << "Import file: '" << fn << "'";
   }
   else {
     fmt::print("Malformed import statement: '{}'\n", context->getText());
@@ -71,7 +180,7 @@ std::any ExecutionVisitor::visitStatements(BasicParser::StatementsContext* conte
   std::any result;
   for (auto* stmt : context->statement()) {
     result = visitStatement(stmt);
-    if (return_) {
+    if (return_ || break_) {
       return result;
     }
   }
@@ -103,17 +212,36 @@ ExecutionVisitor::visitAssignmentStatement(BasicParser::AssignmentStatementConte
   // TODO(rushfan): make this return the lvalue if we want to support chaining
   // of assignments like:
   // a = b = 10
-  const auto lvalue_name = context->lvalue()->getText();
-  if (context->expr()) {
+  auto* variable = context->lvalue()->variable();
+  const auto& lvalue_name = cached_name(variable->name, variable);
+  if (auto* index = context->lvalue()->expr()) {
+    // Stores into the array or dictionary in place, so that it is only
+    // copied when another variable shares it.
+    const auto i = Value(visit(index));
+    const auto value = context->expr() ? Value(visit(context->expr()))
+                                       : Value(visitRvalue(context->rvalue()));
+    if (auto* var = ec_.var(lvalue_name)) {
+      BASIC_TRACE(TRACE_ASSIGNMENTS) << "ASSIGN: " << lvalue_name << "[" << i << "] = " << value;
+      var->value().set_element(i, value);
+    }
+  }
+  else if (auto* first = first_addend(context->expr());
+      first && cached_name(first->name, first) == lvalue_name && !addend_calls(context->expr())) {
+    append(context->expr(), lvalue_name);
+  }
+  else if (context->expr()) {
     const auto value = Value(visit(context->expr()));
-    std::cout << "ASSIGN: " << lvalue_name << " = " << value << std::endl;
+    BASIC_TRACE(TRACE_ASSIGNMENTS) << "ASSIGN: " << lvalue_name << " = " << value;
     ec_.upsert(lvalue_name, value);
   }
   else if (context->rvalue()) {
-    const auto rvalueName = context->rvalue()->getText();
-    if (auto rvalue = ec_.var(rvalueName)) {
-      std::cout << "ASSIGN LVALUE=RVALUE: " << lvalue_name << " = " << rvalue.value().value() << std::endl;
-      ec_.upsert(lvalue_name, rvalue.value().value());
+    auto* rvalue_ctx = context->rvalue();
+    if (auto* rvalue = ec_.var(cached_name(rvalue_ctx->name, rvalue_ctx))) {
+      BASIC_TRACE(TRACE_ASSIGNMENTS) << "ASSIGN LVALUE=RVALUE: " << lvalue_name << " = "
+                                     << rvalue->value();
+      // Copy first, since upsert may add a variable and move this one.
+      const auto value = rvalue->value();
+      ec_.upsert(lvalue_name, value);
     }
   }
   else {
@@ -122,95 +250,152 @@ ExecutionVisitor::visitAssignmentStatement(BasicParser::AssignmentStatementConte
   return {};
 }
  
+// name = name + a + b ...
+//
+// Appends a, b, ... to the variable in place, rather than copying its value
+// to evaluate name + a, which makes building a long string with repeated
+// appends linear rather than quadratic.  Only used when none of a, b, ...
+// calls a function.
+void ExecutionVisitor::append(BasicParser::ExprContext* expr, const Name& name) {
+  const auto base = args_.size();
+  push_addends(expr);
+  // Evaluating the operands may add variables, so only look it up now.
+  if (auto* var = ec_.var(name)) {
+    for (auto i = base; i < args_.size(); i++) {
+      var->value().append(args_[i]);
+    }
+    BASIC_TRACE(TRACE_ASSIGNMENTS) << "APPEND: " << name << " = " << var->value();
+  }
+  else {
+    // Like any unknown variable, name reads as an empty string.
+    Value value;
+    for (auto i = base; i < args_.size(); i++) {
+      value.append(args_[i]);
+    }
+    ec_.upsert(name, value);
+  }
+  args_.resize(base);
+}
+
+// Evaluates all but the first operand of a chain of + operators onto args_.
+void ExecutionVisitor::push_addends(BasicParser::ExprContext* expr) {
+  if (auto* add = plus(expr)) {
+    push_addends(add->expr(0));
+    args_.emplace_back(visit(add->expr(1)));
+  }
+}
+
+// The minus applies to the first operand of expr, as a unary minus binding
+// more tightly than any operator would, so -a + b is (0 - a) + b, as the
+// compiler builds it.
+Value ExecutionVisitor::negated(BasicParser::ExprContext* expr) {
+  antlr4::Token* op = nullptr;
+  BasicParser::ExprContext* left = nullptr;
+  BasicParser::ExprContext* right = nullptr;
+  if (auto* c = dynamic_cast<BasicParser::AddSubContext*>(expr)) {
+    op = c->additiveoperator()->getStart();
+    left = c->expr(0);
+    right = c->expr(1);
+  } else if (auto* c = dynamic_cast<BasicParser::MulDivContext*>(expr)) {
+    op = c->multiplicativeoperator()->getStart();
+    left = c->expr(0);
+    right = c->expr(1);
+  } else if (auto* c = dynamic_cast<BasicParser::RelationContext*>(expr)) {
+    op = c->relationaloperator()->getStart();
+    left = c->expr(0);
+    right = c->expr(1);
+  } else if (auto* c = dynamic_cast<BasicParser::LogicalAndContext*>(expr)) {
+    return Value(negated(c->expr(0)).toBool() && Value(visit(c->expr(1))).toBool());
+  } else if (auto* c = dynamic_cast<BasicParser::LogicalOrContext*>(expr)) {
+    return Value(negated(c->expr(0)).toBool() || Value(visit(c->expr(1))).toBool());
+  } else {
+    return Value(0) - Value(visit(expr));
+  }
+  const auto l = negated(left);
+  const Value r(visit(right));
+  return expr->feedback.apply(to_binary_op(op->getType()), l, r);
+}
+
 std::any ExecutionVisitor::visitRelation(BasicParser::RelationContext* context) {
 
   const auto op = context->relationaloperator()->getStart();
-  Value left(visit(context->expr(0)));
-  Value right(visit(context->expr(1)));
-  bool result{false};
+  ast::BinaryOp binop;
   switch (op->getType()) {
-  case BasicLexer::GT: {
-    result = left > right;
-  } break;
-  case BasicLexer::GE: {
-    result = left == right || left > right;
-  } break;
-  case BasicLexer::LT: {
-    result = left < right;
-  } break;
-  case BasicLexer::LE: {
-    result = left == right || left < right;
-  } break;
-  case BasicLexer::NE: {
-    result = left != right;
-  } break;
-  case BasicLexer::EQ: {
-    result = left == right;
-  } break;
+  case BasicLexer::GT: binop = ast::BinaryOp::GT; break;
+  case BasicLexer::GE: binop = ast::BinaryOp::GE; break;
+  case BasicLexer::LT: binop = ast::BinaryOp::LT; break;
+  case BasicLexer::LE: binop = ast::BinaryOp::LE; break;
+  case BasicLexer::NE: binop = ast::BinaryOp::NE; break;
+  case BasicLexer::EQ: binop = ast::BinaryOp::EQ; break;
   default:
     std::cerr << "WTF: " << context->getText();
     return {};
   }
-  std::cout << left << op->getText() << right << " = " << std::boolalpha
-            << result << std::endl;
+  Value left(visit(context->expr(0)));
+  Value right(visit(context->expr(1)));
+  const auto result = context->feedback.apply(binop, left, right).bool_value();
+  BASIC_TRACE(TRACE_EXPRESSIONS) << left << op->getText() << right << " = " << std::boolalpha
+                                 << result;
   return result;
 }
 
 std::any ExecutionVisitor::visitIdent(BasicParser::IdentContext* context) {
-  LOG(INFO) << fmt::format("visitIdent: '{}'", context->getText());
+  BASIC_TRACE(TRACE_EXPRESSIONS) << "visitIdent: '" << context->getText() << "'";
   return visitRvalue(context->rvalue());
 }
 
 
 std::any ExecutionVisitor::visitMulDiv(BasicParser::MulDivContext* context) {
   const auto op = context->multiplicativeoperator()->getStart();
-  Value left(visit(context->expr(0)));
-  Value right(visit(context->expr(1)));
-  Value result;
+  ast::BinaryOp binop;
   switch (op->getType()) {
-  case BasicLexer::STAR: {
-    result = left * right;
-  } break;
-  case BasicLexer::SLASH: {
-    result = left / right;
-  } break;
-  case BasicLexer::MOD: {
-    result = left % right;
-  } break;
-  case BasicLexer::AND: {
-    result = left && right;
-  } break;
+  case BasicLexer::STAR: binop = ast::BinaryOp::MUL; break;
+  case BasicLexer::SLASH: binop = ast::BinaryOp::DIV; break;
+  case BasicLexer::MOD: binop = ast::BinaryOp::MOD; break;
   default:
     std::cerr << "WTF: " << context->getText();
     return {};
   }
-  std::cout << left << op << right << " = " << result << std::endl;
+  Value left(visit(context->expr(0)));
+  Value right(visit(context->expr(1)));
+  const auto result = context->feedback.apply(binop, left, right);
+  BASIC_TRACE(TRACE_EXPRESSIONS) << left << op->getText() << right << " = " << result;
   return result.toAny();
 }
 
 std::any ExecutionVisitor::visitAddSub(BasicParser::AddSubContext* context) {
   const auto op = context->additiveoperator()->getStart();
-  Value left(visit(context->expr(0)));
-  Value right(visit(context->expr(1)));
-  Value result;
+  ast::BinaryOp binop;
   switch (op->getType()) {
-  case BasicLexer::PLUS: {
-    result = left + right;
-  } break;
-  case BasicLexer::MINUS: {
-    result = left - right;
-  } break;
-  case BasicLexer::OR: {
-    result = left || right;
-  } break;
+  case BasicLexer::PLUS: binop = ast::BinaryOp::ADD; break;
+  case BasicLexer::MINUS: binop = ast::BinaryOp::SUB; break;
   default:
     std::cerr << "WTF: " << context->getText();
     return {};
   }
-  std::cout << left << op << right << " = " << result << std::endl;
+  Value left(visit(context->expr(0)));
+  Value right(visit(context->expr(1)));
+  const auto result = context->feedback.apply(binop, left, right);
+  BASIC_TRACE(TRACE_EXPRESSIONS) << left << op->getText() << right << " = " << result;
   return result.toAny();
 }
 
+// AND and OR only evaluate their right operand when the left one does not
+// already decide the result.  Both operands are read with Value::toBool.
+std::any ExecutionVisitor::visitLogicalAnd(BasicParser::LogicalAndContext* context) {
+  const auto result = Value(visit(context->expr(0))).toBool() &&
+                      Value(visit(context->expr(1))).toBool();
+  BASIC_TRACE(TRACE_EXPRESSIONS) << context->getText() << " = " << std::boolalpha << result;
+  return result;
+}
+
+std::any ExecutionVisitor::visitLogicalOr(BasicParser::LogicalOrContext* context) {
+  const auto result = Value(visit(context->expr(0))).toBool() ||
+                      Value(visit(context->expr(1))).toBool();
+  BASIC_TRACE(TRACE_EXPRESSIONS) << context->getText() << " = " << std::boolalpha << result;
+  return result;
+}
+
 std::any ExecutionVisitor::visitIfThenStatement(BasicParser::IfThenStatementContext* context) {
   if (const auto result = std::any_cast<bool>(visit(context->expr())); !result) {
     return {};
@@ -241,47 +426,103 @@ std::any ExecutionVisitor::visitIfThenElseIfElseStatement(
   return {};
 }
 
+// The bounds and step are evaluated once, as integers, and the counter is
+// kept in an int.  It is copied into the loop variable for the body, and
+// read back after it, since the body may assign to the loop variable.
 std::any ExecutionVisitor::visitForStatement(BasicParser::ForStatementContext* ctx) {
-  auto steptoken = ctx->STEP();
-  const int step = steptoken ? to_number<int>(ctx->INT()->getText()) : 1;
-  const auto start = Value(visit(ctx->expr(0)));
-  const auto end = Value(visit(ctx->expr(1)));
-
-  const auto varname = ctx->ID()->getText();
-  const auto scope_name = fmt::format("FOR {}", varname);
-
-  {
-    Scope fnscope(scope_name);
-    fnscope.local_vars.insert_or_assign(varname, Var(varname, start));
-    // Put the scope on top fo the stack
-    ec_.module->scopes.push_back(fnscope);
-  }
-  auto& var = ec_.module->scopes.back().local_vars.at(varname);
-  // TODO(rushfan): May need to change to a while loop.
-  // TODO(rushfan): Need to figure out how to add RETURN and BREAK support here.
-  for (int current = start.toInt(); current != end.toInt(); current += step) {
-    var.value().set(current);
-    visit(ctx->statements());
-    current = var.value().toInt();
-  }
-  // Handle last loop where current == end;
-  var.value().set(end.toInt());
-  visit(ctx->statements());
+  const auto start = Value(visit(ctx->expr(0))).toInt();
+  const auto end = Value(visit(ctx->expr(1))).toInt();
+  int step = 1;
+  if (ctx->STEP()) {
+    step = (ctx->MINUS() ? negated(ctx->expr(2)) : Value(visit(ctx->expr(2)))).toInt();
+  }
+  if (step == 0) {
+    std::cout << "FOR STEP must not be 0" << std::endl;
+    return {};
+  }
+  if (ctx->var.empty()) {
+    ctx->var = Atom(ctx->ID()->getText());
+  }
+
+  // Put the scope on top fo the stack, with the loop variable first in it.
+  // The scope is named after the loop variable.
+  auto& scopes = ec_.module->scopes;
+  const auto depth = scopes.size();
+  scopes.push(ctx->var).upsert(ctx->var, Value(start));
+  // The body may push scopes, moving this one, so find the variable by
+  // position each time rather than holding a reference to it.
+  auto var = [&]() -> Value& { return scopes.at(depth).at(0).value(); };
+  std::any result;
+  loops_++;
+  // 64 bits, so that stepping past the largest or smallest int ends the
+  // loop rather than overflowing.
+  for (int64_t current = start; step > 0 ? current <= end : current >= end; current += step) {
+    var().set(static_cast<int>(current));
+    result = visit(ctx->statements());
+    if (return_ || break_) {
+      break;
+    }
+    const auto& v = var();
+    current = v.is_int() ? v.int_value() : v.toInt();
+  }
+  loops_--;
+  break_ = false;
 
   // remove latest scope.
-  ec_.module->scopes.pop_back();
-  return {};
+  scopes.pop();
+  // Pass the value of a RETURN in the body on to the enclosing function.
+  return return_ ? result : std::any();
 }
 
 std::any ExecutionVisitor::visitReturnStatement(BasicParser::ReturnStatementContext* context) {
   auto result = visit(context->expr());
-  std::cout << "RETURN: " << Value(result) << std::endl;
+  BASIC_TRACE(TRACE_CALLS) << "RETURN: " << Value(result);
   return_ = true;
   return result;
 }
 
+std::any ExecutionVisitor::visitBreakStatement(BasicParser::BreakStatementContext* context) {
+  // Outside of a loop BREAK does nothing.
+  break_ = loops_ > 0;
+  return {};
+}
+
+std::any ExecutionVisitor::visitDimStatement(BasicParser::DimStatementContext* context) {
+  auto type = Value::Type::INTEGER;
+  if (auto* id = context->ID()) {
+    const auto t = element_type(id->getText());
+    if (!t) {
+      std::cout << "Unknown DIM type: " << id->getText() << std::endl;
+      return {};
+    }
+    type = *t;
+  }
+  const auto size = Value(visit(context->expr())).toInt();
+  ec_.upsert(cached_name(context->variable()->name, context->variable()), Value::dim(type, size));
+  return {};
+}
+
+std::any ExecutionVisitor::visitIndex(BasicParser::IndexContext* context) {
+  const auto i = Value(visit(context->expr()));
+  // Reads the element in place rather than copying the array.
+  auto* rvalue = context->rvalue();
+  if (auto* v = ec_.var(cached_name(rvalue->name, rvalue))) {
+    return v->value().element(i).toAny();
+  }
+  return {};
+}
+
+std::any ExecutionVisitor::visitDictionary(BasicParser::DictionaryContext* context) {
+  auto d = Value::make_dict();
+  auto* dict = d.mutable_dict();
+  for (auto* entry : context->dictionaryEntry()) {
+    dict->set(Value(visit(entry->expr(0))), Value(visit(entry->expr(1))));
+  }
+  return d.toAny();
+}
+
 std::any ExecutionVisitor::visitVariable(BasicParser::VariableContext* context) {
-  if (auto v = ec_.var(context->getText())) {
+  if (auto* v = ec_.var(cached_name(context->name, context))) {
     return v->value().toAny();
   }
   return {};
@@ -290,7 +531,7 @@ std::any ExecutionVisitor::visitVariable(BasicParser::VariableContext* context)
 // RValue variable, unless we support RValue references, always treat it as
 // a value
 std::any ExecutionVisitor::visitRvalue(BasicParser::RvalueContext* context) {
-  if (auto v = ec_.var(context->getText())) {
+  if (auto* v = ec_.var(cached_name(context->name, context))) {
     return v->value().toAny();
   }
   return {};
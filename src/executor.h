@@ -35,12 +35,20 @@ public:
 
   std::any visitIdent(BasicParser::IdentContext* context) override;
 
+  std::any visitIndex(BasicParser::IndexContext* context) override;
+
+  std::any visitDictionary(BasicParser::DictionaryContext* context) override;
+
   //std::any visitProcCall(BasicParser::ProcCallContext* context) override;
 
   std::any visitMulDiv(BasicParser::MulDivContext* context) override;
 
   std::any visitAddSub(BasicParser::AddSubContext* context) override;
 
+  std::any visitLogicalAnd(BasicParser::LogicalAndContext* context) override;
+
+  std::any visitLogicalOr(BasicParser::LogicalOrContext* context) override;
+
   std::any visitParens(BasicParser::ParensContext* context) override;
 
   std::any visitString(BasicParser::StringContext* context) override;
@@ -75,6 +83,10 @@ public:
 
   std::any visitReturnStatement(BasicParser::ReturnStatementContext* context) override;
 
+  std::any visitBreakStatement(BasicParser::BreakStatementContext* context) override;
+
+  std::any visitDimStatement(BasicParser::DimStatementContext* context) override;
+
   // std::any visitId(BasicParser::IdContext* context) override;
 
   std::any visitVariable(BasicParser::VariableContext* context) override;
@@ -88,9 +100,21 @@ public:
   // override;
 
 private:
+  void append(BasicParser::ExprContext* expr, const Name& name);
+  void push_addends(BasicParser::ExprContext* expr);
+  // Evaluates expr with a minus before it, as in STEP -expr.
+  Value negated(BasicParser::ExprContext* expr);
+
   Context& ec_;
   bool return_{ false };
+  // Set by BREAK until the innermost FOR loop ends.
   bool break_{ false };
+  // Number of FOR loops running in the current function call.
+  int loops_{ 0 };
+  // Number of calls to BASIC functions in progress.
+  size_t depth_{ 0 };
+  // Arguments of the calls in progress, innermost last.
+  std::vector<Value> args_;
 };
 
 } // namespace wwivbasic
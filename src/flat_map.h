@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace wwivbasic {
+
+/**
+ * Hash map using open addressing with linear probing.
+ *
+ * Entries are kept in insertion order in a deque, so iteration follows
+ * insertion order and references to entries stay valid as the map grows.
+ * The table itself only holds indexes into the entries, which keeps it
+ * small enough that probing rarely leaves a cache line.  Entries can not
+ * be removed.
+ */
+template <class K, class V, class Hash = std::hash<K>, class Eq = std::equal_to<K>>
+class FlatMap {
+public:
+  typedef std::pair<const K, V> value_type;
+  typedef typename std::deque<value_type>::iterator iterator;
+  typedef typename std::deque<value_type>::const_iterator const_iterator;
+
+  FlatMap() = default;
+  FlatMap(const FlatMap& o) : entries_(o.entries_), table_(o.table_), shift_(o.shift_) {}
+  FlatMap(FlatMap&&) noexcept = default;
+  // Entries have const keys, so can not be assigned one by one.
+  FlatMap& operator=(const FlatMap& o) {
+    if (this != &o) {
+      *this = FlatMap(o);
+    }
+    return *this;
+  }
+  FlatMap& operator=(FlatMap&&) noexcept = default;
+
+  V* find(const K& key) {
+    if (table_.empty()) {
+      return nullptr;
+    }
+    for (auto i = bucket(key);; i = (i + 1) & mask()) {
+      const auto e = table_[i];
+      if (e == 0) {
+        return nullptr;
+      }
+      if (Eq()(entries_[e - 1].first, key)) {
+        return &entries_[e - 1].second;
+      }
+    }
+  }
+  const V* find(const K& key) const { return const_cast<FlatMap*>(this)->find(key); }
+  bool contains(const K& key) const { return find(key) != nullptr; }
+
+  // Inserts key with a value constructed from args unless key is present.
+  // Returns the value for key and whether it was inserted.
+  template <class... Args> std::pair<V*, bool> try_emplace(const K& key, Args&&... args) {
+    if (auto* v = find(key)) {
+      return {v, false};
+    }
+    if ((entries_.size() + 1) * 4 > table_.size() * 3) {
+      grow();
+    }
+    entries_.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    place(static_cast<uint32_t>(entries_.size()));
+    return {&entries_.back().second, true};
+  }
+
+  V& insert_or_assign(const K& key, V value) {
+    auto [v, inserted] = try_emplace(key, std::move(value));
+    if (!inserted) {
+      *v = std::move(value);
+    }
+    return *v;
+  }
+
+  size_t size() const noexcept { return entries_.size(); }
+  bool empty() const noexcept { return entries_.empty(); }
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+private:
+  size_t mask() const noexcept { return table_.size() - 1; }
+  // Fibonacci hashing spreads small and sequential hashes (such as atom
+  // ids) over the whole table.
+  size_t bucket(const K& key) const {
+    return static_cast<size_t>((static_cast<uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ull) >>
+                               (64 - shift_)) & mask();
+  }
+  // Adds the entry numbered e (1 based) to the table.
+  void place(uint32_t e) {
+    auto i = bucket(entries_[e - 1].first);
+    while (table_[i] != 0) {
+      i = (i + 1) & mask();
+    }
+    table_[i] = e;
+  }
+  void grow() {
+    shift_ = table_.empty() ? 3 : shift_ + 1;
+    table_.assign(size_t{1} << shift_, 0);
+    for (uint32_t e = 1; e <= entries_.size(); e++) {
+      place(e);
+    }
+  }
+
+  std::deque<value_type> entries_;
+  // 0 for an empty slot, otherwise 1 + the index of an entry.
+  std::vector<uint32_t> table_;
+  int shift_{0};
+};
+
+// A FlatMap of keys alone.
+template <class K, class Hash = std::hash<K>, class Eq = std::equal_to<K>> class FlatSet {
+public:
+  // Returns true if key was added, false if it was already present.
+  bool insert(const K& key) { return map_.try_emplace(key).second; }
+  bool contains(const K& key) const { return map_.contains(key); }
+  size_t size() const noexcept { return map_.size(); }
+
+private:
+  struct Empty {};
+  FlatMap<K, Empty, Hash, Eq> map_;
+};
+
+} // namespace wwivbasic
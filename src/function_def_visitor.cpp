@@ -17,7 +17,7 @@ FunctionDefVisitor::visitProcedureDefinition(BasicParser::ProcedureDefinitionCon
   BasicFunction fn(name, context, std::any_cast<std::vector<std::string>>(params));
   //TOOD(rushfan): Once we had "MODULE modulename" support, need to load these
   // into the rigth module.
-  ec_.module->functions.insert_or_assign(name, fn);
+  ec_.module->add_function(fn);
   return {};
 }
 
@@ -36,9 +36,8 @@ std::any FunctionDefVisitor::visitParameterDefinitionList(
 std::any FunctionDefVisitor::visitModuleDefinition(BasicParser::ModuleDefinitionContext* context) {
   const auto s = context->STRING()->getText();
   module = remove_quotes(s);
-  if (!contains(ec_.modules, module)) {
-    ec_.modules.emplace(module, Module(module));
-    ec_.module = &ec_.modules.at(module);
+  if (!ec_.find_module(Atom(module))) {
+    ec_.module = &ec_.add_module(module);
   }
 
   return {};
@@ -0,0 +1,187 @@
+#include "lexer.h"
+
+#include <cstddef>
+
+namespace wwivbasic {
+
+namespace {
+
+struct Keyword {
+  std::string_view name;
+  TokenKind kind;
+};
+
+constexpr Keyword kKeywords[] = {
+    {"TRUE", TokenKind::TRUE},     {"FALSE", TokenKind::FALSE},   {"AND", TokenKind::AND},
+    {"OR", TokenKind::OR},         {"NOT", TokenKind::NOT},       {"LET", TokenKind::LET},
+    {"MOD", TokenKind::MOD},       {"DEF", TokenKind::DEF},       {"ENDDEF", TokenKind::ENDDEF},
+    {"RETURN", TokenKind::RETURN}, {"IF", TokenKind::IF},         {"THEN", TokenKind::THEN},
+    {"ELSE", TokenKind::ELSE},     {"ELSEIF", TokenKind::ELSEIF}, {"ENDIF", TokenKind::ENDIF},
+    {"FOR", TokenKind::FOR},       {"NEXT", TokenKind::NEXT},     {"STEP", TokenKind::STEP},
+    {"TO", TokenKind::TO},         {"BREAK", TokenKind::BREAK},   {"DIM", TokenKind::DIM},
+    {"AS", TokenKind::AS},         {"MODULE", TokenKind::MODULE}, {"IMPORT", TokenKind::IMPORT},
+};
+
+bool is_letter(char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'); }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+char upper(char c) { return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c; }
+
+// An ID is a keyword when the whole word is one, so IFFY is an ID.
+TokenKind word_kind(std::string_view word) {
+  for (const auto& k : kKeywords) {
+    if (k.name.size() != word.size() || k.name[0] != upper(word[0])) {
+      continue;
+    }
+    size_t i = 1;
+    while (i < word.size() && upper(word[i]) == k.name[i]) {
+      i++;
+    }
+    if (i == word.size()) {
+      return k.kind;
+    }
+  }
+  return TokenKind::ID;
+}
+
+TokenKind punctuation_kind(char c) {
+  switch (c) {
+  case '<': return TokenKind::LT;
+  case '>': return TokenKind::GT;
+  case '=': return TokenKind::EQ;
+  case ':': return TokenKind::COLON;
+  case ';': return TokenKind::SEMICOLON;
+  case '+': return TokenKind::PLUS;
+  case '-': return TokenKind::MINUS;
+  case '*': return TokenKind::STAR;
+  case '/': return TokenKind::SLASH;
+  case '(': return TokenKind::LPAREN;
+  case ')': return TokenKind::RPAREN;
+  case '[': return TokenKind::LBRACKET;
+  case ']': return TokenKind::RBRACKET;
+  case '{': return TokenKind::LBRACE;
+  case '}': return TokenKind::RBRACE;
+  case ',': return TokenKind::COMMA;
+  case '.': return TokenKind::DOT;
+  case '@': return TokenKind::AT;
+  default: return TokenKind::ERROR;
+  }
+}
+
+} // namespace
+
+std::vector<Token> lex(std::string_view text) {
+  std::vector<Token> tokens;
+  // Scripts average a little over four characters a token.
+  tokens.reserve(text.size() / 4 + 1);
+  const auto size = text.size();
+  int line = 1;
+  size_t line_start = 0;
+  size_t pos = 0;
+
+  auto emit = [&](TokenKind kind, size_t start, size_t end) {
+    tokens.push_back({kind, text.substr(start, end - start), line,
+                      static_cast<int>(start - line_start)});
+  };
+  auto next_line = [&](size_t start) {
+    line++;
+    line_start = start;
+  };
+  // The line end at pos, "\n" or "\r\n", or 0 when there is none.
+  auto line_end = [&](size_t at) -> size_t {
+    if (at < size && text[at] == '\n') {
+      return 1;
+    }
+    return at + 1 < size && text[at] == '\r' && text[at + 1] == '\n' ? 2 : 0;
+  };
+
+  while (pos < size) {
+    const auto start = pos;
+    const char c = text[pos];
+    if (c == ' ' || c == '\t') {
+      while (pos < size && (text[pos] == ' ' || text[pos] == '\t')) {
+        pos++;
+      }
+      // Whitespace before a line end is part of the NEWLINE.
+      if (const auto n = line_end(pos)) {
+        emit(TokenKind::NEWLINE, start, pos + n);
+        next_line(pos + n);
+        pos += n;
+      }
+      continue;
+    }
+    if (const auto n = line_end(pos)) {
+      emit(TokenKind::NEWLINE, start, pos + n);
+      next_line(pos + n);
+      pos += n;
+      continue;
+    }
+    if (c == '\'') {
+      while (pos < size && text[pos] != '\r' && text[pos] != '\n') {
+        pos++;
+      }
+      const auto n = line_end(pos);
+      if (!n) {
+        emit(TokenKind::ERROR, start, pos);
+        break;
+      }
+      pos += n;
+      next_line(pos);
+      continue;
+    }
+    if (is_digit(c)) {
+      while (pos < size && is_digit(text[pos])) {
+        pos++;
+      }
+      emit(TokenKind::INT, start, pos);
+      continue;
+    }
+    if (is_letter(c)) {
+      while (pos < size && (is_letter(text[pos]) || is_digit(text[pos]) || text[pos] == '.')) {
+        pos++;
+      }
+      emit(word_kind(text.substr(start, pos - start)), start, pos);
+      continue;
+    }
+    if (c == '"') {
+      const auto close = text.find('"', pos + 1);
+      if (close == std::string_view::npos) {
+        emit(TokenKind::ERROR, start, size);
+        break;
+      }
+      pos = close + 1;
+      emit(TokenKind::STRING, start, pos);
+      // Strings may span lines.
+      for (auto i = start; i < close; i++) {
+        if (text[i] == '\n') {
+          next_line(i + 1);
+        }
+      }
+      continue;
+    }
+    if (pos + 1 < size) {
+      const char d = text[pos + 1];
+      if ((c == '<' || c == '>') && d == '=') {
+        emit(c == '<' ? TokenKind::LE : TokenKind::GE, start, pos + 2);
+        pos += 2;
+        continue;
+      }
+      if (c == '<' && d == '>') {
+        emit(TokenKind::NE, start, pos + 2);
+        pos += 2;
+        continue;
+      }
+    }
+    const auto kind = punctuation_kind(c);
+    emit(kind, start, pos + 1);
+    if (kind == TokenKind::ERROR) {
+      break;
+    }
+    pos++;
+  }
+  if (tokens.empty() || tokens.back().kind != TokenKind::ERROR) {
+    emit(TokenKind::END_OF_FILE, size, size);
+  }
+  return tokens;
+}
+
+} // namespace wwivbasic
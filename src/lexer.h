@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace wwivbasic {
+
+// The tokens of BasicLexer.g4, named as there.  Comments and whitespace
+// other than line ends are skipped, so have no kind.
+enum class TokenKind : uint8_t {
+  INT,
+  STRING,
+  ID,
+  NEWLINE,
+  // operators and punctuation
+  LT,
+  LE,
+  GT,
+  GE,
+  EQ,
+  NE,
+  COLON,
+  SEMICOLON,
+  PLUS,
+  MINUS,
+  STAR,
+  SLASH,
+  LPAREN,
+  RPAREN,
+  LBRACKET,
+  RBRACKET,
+  LBRACE,
+  RBRACE,
+  COMMA,
+  DOT,
+  AT,
+  // keywords
+  TRUE,
+  FALSE,
+  AND,
+  OR,
+  NOT,
+  LET,
+  MOD,
+  DEF,
+  ENDDEF,
+  RETURN,
+  IF,
+  THEN,
+  ELSE,
+  ELSEIF,
+  ENDIF,
+  FOR,
+  NEXT,
+  STEP,
+  TO,
+  BREAK,
+  DIM,
+  AS,
+  MODULE,
+  IMPORT,
+  // Text that no token matches, such as a string with no closing quote.
+  ERROR,
+  END_OF_FILE,
+};
+
+struct Token {
+  TokenKind kind;
+  // The text of the token in the source, with the quotes of a STRING.
+  std::string_view text;
+  int line;
+  // Column of the first character, from 0.
+  int column;
+};
+
+// Splits text into tokens as BasicLexer does: keywords are matched in any
+// case, and a comment runs to the end of its line and takes the line end
+// with it.  The tokens view text, so are only valid while it is, and end
+// with an END_OF_FILE token, or an ERROR token at the first text no token
+// matches.
+std::vector<Token> lex(std::string_view text);
+
+} // namespace wwivbasic
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "value.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace wwivbasic {
+
+/**
+ * Read only view of the arguments passed to a native function.
+ *
+ * When called from the VM this points directly at the VM's stack, so it
+ * (and any string_view taken from an argument) is only valid until the
+ * native function returns.
+ */
+class Args {
+public:
+  Args() noexcept = default;
+  Args(const Value* data, size_t size) noexcept : data_(data), size_(size) {}
+  Args(const std::vector<Value>& v) noexcept : data_(v.data()), size_(v.size()) {}
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  const Value& operator[](size_t i) const noexcept { return data_[i]; }
+  const Value& front() const noexcept { return data_[0]; }
+  const Value* begin() const noexcept { return data_; }
+  const Value* end() const noexcept { return data_ + size_; }
+
+private:
+  const Value* data_{nullptr};
+  size_t size_{0};
+};
+
+/**
+ * A native function callable from BASIC: any callable taking Args and
+ * returning a Value.  Calling one is a single indirect call, and copying
+ * one shares the callable rather than copying it.
+ */
+class NativeFunction {
+public:
+  NativeFunction() = default;
+  template <class F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, NativeFunction>>>
+  NativeFunction(F f)
+      : state_(std::make_shared<const F>(std::move(f))), thunk_(&invoke<F>) {}
+
+  Value operator()(Args args) const { return thunk_(state_.get(), args); }
+  explicit operator bool() const noexcept { return thunk_ != nullptr; }
+
+private:
+  template <class F> static Value invoke(const void* f, Args args) {
+    return (*static_cast<const F*>(f))(args);
+  }
+
+  std::shared_ptr<const void> state_;
+  Value (*thunk_)(const void*, Args){nullptr};
+};
+
+// Describes the signature of a function, function pointer or lambda.
+template <class T> struct AsFunction : public AsFunction<decltype(&T::operator())> {};
+
+template <class ReturnType, class... Args> struct AsFunction<ReturnType(Args...)> {
+  using result_type = ReturnType;
+  using args_type = std::tuple<Args...>;
+};
+
+template <class ReturnType, class... Args>
+struct AsFunction<ReturnType (*)(Args...)> : public AsFunction<ReturnType(Args...)> {};
+
+template <class Class, class ReturnType, class... Args>
+struct AsFunction<ReturnType (Class::*)(Args...) const> : public AsFunction<ReturnType(Args...)> {};
+
+// Converts an argument to a parameter of type T of a native function.
+template <class T> struct NativeArg {
+  T get(const Value& v) { return v.get<T>(); }
+};
+
+// Views string arguments in place; numbers are rendered into buf.
+template <> struct NativeArg<std::string_view> {
+  std::string_view get(const Value& v) { return v.text(buf); }
+  char buf[16];
+};
+
+template <> struct NativeArg<Value> {
+  const Value& get(const Value& v) { return v; }
+};
+
+template <class F, class R, class Params> struct NativeThunk;
+
+template <class F, class R, class... Params> struct NativeThunk<F, R, std::tuple<Params...>> {
+  static Value call(const F& f, Args args) {
+    if (args.size() < sizeof...(Params)) {
+      return Value(false); // ERROR
+    }
+    return call(f, args, std::index_sequence_for<Params...>{});
+  }
+
+  template <size_t... I> static Value call(const F& f, Args args, std::index_sequence<I...>) {
+    [[maybe_unused]] std::tuple<NativeArg<std::decay_t<Params>>...> conv;
+    if constexpr (std::is_void_v<R>) {
+      f(std::get<I>(conv).get(args[I])...);
+      return {};
+    } else if constexpr (std::is_same_v<std::decay_t<R>, Value>) {
+      return f(std::get<I>(conv).get(args[I])...);
+    } else {
+      return Value(f(std::get<I>(conv).get(args[I])...));
+    }
+  }
+};
+
+// Makes a NativeFunction from a C++ function, function pointer or lambda of
+// any arity, converting each argument to the type of its parameter.
+template <class F> NativeFunction make_basic_fn(F f) {
+  using traits = AsFunction<F>;
+  return NativeFunction([f](Args args) -> Value {
+    return NativeThunk<F, typename traits::result_type, typename traits::args_type>::call(f,
+                                                                                        args);
+  });
+}
+
+// Name to register a native function under: its C++ name without any
+// namespace qualifiers.
+constexpr std::string_view native_name(std::string_view func) {
+  const auto idx = func.rfind(':');
+  return idx == std::string_view::npos ? func : func.substr(idx + 1);
+}
+
+} // namespace wwivbasic
@@ -0,0 +1,380 @@
+#include "optimizer.h"
+#include "type_feedback.h"
+#include "fmt/format.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace wwivbasic {
+
+namespace {
+
+std::unique_ptr<ast::Expr> make_literal(const Value& value, int line) {
+  switch (value.type()) {
+  case Value::Type::BOOLEAN:
+    return std::make_unique<ast::BoolLiteral>(value.toBool(), line);
+  case Value::Type::INTEGER:
+    return std::make_unique<ast::IntLiteral>(value.toInt(), line);
+  case Value::Type::STRING:
+    return std::make_unique<ast::StringLiteral>(std::string(value.view()), line);
+  case Value::Type::ARRAY:
+  case Value::Type::DICT:
+    break;
+  }
+  return nullptr;
+}
+
+// Applies op as the VM does, or returns nullopt when the result must be left
+// to runtime.
+std::optional<Value> apply(ast::BinaryOp op, const Value& left, const Value& right) {
+  switch (op) {
+  case ast::BinaryOp::ADD:
+  case ast::BinaryOp::SUB:
+  case ast::BinaryOp::MUL:
+    if (left.is_int()) {
+      // In 64 bits, which can not overflow for two ints, so a result out of
+      // range is left to runtime rather than overflowing here.
+      const int64_t l = left.toInt();
+      const int64_t r = right.toInt();
+      const auto result =
+          op == ast::BinaryOp::ADD ? l + r : (op == ast::BinaryOp::SUB ? l - r : l * r);
+      if (result < std::numeric_limits<int>::min() || result > std::numeric_limits<int>::max()) {
+        return std::nullopt;
+      }
+    }
+    break;
+  case ast::BinaryOp::DIV:
+  case ast::BinaryOp::MOD:
+    if (left.is_int() && (right.toInt() == 0 ||
+                          (left.toInt() == std::numeric_limits<int>::min() && right.toInt() == -1))) {
+      return std::nullopt;
+    }
+    break;
+  case ast::BinaryOp::AND: return Value(left.toBool() && right.toBool());
+  case ast::BinaryOp::OR: return Value(left.toBool() || right.toBool());
+  default:
+    break;
+  }
+  return apply_generic(op, left, right);
+}
+
+std::string to_string(ast::BinaryOp op) {
+  switch (op) {
+  case ast::BinaryOp::ADD: return "+";
+  case ast::BinaryOp::SUB: return "-";
+  case ast::BinaryOp::MUL: return "*";
+  case ast::BinaryOp::DIV: return "/";
+  case ast::BinaryOp::MOD: return "MOD";
+  case ast::BinaryOp::AND: return "AND";
+  case ast::BinaryOp::OR: return "OR";
+  case ast::BinaryOp::EQ: return "=";
+  case ast::BinaryOp::NE: return "<>";
+  case ast::BinaryOp::LT: return "<";
+  case ast::BinaryOp::LE: return "<=";
+  case ast::BinaryOp::GT: return ">";
+  case ast::BinaryOp::GE: return ">=";
+  }
+  return "?";
+}
+
+std::string dump_expr(const ast::Expr& expr);
+
+// Operands that are themselves binary expressions are parenthesized, so
+// the dump shows how the expression was parsed.
+std::string dump_operand(const ast::Expr& expr) {
+  if (expr.kind == ast::ExprKind::BINARY) {
+    return fmt::format("({})", dump_expr(expr));
+  }
+  return dump_expr(expr);
+}
+
+std::string dump_call(const ast::CallExpr& call) {
+  std::string s = call.name + "(";
+  for (size_t i = 0; i < call.args.size(); i++) {
+    if (i > 0) {
+      s += ", ";
+    }
+    s += dump_expr(*call.args[i]);
+  }
+  return s + ")";
+}
+
+std::string dump_expr(const ast::Expr& expr) {
+  switch (expr.kind) {
+  case ast::ExprKind::INT:
+    return std::to_string(static_cast<const ast::IntLiteral&>(expr).value);
+  case ast::ExprKind::STRING:
+    return fmt::format("\"{}\"", static_cast<const ast::StringLiteral&>(expr).value);
+  case ast::ExprKind::BOOLEAN:
+    return static_cast<const ast::BoolLiteral&>(expr).value ? "TRUE" : "FALSE";
+  case ast::ExprKind::VARIABLE:
+    return static_cast<const ast::VariableRef&>(expr).name;
+  case ast::ExprKind::CALL:
+    return dump_call(static_cast<const ast::CallExpr&>(expr));
+  case ast::ExprKind::INDEX: {
+    const auto& e = static_cast<const ast::IndexExpr&>(expr);
+    return fmt::format("{}[{}]", e.name, dump_expr(*e.index));
+  }
+  case ast::ExprKind::DICT: {
+    const auto& entries = static_cast<const ast::DictExpr&>(expr).entries;
+    std::string s = "{";
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (i > 0) {
+        s += ", ";
+      }
+      s += fmt::format("{}: {}", dump_expr(*entries[i].key), dump_expr(*entries[i].value));
+    }
+    return s + "}";
+  }
+  case ast::ExprKind::BINARY: {
+    const auto& e = static_cast<const ast::BinaryExpr&>(expr);
+    return fmt::format("{} {} {}", dump_operand(*e.left), to_string(e.op),
+                       dump_operand(*e.right));
+  }
+  }
+  return {};
+}
+
+void dump_block(const ast::Block& block, int indent, std::string& out);
+
+void dump_stmt(const ast::Stmt& stmt, int indent, std::string& out) {
+  const std::string pad(indent * 2, ' ');
+  switch (stmt.kind) {
+  case ast::StmtKind::ASSIGN: {
+    const auto& s = static_cast<const ast::AssignStmt&>(stmt);
+    if (s.index) {
+      out += fmt::format("{}{}[{}] = {}\n", pad, s.name, dump_expr(*s.index), dump_expr(*s.value));
+    } else {
+      out += fmt::format("{}{} = {}\n", pad, s.name, dump_expr(*s.value));
+    }
+  } break;
+  case ast::StmtKind::CALL: {
+    const auto& s = static_cast<const ast::CallStmt&>(stmt);
+    out += fmt::format("{}{}\n", pad, dump_call(*s.call));
+  } break;
+  case ast::StmtKind::IF: {
+    const auto& s = static_cast<const ast::IfStmt&>(stmt);
+    for (size_t i = 0; i < s.branches.size(); i++) {
+      out += fmt::format("{}{} {} THEN\n", pad, i == 0 ? "IF" : "ELSEIF",
+                         dump_expr(*s.branches[i].condition));
+      dump_block(s.branches[i].body, indent + 1, out);
+    }
+    if (s.has_else) {
+      out += fmt::format("{}ELSE\n", pad);
+      dump_block(s.else_body, indent + 1, out);
+    }
+    out += fmt::format("{}ENDIF\n", pad);
+  } break;
+  case ast::StmtKind::FOR: {
+    const auto& s = static_cast<const ast::ForStmt&>(stmt);
+    out += fmt::format("{}FOR {} = {} TO {}", pad, s.var, dump_expr(*s.start), dump_expr(*s.end));
+    if (s.step) {
+      out += fmt::format(" STEP {}", dump_expr(*s.step));
+    }
+    out += "\n";
+    dump_block(s.body, indent + 1, out);
+    out += fmt::format("{}NEXT\n", pad);
+  } break;
+  case ast::StmtKind::BREAK:
+    out += fmt::format("{}BREAK\n", pad);
+    break;
+  case ast::StmtKind::RETURN: {
+    const auto& s = static_cast<const ast::ReturnStmt&>(stmt);
+    out += fmt::format("{}RETURN {}\n", pad, dump_expr(*s.value));
+  } break;
+  case ast::StmtKind::IMPORT: {
+    const auto& s = static_cast<const ast::ImportStmt&>(stmt);
+    out += s.file ? fmt::format("{}IMPORT \"{}\"\n", pad, s.name)
+                  : fmt::format("{}IMPORT @{}\n", pad, s.name);
+  } break;
+  case ast::StmtKind::DIM: {
+    const auto& s = static_cast<const ast::DimStmt&>(stmt);
+    out += fmt::format("{}DIM {}[{}] AS {}\n", pad, s.name, dump_expr(*s.size),
+                       s.type == Value::Type::STRING    ? "STRING"
+                       : s.type == Value::Type::BOOLEAN ? "BOOLEAN"
+                                                        : "INTEGER");
+  } break;
+  }
+}
+
+void dump_block(const ast::Block& block, int indent, std::string& out) {
+  for (const auto& stmt : block) {
+    dump_stmt(*stmt, indent, out);
+  }
+}
+
+} // namespace
+
+std::optional<Value> literal_value(const ast::Expr& expr) {
+  switch (expr.kind) {
+  case ast::ExprKind::INT:
+    return Value(static_cast<const ast::IntLiteral&>(expr).value);
+  case ast::ExprKind::STRING:
+    return Value(static_cast<const ast::StringLiteral&>(expr).value);
+  case ast::ExprKind::BOOLEAN:
+    return Value(static_cast<const ast::BoolLiteral&>(expr).value);
+  default:
+    return std::nullopt;
+  }
+}
+
+void Optimizer::optimize(ast::Unit& unit) {
+  optimize_block(unit.statements);
+  for (auto& proc : unit.procedures) {
+    optimize_block(proc.body);
+  }
+}
+
+void Optimizer::optimize_block(ast::Block& block) {
+  ast::Block out;
+  out.reserve(block.size());
+  for (auto& stmt : block) {
+    optimize_stmt(std::move(stmt), out);
+  }
+  block = std::move(out);
+}
+
+void Optimizer::optimize_stmt(std::unique_ptr<ast::Stmt>&& stmt, ast::Block& out) {
+  switch (stmt->kind) {
+  case ast::StmtKind::ASSIGN: {
+    auto& s = static_cast<ast::AssignStmt&>(*stmt);
+    if (s.index) {
+      fold(s.index);
+    }
+    fold(s.value);
+  } break;
+  case ast::StmtKind::CALL:
+    for (auto& arg : static_cast<ast::CallStmt&>(*stmt).call->args) {
+      fold(arg);
+    }
+    break;
+  case ast::StmtKind::IF:
+    optimize_if(std::unique_ptr<ast::IfStmt>(static_cast<ast::IfStmt*>(stmt.release())), out);
+    return;
+  case ast::StmtKind::FOR: {
+    auto& s = static_cast<ast::ForStmt&>(*stmt);
+    fold(s.start);
+    fold(s.end);
+    if (s.step) {
+      fold(s.step);
+    }
+    optimize_block(s.body);
+  } break;
+  case ast::StmtKind::RETURN:
+    fold(static_cast<ast::ReturnStmt&>(*stmt).value);
+    break;
+  case ast::StmtKind::DIM:
+    fold(static_cast<ast::DimStmt&>(*stmt).size);
+    break;
+  case ast::StmtKind::BREAK:
+  case ast::StmtKind::IMPORT:
+    break;
+  }
+  out.push_back(std::move(stmt));
+}
+
+void Optimizer::optimize_if(std::unique_ptr<ast::IfStmt>&& stmt, ast::Block& out) {
+  std::vector<ast::IfBranch> branches;
+  for (auto& branch : stmt->branches) {
+    fold(branch.condition);
+    const auto cond = literal_value(*branch.condition);
+    if (!cond) {
+      optimize_block(branch.body);
+      branches.push_back(std::move(branch));
+      continue;
+    }
+    if (!cond->toBool()) {
+      // Never taken.
+      removed_branches++;
+      continue;
+    }
+    // Always taken once reached: it becomes the ELSE, and nothing after it
+    // can run.
+    const auto skipped = &stmt->branches.back() - &branch;
+    removed_branches += static_cast<int>(skipped) + (stmt->has_else ? 1 : 0);
+    stmt->else_body = std::move(branch.body);
+    stmt->has_else = true;
+    break;
+  }
+  stmt->branches = std::move(branches);
+  if (stmt->has_else) {
+    optimize_block(stmt->else_body);
+  }
+
+  if (!stmt->branches.empty()) {
+    out.push_back(std::move(stmt));
+  } else if (stmt->has_else) {
+    // IF does not start a new scope, so the ELSE can replace it.
+    for (auto& s : stmt->else_body) {
+      out.push_back(std::move(s));
+    }
+  }
+}
+
+void Optimizer::fold(std::unique_ptr<ast::Expr>& expr) {
+  switch (expr->kind) {
+  case ast::ExprKind::CALL:
+    for (auto& arg : static_cast<ast::CallExpr&>(*expr).args) {
+      fold(arg);
+    }
+    return;
+  case ast::ExprKind::INDEX:
+    fold(static_cast<ast::IndexExpr&>(*expr).index);
+    return;
+  case ast::ExprKind::DICT:
+    for (auto& entry : static_cast<ast::DictExpr&>(*expr).entries) {
+      fold(entry.key);
+      fold(entry.value);
+    }
+    return;
+  case ast::ExprKind::BINARY: {
+    auto& e = static_cast<ast::BinaryExpr&>(*expr);
+    fold(e.left);
+    fold(e.right);
+    const auto left = literal_value(*e.left);
+    if (left && (e.op == ast::BinaryOp::AND || e.op == ast::BinaryOp::OR) &&
+        left->toBool() == (e.op == ast::BinaryOp::OR)) {
+      // The right operand would never be evaluated.
+      expr = std::make_unique<ast::BoolLiteral>(left->toBool(), e.line);
+      folded++;
+      return;
+    }
+    const auto right = left ? literal_value(*e.right) : std::nullopt;
+    if (!right) {
+      return;
+    }
+    if (auto result = apply(e.op, *left, *right)) {
+      expr = make_literal(*result, e.line);
+      folded++;
+    }
+  } return;
+  default:
+    return;
+  }
+}
+
+std::string dump(const ast::Unit& unit) {
+  std::string out;
+  dump_block(unit.statements, 0, out);
+  std::string module;
+  for (const auto& proc : unit.procedures) {
+    if (proc.module != module) {
+      module = proc.module;
+      out += fmt::format("MODULE \"{}\"\n", module);
+    }
+    out += fmt::format("\nDEF {}(", proc.name);
+    for (size_t i = 0; i < proc.params.size(); i++) {
+      out += i > 0 ? ", " + proc.params[i] : proc.params[i];
+    }
+    out += ")\n";
+    dump_block(proc.body, 1, out);
+    out += "ENDDEF\n";
+  }
+  return out;
+}
+
+} // namespace wwivbasic
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ast.h"
+#include "value.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace wwivbasic {
+
+/**
+ * Simplifies the AST of a source unit before it is compiled.
+ *
+ * Binary expressions whose operands are both literals are replaced by a
+ * literal holding their result, computed with the same Value operators the
+ * VM uses, so folding never changes what a script does.  AND and OR are
+ * also folded when their left operand is a literal that decides the result.
+ *
+ * IF and ELSEIF branches whose condition folds to FALSE are removed, and a
+ * branch whose condition folds to TRUE becomes the ELSE of the IF, dropping
+ * the branches after it.
+ */
+class Optimizer {
+public:
+  Optimizer() = default;
+
+  void optimize(ast::Unit& unit);
+
+  // Number of binary expressions replaced by literals.
+  int folded{0};
+  // Number of IF, ELSEIF and ELSE branches removed as unreachable.
+  int removed_branches{0};
+
+private:
+  void optimize_block(ast::Block& block);
+  // Optimizes stmt, adding what replaces it to out.
+  void optimize_stmt(std::unique_ptr<ast::Stmt>&& stmt, ast::Block& out);
+  void optimize_if(std::unique_ptr<ast::IfStmt>&& stmt, ast::Block& out);
+  void fold(std::unique_ptr<ast::Expr>& expr);
+};
+
+// Value of expr if it is a literal.
+std::optional<Value> literal_value(const ast::Expr& expr);
+
+// Formats unit as BASIC source, for checking what the optimizer did.
+std::string dump(const ast::Unit& unit);
+
+} // namespace wwivbasic
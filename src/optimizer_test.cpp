@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+#include "ast.h"
+#include "compiler.h"
+#include "context.h"
+#include "optimizer.h"
+#include "vm.h"
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace wwivbasic;
+
+namespace {
+
+std::unique_ptr<ast::Expr> lit(int v) { return std::make_unique<ast::IntLiteral>(v, 1); }
+std::unique_ptr<ast::Expr> lit(bool v) { return std::make_unique<ast::BoolLiteral>(v, 1); }
+std::unique_ptr<ast::Expr> lit(const char* v) {
+  return std::make_unique<ast::StringLiteral>(v, 1);
+}
+std::unique_ptr<ast::Expr> var(const char* n) { return std::make_unique<ast::VariableRef>(n, 1); }
+
+std::unique_ptr<ast::Expr> bin(ast::BinaryOp op, std::unique_ptr<ast::Expr>&& l,
+                               std::unique_ptr<ast::Expr>&& r) {
+  return std::make_unique<ast::BinaryExpr>(op, std::move(l), std::move(r), 1);
+}
+
+std::unique_ptr<ast::Stmt> assign(const char* n, std::unique_ptr<ast::Expr>&& v) {
+  return std::make_unique<ast::AssignStmt>(n, std::move(v), 1);
+}
+
+std::unique_ptr<ast::Stmt> print(std::unique_ptr<ast::Expr>&& v) {
+  auto call = std::make_unique<ast::CallExpr>("PRINT", 1);
+  call->args.push_back(std::move(v));
+  return std::make_unique<ast::CallStmt>(std::move(call), 1);
+}
+
+ast::IfBranch branch(std::unique_ptr<ast::Expr>&& cond, std::unique_ptr<ast::Stmt>&& stmt) {
+  ast::IfBranch b;
+  b.condition = std::move(cond);
+  b.body.push_back(std::move(stmt));
+  return b;
+}
+
+} // namespace
+
+class OptimizerTest : public ::testing::Test {
+protected:
+  std::string Optimize() {
+    opt_.optimize(unit_);
+    return dump(unit_);
+  }
+
+  // Compiles and runs unit_, returning each line written by PRINT.
+  std::vector<std::string> Run() {
+    Context ec;
+    std::vector<std::string> output;
+    ec.root->native_functionl("PRINT", [&output](Args args) -> Value {
+      output.push_back(args.empty() ? "" : args.front().toString());
+      return {};
+    });
+    auto program = Compiler().compile(unit_);
+    VM vm(ec, *program);
+    vm.run();
+    return output;
+  }
+
+  ast::Unit unit_;
+  Optimizer opt_;
+};
+
+TEST_F(OptimizerTest, FoldsLiterals) {
+  using ast::BinaryOp;
+  // 123 + 17
+  unit_.statements.push_back(assign("a", bin(BinaryOp::ADD, lit(123), lit(17))));
+  // (2 * 3) * a
+  unit_.statements.push_back(
+      assign("b", bin(BinaryOp::MUL, bin(BinaryOp::MUL, lit(2), lit(3)), var("a"))));
+  // "x" + 1 = "x1"
+  unit_.statements.push_back(
+      assign("c", bin(BinaryOp::EQ, bin(BinaryOp::ADD, lit("x"), lit(1)), lit("x1"))));
+  // Left for runtime.
+  unit_.statements.push_back(assign("d", bin(BinaryOp::DIV, lit(1), lit(0))));
+  // The right operand is never evaluated.
+  unit_.statements.push_back(assign("e", bin(BinaryOp::OR, lit(1), var("a"))));
+  unit_.statements.push_back(assign("f", bin(BinaryOp::AND, lit(true), var("a"))));
+
+  EXPECT_EQ(Optimize(), "a = 140\nb = 6 * a\nc = TRUE\nd = 1 / 0\ne = TRUE\nf = TRUE AND a\n");
+  EXPECT_EQ(opt_.folded, 5);
+}
+
+TEST_F(OptimizerTest, LeavesOverflowToRuntime) {
+  using ast::BinaryOp;
+  const auto max = std::numeric_limits<int>::max();
+  const auto min = std::numeric_limits<int>::min();
+  unit_.statements.push_back(assign("a", bin(BinaryOp::ADD, lit(max), lit(1))));
+  unit_.statements.push_back(assign("b", bin(BinaryOp::SUB, lit(min), lit(1))));
+  unit_.statements.push_back(assign("c", bin(BinaryOp::MUL, lit(65536), lit(65536))));
+  // Just in range, so folded.
+  unit_.statements.push_back(assign("d", bin(BinaryOp::ADD, lit(max - 1), lit(1))));
+  unit_.statements.push_back(assign("e", bin(BinaryOp::MUL, lit(-65536), lit(32768))));
+
+  EXPECT_EQ(Optimize(), "a = 2147483647 + 1\nb = -2147483648 - 1\nc = 65536 * 65536\n"
+                        "d = 2147483647\ne = -2147483648\n");
+  EXPECT_EQ(opt_.folded, 2);
+}
+
+TEST_F(OptimizerTest, RemovesDeadBranches) {
+  unit_.statements.push_back(assign("a", lit(20)));
+  {
+    // IF TRUE THEN
+    auto s = std::make_unique<ast::IfStmt>(1);
+    s->branches.push_back(branch(lit(true), print(lit("passed"))));
+    unit_.statements.push_back(std::move(s));
+  }
+  {
+    // IF FALSE THEN
+    auto s = std::make_unique<ast::IfStmt>(1);
+    s->branches.push_back(branch(lit(false), print(lit("failed"))));
+    unit_.statements.push_back(std::move(s));
+  }
+
+  EXPECT_EQ(Optimize(), "a = 20\nPRINT(\"passed\")\n");
+  EXPECT_EQ(opt_.removed_branches, 1);
+  EXPECT_EQ(Run(), std::vector<std::string>({"passed"}));
+}
+
+TEST_F(OptimizerTest, AlwaysTrueElseIfBecomesElse) {
+  using ast::BinaryOp;
+  unit_.statements.push_back(assign("a", lit(2)));
+  auto s = std::make_unique<ast::IfStmt>(1);
+  s->branches.push_back(branch(bin(BinaryOp::EQ, var("a"), lit(1)), print(lit("one"))));
+  s->branches.push_back(branch(bin(BinaryOp::EQ, lit(1), lit(2)), print(lit("never"))));
+  s->branches.push_back(branch(bin(BinaryOp::EQ, lit(1), lit(1)), print(lit("other"))));
+  s->branches.push_back(branch(bin(BinaryOp::EQ, var("a"), lit(3)), print(lit("three"))));
+  s->has_else = true;
+  s->else_body.push_back(print(lit("else")));
+  unit_.statements.push_back(std::move(s));
+
+  EXPECT_EQ(Optimize(), "a = 2\n"
+                        "IF a = 1 THEN\n"
+                        "  PRINT(\"one\")\n"
+                        "ELSE\n"
+                        "  PRINT(\"other\")\n"
+                        "ENDIF\n");
+  // The ELSEIF 1 = 2, the ELSEIF after the always true one, and the ELSE.
+  EXPECT_EQ(opt_.removed_branches, 3);
+  EXPECT_EQ(Run(), std::vector<std::string>({"other"}));
+}
+
+TEST_F(OptimizerTest, FoldsForStep) {
+  using ast::BinaryOp;
+  // FOR i = 1 TO 2 + 3 STEP -1, as the parser builds it.
+  auto s = std::make_unique<ast::ForStmt>("i", 1);
+  s->start = lit(1);
+  s->end = bin(BinaryOp::ADD, lit(2), lit(3));
+  s->step = bin(BinaryOp::SUB, lit(0), lit(1));
+  s->body.push_back(print(var("i")));
+  unit_.statements.push_back(std::move(s));
+
+  EXPECT_EQ(Optimize(), "FOR i = 1 TO 5 STEP -1\n  PRINT(i)\nNEXT\n");
+  EXPECT_EQ(opt_.folded, 2);
+  EXPECT_TRUE(Run().empty());
+}
@@ -0,0 +1,416 @@
+#include "parser.h"
+#include "array.h"
+#include "utils.h"
+#include "core/strings.h"
+#include "fmt/format.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace wwivbasic {
+
+using namespace wwiv::strings;
+
+namespace {
+
+// Thrown at the first syntax error, once it is recorded, to unwind to
+// Parser::parse().
+class SyntaxError {};
+
+// Operator precedences, highest binding most tightly, as the alternatives
+// of expr are ordered.  0 for tokens that are not binary operators.
+int precedence_of(TokenKind kind) {
+  switch (kind) {
+  case TokenKind::OR: return 1;
+  case TokenKind::AND: return 2;
+  case TokenKind::EQ:
+  case TokenKind::NE:
+  case TokenKind::LT:
+  case TokenKind::LE:
+  case TokenKind::GT:
+  case TokenKind::GE: return 3;
+  case TokenKind::PLUS:
+  case TokenKind::MINUS: return 4;
+  case TokenKind::STAR:
+  case TokenKind::SLASH:
+  case TokenKind::MOD: return 5;
+  default: return 0;
+  }
+}
+
+ast::BinaryOp to_binary_op(TokenKind kind) {
+  switch (kind) {
+  case TokenKind::OR: return ast::BinaryOp::OR;
+  case TokenKind::AND: return ast::BinaryOp::AND;
+  case TokenKind::EQ: return ast::BinaryOp::EQ;
+  case TokenKind::NE: return ast::BinaryOp::NE;
+  case TokenKind::LT: return ast::BinaryOp::LT;
+  case TokenKind::LE: return ast::BinaryOp::LE;
+  case TokenKind::GT: return ast::BinaryOp::GT;
+  case TokenKind::GE: return ast::BinaryOp::GE;
+  case TokenKind::PLUS: return ast::BinaryOp::ADD;
+  case TokenKind::MINUS: return ast::BinaryOp::SUB;
+  case TokenKind::STAR: return ast::BinaryOp::MUL;
+  case TokenKind::SLASH: return ast::BinaryOp::DIV;
+  case TokenKind::MOD: return ast::BinaryOp::MOD;
+  default: break;
+  }
+  throw std::invalid_argument(fmt::format("Unknown binary operator token: {}", static_cast<int>(kind)));
+}
+
+// Token text as ANTLR shows it in messages, with line ends escaped.
+std::string display_text(const Token& token) {
+  if (token.kind == TokenKind::END_OF_FILE) {
+    return "<EOF>";
+  }
+  std::string s;
+  for (const auto c : token.text) {
+    switch (c) {
+    case '\n': s += "\\n"; break;
+    case '\r': s += "\\r"; break;
+    case '\t': s += "\\t"; break;
+    default: s += c; break;
+    }
+  }
+  return s;
+}
+
+} // namespace
+
+Parser::Parser(std::string filename, std::string_view text)
+    : filename_(std::move(filename)), tokens_(lex(text)) {}
+
+std::unique_ptr<ast::Unit> Parser::parse() {
+  auto unit = std::make_unique<ast::Unit>();
+  unit->filename = filename_;
+  pos_ = 0;
+  module_.clear();
+  unknown_dim_type_.clear();
+  try {
+    // main needs at least one element.
+    if (at(TokenKind::END_OF_FILE)) {
+      syntax_error(peek());
+    }
+    while (!at(TokenKind::END_OF_FILE)) {
+      switch (peek().kind) {
+      case TokenKind::DEF:
+        unit->procedures.push_back(procedure());
+        break;
+      case TokenKind::IMPORT:
+        import_module(*unit);
+        break;
+      case TokenKind::MODULE:
+        pos_++;
+        module_ = remove_quotes(std::string(expect(TokenKind::STRING).text));
+        expect(TokenKind::NEWLINE);
+        break;
+      default:
+        if (auto s = statement()) {
+          unit->statements.push_back(std::move(s));
+        }
+        break;
+      }
+    }
+  } catch (const SyntaxError&) {
+    return nullptr;
+  }
+  if (!unknown_dim_type_.empty()) {
+    throw std::invalid_argument(fmt::format("Unknown DIM type: '{}'", unknown_dim_type_));
+  }
+  return unit;
+}
+
+ast::ProcedureDef Parser::procedure() {
+  ast::ProcedureDef def;
+  def.line = expect(TokenKind::DEF).line;
+  def.name = std::string(expect(TokenKind::ID).text);
+  def.module = module_;
+  expect(TokenKind::LPAREN);
+  if (!at(TokenKind::RPAREN)) {
+    do {
+      def.params.emplace_back(expect(TokenKind::ID).text);
+    } while (accept(TokenKind::COMMA));
+  }
+  expect(TokenKind::RPAREN);
+  def.body = statements();
+  expect(TokenKind::ENDDEF);
+  return def;
+}
+
+void Parser::import_module(ast::Unit& unit) {
+  const auto line = expect(TokenKind::IMPORT).line;
+  if (accept(TokenKind::AT)) {
+    unit.statements.push_back(
+        std::make_unique<ast::ImportStmt>(std::string(expect(TokenKind::ID).text), false, line));
+  } else {
+    unit.statements.push_back(std::make_unique<ast::ImportStmt>(
+        remove_quotes(std::string(expect(TokenKind::STRING).text)), true, line));
+  }
+  expect(TokenKind::NEWLINE);
+}
+
+ast::Block Parser::statements() {
+  ast::Block block;
+  for (;;) {
+    switch (peek().kind) {
+    case TokenKind::NEWLINE:
+    case TokenKind::ID:
+    case TokenKind::IF:
+    case TokenKind::FOR:
+    case TokenKind::RETURN:
+    case TokenKind::BREAK:
+    case TokenKind::DIM:
+      if (auto s = statement()) {
+        block.push_back(std::move(s));
+      }
+      break;
+    default:
+      return block;
+    }
+  }
+}
+
+std::unique_ptr<ast::Stmt> Parser::statement() {
+  const auto& token = peek();
+  switch (token.kind) {
+  case TokenKind::NEWLINE:
+    // emptyStatement
+    pos_++;
+    return {};
+  case TokenKind::ID:
+    if (peek(1).kind == TokenKind::LPAREN) {
+      auto c = call();
+      expect(TokenKind::NEWLINE);
+      return std::make_unique<ast::CallStmt>(std::move(c), token.line);
+    }
+    return assignment();
+  case TokenKind::IF:
+    return if_statement();
+  case TokenKind::FOR:
+    return for_statement();
+  case TokenKind::RETURN: {
+    pos_++;
+    auto value = expr();
+    expect(TokenKind::NEWLINE);
+    return std::make_unique<ast::ReturnStmt>(std::move(value), token.line);
+  }
+  case TokenKind::BREAK:
+    pos_++;
+    expect(TokenKind::NEWLINE);
+    return std::make_unique<ast::BreakStmt>(token.line);
+  case TokenKind::DIM:
+    return dim_statement();
+  default:
+    syntax_error(token);
+  }
+}
+
+std::unique_ptr<ast::Stmt> Parser::assignment() {
+  const auto& name = expect(TokenKind::ID);
+  std::unique_ptr<ast::Expr> index;
+  if (accept(TokenKind::LBRACKET)) {
+    index = expr();
+    expect(TokenKind::RBRACKET);
+  }
+  expect(TokenKind::EQ);
+  auto stmt = std::make_unique<ast::AssignStmt>(std::string(name.text), expr(), name.line);
+  stmt->index = std::move(index);
+  expect(TokenKind::NEWLINE);
+  return stmt;
+}
+
+std::unique_ptr<ast::Stmt> Parser::if_statement() {
+  auto stmt = std::make_unique<ast::IfStmt>(expect(TokenKind::IF).line);
+  auto condition = expr();
+  expect(TokenKind::THEN);
+  // The optional NEWLINE after THEN is an empty statement to statements().
+  stmt->branches.push_back({std::move(condition), statements()});
+  bool has_elseif = false;
+  while (accept(TokenKind::ELSEIF)) {
+    has_elseif = true;
+    condition = expr();
+    expect(TokenKind::THEN);
+    stmt->branches.push_back({std::move(condition), statements()});
+  }
+  if (accept(TokenKind::ELSE)) {
+    stmt->has_else = true;
+    stmt->else_body = statements();
+  } else if (has_elseif) {
+    // ifThenElseIfElseStatement needs the ELSE.
+    syntax_error(peek());
+  }
+  expect(TokenKind::ENDIF);
+  expect(TokenKind::NEWLINE);
+  return stmt;
+}
+
+std::unique_ptr<ast::Stmt> Parser::for_statement() {
+  const auto line = expect(TokenKind::FOR).line;
+  auto stmt = std::make_unique<ast::ForStmt>(std::string(expect(TokenKind::ID).text), line);
+  expect(TokenKind::EQ);
+  stmt->start = expr();
+  expect(TokenKind::TO);
+  stmt->end = expr();
+  if (accept(TokenKind::STEP)) {
+    if (accept(TokenKind::MINUS)) {
+      // The minus applies to the first operand of the step, as a unary
+      // minus binding more tightly than any operator would, so STEP -a + b
+      // is (0 - a) + b.  0 - n is folded by the optimizer when n is a
+      // literal.
+      const auto step_line = peek().line;
+      auto first = std::make_unique<ast::BinaryExpr>(
+          ast::BinaryOp::SUB, std::make_unique<ast::IntLiteral>(0, line), primary(), line);
+      stmt->step = operators(std::move(first), 1, step_line);
+    } else {
+      stmt->step = expr();
+    }
+  }
+  stmt->body = statements();
+  expect(TokenKind::NEXT);
+  expect(TokenKind::NEWLINE);
+  return stmt;
+}
+
+std::unique_ptr<ast::Stmt> Parser::dim_statement() {
+  const auto line = expect(TokenKind::DIM).line;
+  std::string name(expect(TokenKind::ID).text);
+  expect(TokenKind::LBRACKET);
+  auto size = expr();
+  expect(TokenKind::RBRACKET);
+  auto type = Value::Type::INTEGER;
+  if (accept(TokenKind::AS)) {
+    const std::string type_name(expect(TokenKind::ID).text);
+    if (const auto t = element_type(type_name)) {
+      type = *t;
+    } else if (unknown_dim_type_.empty()) {
+      unknown_dim_type_ = type_name;
+    }
+  }
+  expect(TokenKind::NEWLINE);
+  return std::make_unique<ast::DimStmt>(std::move(name), type, std::move(size), line);
+}
+
+std::unique_ptr<ast::CallExpr> Parser::call() {
+  const auto& name = expect(TokenKind::ID);
+  auto c = std::make_unique<ast::CallExpr>(std::string(name.text), name.line);
+  expect(TokenKind::LPAREN);
+  if (!at(TokenKind::RPAREN)) {
+    do {
+      c->args.push_back(expr());
+    } while (accept(TokenKind::COMMA));
+  }
+  expect(TokenKind::RPAREN);
+  return c;
+}
+
+std::unique_ptr<ast::Expr> Parser::expr(int precedence) {
+  // A binary expression's line is that of its first token, even when that
+  // is the parenthesis of a parenthesized left operand.
+  const auto line = peek().line;
+  return operators(primary(), precedence, line);
+}
+
+std::unique_ptr<ast::Expr> Parser::operators(std::unique_ptr<ast::Expr> left, int precedence,
+                                             int line) {
+  for (;;) {
+    const auto kind = peek().kind;
+    const auto p = precedence_of(kind);
+    if (p == 0 || p < precedence) {
+      return left;
+    }
+    pos_++;
+    // Binding the right operand more tightly makes every operator left
+    // associative.
+    auto right = expr(p + 1);
+    left = std::make_unique<ast::BinaryExpr>(to_binary_op(kind), std::move(left),
+                                             std::move(right), line);
+  }
+}
+
+std::unique_ptr<ast::Expr> Parser::primary() {
+  const auto& token = peek();
+  switch (token.kind) {
+  case TokenKind::ID: {
+    if (peek(1).kind == TokenKind::LPAREN) {
+      return call();
+    }
+    pos_++;
+    std::string name(token.text);
+    if (accept(TokenKind::LBRACKET)) {
+      auto index = expr();
+      expect(TokenKind::RBRACKET);
+      return std::make_unique<ast::IndexExpr>(std::move(name), std::move(index), token.line);
+    }
+    return std::make_unique<ast::VariableRef>(std::move(name), token.line);
+  }
+  case TokenKind::LPAREN: {
+    pos_++;
+    auto e = expr();
+    expect(TokenKind::RPAREN);
+    return e;
+  }
+  case TokenKind::LBRACE:
+    return dictionary();
+  case TokenKind::INT:
+    pos_++;
+    return std::make_unique<ast::IntLiteral>(to_number<int>(std::string(token.text)), token.line);
+  case TokenKind::STRING:
+    pos_++;
+    return std::make_unique<ast::StringLiteral>(remove_quotes(std::string(token.text)),
+                                                token.line);
+  case TokenKind::TRUE:
+  case TokenKind::FALSE:
+    pos_++;
+    return std::make_unique<ast::BoolLiteral>(token.kind == TokenKind::TRUE, token.line);
+  default:
+    syntax_error(token);
+  }
+}
+
+std::unique_ptr<ast::Expr> Parser::dictionary() {
+  auto d = std::make_unique<ast::DictExpr>(expect(TokenKind::LBRACE).line);
+  if (!at(TokenKind::RBRACE)) {
+    do {
+      auto key = expr();
+      expect(TokenKind::COLON);
+      d->entries.push_back({std::move(key), expr()});
+    } while (accept(TokenKind::COMMA));
+  }
+  expect(TokenKind::RBRACE);
+  return d;
+}
+
+const Token& Parser::peek(size_t ahead) const {
+  // The last token is END_OF_FILE or ERROR, neither of which is consumed.
+  const auto i = pos_ + ahead;
+  return i < tokens_.size() ? tokens_[i] : tokens_.back();
+}
+
+bool Parser::accept(TokenKind kind) {
+  if (!at(kind)) {
+    return false;
+  }
+  pos_++;
+  return true;
+}
+
+const Token& Parser::expect(TokenKind kind) {
+  const auto& token = peek();
+  if (token.kind != kind) {
+    syntax_error(token);
+  }
+  pos_++;
+  return token;
+}
+
+void Parser::syntax_error(const Token& token) {
+  const auto msg = token.kind == TokenKind::ERROR
+                       ? fmt::format("token recognition error at: '{}'", display_text(token))
+                       : fmt::format("mismatched input '{}'", display_text(token));
+  errors_.push_back(fmt::format("{}({}:{}) {}", filename_, token.line, token.column, msg));
+  throw SyntaxError();
+}
+
+} // namespace wwivbasic
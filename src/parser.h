@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ast.h"
+#include "lexer.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wwivbasic {
+
+/**
+ * Hand written front end for the language of BasicParser.g4, which parses
+ * source text straight into the AST, with no parse tree in between.
+ *
+ * Statements are parsed by recursive descent and expressions by precedence
+ * climbing, with the precedences and associativity of the expr rule.  The
+ * AST is the one AstBuilder lowers the ANTLR parse tree into, node for node
+ * and line for line, so the compiler can not tell the two apart.  Syntax
+ * errors are reported in the format of BasicParserErrorListener, but
+ * parsing stops at the first one rather than recovering, and text that no
+ * token matches is an error rather than being skipped.
+ */
+class Parser {
+public:
+  Parser(std::string filename, std::string_view text);
+
+  // Parses the whole text, returning null, with errors() set, when it does
+  // not parse.  Throws std::invalid_argument, as AstBuilder does, for a DIM
+  // of an unknown type.
+  std::unique_ptr<ast::Unit> parse();
+  const std::vector<std::string>& errors() const { return errors_; }
+
+private:
+  ast::ProcedureDef procedure();
+  void import_module(ast::Unit& unit);
+  // Statements up to the first token that can not start one.
+  ast::Block statements();
+  std::unique_ptr<ast::Stmt> statement();
+  std::unique_ptr<ast::Stmt> assignment();
+  std::unique_ptr<ast::Stmt> if_statement();
+  std::unique_ptr<ast::Stmt> for_statement();
+  std::unique_ptr<ast::Stmt> dim_statement();
+  std::unique_ptr<ast::CallExpr> call();
+  // An expression of operators binding at least as tightly as precedence,
+  // from 1 (OR) to 5 (multiplicative operators).
+  std::unique_ptr<ast::Expr> expr(int precedence = 1);
+  // Applies the operators after left that bind at least as tightly as
+  // precedence, with left as the first operand.  line is that of left's
+  // first token.
+  std::unique_ptr<ast::Expr> operators(std::unique_ptr<ast::Expr> left, int precedence, int line);
+  std::unique_ptr<ast::Expr> primary();
+  std::unique_ptr<ast::Expr> dictionary();
+
+  const Token& peek(size_t ahead = 0) const;
+  bool at(TokenKind kind) const { return peek().kind == kind; }
+  // Consumes the next token if it is of kind.
+  bool accept(TokenKind kind);
+  // Consumes the next token, which must be of kind.
+  const Token& expect(TokenKind kind);
+  [[noreturn]] void syntax_error(const Token& token);
+
+  std::string filename_;
+  std::vector<Token> tokens_;
+  size_t pos_{0};
+  std::vector<std::string> errors_;
+  // Module of the closest preceding MODULE statement.
+  std::string module_;
+  // The first unknown DIM type, which is only reported when the whole text
+  // parses, as AstBuilder only sees it then.
+  std::string unknown_dim_type_;
+};
+
+} // namespace wwivbasic
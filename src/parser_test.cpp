@@ -0,0 +1,141 @@
+#include "gtest/gtest.h"
+#include "ast_builder.h"
+#include "bytecode.h"
+#include "compiler.h"
+#include "context.h"
+#include "optimizer.h"
+#include "parser.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace wwivbasic;
+
+namespace {
+
+// The AST and the code compiled from it, which shows each instruction's
+// line.
+std::string compiled(const ast::Unit& unit) {
+  return dump(unit) + disassemble(*Compiler().compile(unit));
+}
+
+std::string with_antlr(const std::string& filename, const std::string& text) {
+  SourceUnit su(filename, text);
+  EXPECT_TRUE(su.errors.empty()) << filename << ": " << su.errors.front();
+  return compiled(*AstBuilder().build(filename, su.main()));
+}
+
+std::string with_parser(const std::string& filename, const std::string& text) {
+  Parser parser(filename, text);
+  auto unit = parser.parse();
+  if (!unit) {
+    ADD_FAILURE() << filename << ": " << parser.errors().front();
+    return {};
+  }
+  return compiled(*unit);
+}
+
+std::vector<std::string> errors_of(const std::string& text) {
+  Parser parser("test.bas", text);
+  EXPECT_EQ(parser.parse(), nullptr);
+  return parser.errors();
+}
+
+// Everything in the grammar that bas/ does not use.
+constexpr const char* kGrammar = R"(MODULE "util"
+IMPORT @wwiv.io
+' A comment
+def twice(n)
+  return n * 2
+enddef
+DIM scores[10]
+DIM names[2] as String
+stats = {"calls": 0, 1: "one", "ok": FALSE}
+empty = {}
+scores[1 + 1] = stats["calls"]
+x = (1 + 2) * 3 - 4 / 2 MOD 3
+y = x < 1 OR x >= 2 AND x <> 3 OR (x <= 4) = TRUE
+s = "two
+lines"
+FOR i = 10 TO 1 STEP -2
+  IF i = 4 THEN BREAK
+  ENDIF
+  IF i > 8 THEN
+    print(twice(i))
+  ELSE
+    util.twice(i)
+  ENDIF
+next
+FOR j = x TO 0 STEP -x + 1 MOD 3
+  print(j)
+NEXT
+)";
+
+} // namespace
+
+TEST(ParserTest, MatchesAntlrOnBasFiles) {
+  int files = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(WWIVBASIC_BAS_DIR)) {
+    if (entry.path().extension() != ".bas") {
+      continue;
+    }
+    std::ifstream in(entry.path(), std::ios::binary);
+    const std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    const auto filename = entry.path().filename().string();
+    EXPECT_EQ(with_parser(filename, text), with_antlr(filename, text)) << filename;
+    files++;
+  }
+  EXPECT_GT(files, 0);
+}
+
+TEST(ParserTest, MatchesAntlrOnWholeGrammar) {
+  EXPECT_EQ(with_parser("test.bas", kGrammar), with_antlr("test.bas", kGrammar));
+}
+
+TEST(ParserTest, Precedence) {
+  Parser parser("test.bas", "a = 1 + 2 * 3 - 4\nb = x = 1 OR y AND z\n");
+  const auto unit = parser.parse();
+  ASSERT_NE(unit, nullptr);
+  EXPECT_EQ(dump(*unit), "a = (1 + (2 * 3)) - 4\nb = (x = 1) OR (y AND z)\n");
+}
+
+TEST(ParserTest, NegativeStep) {
+  Parser parser("test.bas", "FOR i = 10 TO 1 STEP -a + b * 2\nNEXT\n"
+                            "FOR i = 1 TO 2 STEP -(a + 1)\nNEXT\n");
+  const auto unit = parser.parse();
+  ASSERT_NE(unit, nullptr);
+  EXPECT_EQ(dump(*unit), "FOR i = 10 TO 1 STEP (0 - a) + (b * 2)\nNEXT\n"
+                         "FOR i = 1 TO 2 STEP 0 - (a + 1)\nNEXT\n");
+}
+
+TEST(ParserTest, SyntaxErrors) {
+  EXPECT_EQ(errors_of("a =\n"), std::vector<std::string>{"test.bas(1:3) mismatched input '\\n'"});
+  EXPECT_EQ(errors_of("print(1)\nIF a THEN\nENDIF"),
+            std::vector<std::string>{"test.bas(3:5) mismatched input '<EOF>'"});
+  EXPECT_EQ(errors_of("s = \"open\n"),
+            std::vector<std::string>{"test.bas(1:4) token recognition error at: '\"open\\n'"});
+  // ELSEIF needs an ELSE.
+  EXPECT_EQ(errors_of("IF a THEN\nELSEIF b THEN\nENDIF\n").size(), 1u);
+  EXPECT_EQ(errors_of("").size(), 1u);
+}
+
+TEST(ParserTest, UnknownDimType) {
+  Parser parser("test.bas", "DIM a[2] AS REAL\n");
+  EXPECT_THROW(parser.parse(), std::invalid_argument);
+}
+
+TEST(ParseSourceTest, ReturnsAstOrErrors) {
+  std::vector<std::string> errors;
+  const auto unit = parse_source("test.bas", "a = 1 + 2\n", errors);
+  ASSERT_NE(unit, nullptr);
+  EXPECT_EQ(dump(*unit), "a = 1 + 2\n");
+  EXPECT_TRUE(errors.empty());
+
+  EXPECT_EQ(parse_source("test.bas", "a =\n", errors), nullptr);
+  EXPECT_FALSE(errors.empty());
+}
@@ -0,0 +1,71 @@
+#include "context.h"
+
+#include <mutex>
+
+namespace wwivbasic {
+
+namespace {
+
+// Every statement, and every alternative of expr in the positions scripts
+// use them, so that parsing this fills in the DFA for each decision.
+constexpr const char* kCorpus = R"(IMPORT @wwiv.io
+IMPORT "util.bas"
+MODULE "warmup"
+' A comment
+total = 0
+name = "sysop"
+flag = TRUE
+other = flag
+DIM scores[10]
+DIM names[2] AS STRING
+stats = {"calls": 0, 1: name, "ok": FALSE}
+empty = {}
+scores[0] = 1
+stats["calls"] = stats["calls"] + 1
+FOR i = 1 to 10
+  total = total + i * 2 - scores[i MOD 10] / 3
+  IF total > 100 AND a = 0 OR i >= 5 THEN
+    BREAK
+  ENDIF
+NEXT
+FOR i = 10 to 1 STEP -1
+  s = s + MID(name, i, 1)
+NEXT
+FOR i = 0 to 20 STEP (2 + 1)
+NEXT
+IF (a + b) * c <> d THEN
+  print("ne")
+ELSE
+  print("eq")
+ENDIF
+IF a < b THEN
+  print(1)
+ELSEIF a <= b THEN
+  print(2)
+ELSEIF a = b THEN
+  print(3)
+ELSE
+  print(4)
+ENDIF
+IF LEN(name) THEN print(name)
+ENDIF
+def add(a, b)
+  return a + b
+enddef
+def nothing()
+  return FALSE
+enddef
+print(add(1, 2), nothing(), wwiv.io.print("x"), "s" + 1)
+warmup.add(total, LEFT(name, 2) + RIGHT(name, 2))
+)";
+
+} // namespace
+
+void warm_up_parser() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    SourceUnit su("<warm up>", kCorpus);
+  });
+}
+
+} // namespace wwivbasic
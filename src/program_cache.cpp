@@ -0,0 +1,512 @@
+#include "program_cache.h"
+#include "compiler.h"
+#include "core/crc32.h"
+#include "core/file.h"
+#include "core/os.h"
+#include "core/textfile.h"
+#include "core/version.h"
+#include "fmt/format.h"
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace wwivbasic {
+
+using namespace wwiv::core;
+
+namespace {
+
+constexpr std::string_view kMagic = "WBBC";
+
+// Appends little endian integers and length prefixed strings to a buffer.
+class Writer {
+public:
+  void u8(uint8_t v) { data.push_back(static_cast<char>(v)); }
+  void u32(uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+      u8(static_cast<uint8_t>(v >> (i * 8)));
+    }
+  }
+  void i32(int32_t v) { u32(static_cast<uint32_t>(v)); }
+  void str(std::string_view s) {
+    u32(static_cast<uint32_t>(s.size()));
+    data.append(s);
+  }
+  void strings(const std::vector<std::string>& v) {
+    u32(static_cast<uint32_t>(v.size()));
+    for (const auto& s : v) {
+      str(s);
+    }
+  }
+
+  std::string data;
+};
+
+// Reads what Writer wrote.  Once a read runs past the end of the data, ok
+// is false and every further read returns zero or empty.
+class Reader {
+public:
+  explicit Reader(std::string_view d) : data_(d) {}
+
+  uint8_t u8() {
+    if (pos_ >= data_.size()) {
+      ok = false;
+      return 0;
+    }
+    return static_cast<uint8_t>(data_[pos_++]);
+  }
+  uint32_t u32() {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+      v |= static_cast<uint32_t>(u8()) << (i * 8);
+    }
+    return v;
+  }
+  int32_t i32() { return static_cast<int32_t>(u32()); }
+  std::string str() {
+    const auto len = u32();
+    if (!ok || len > data_.size() - pos_) {
+      ok = false;
+      return {};
+    }
+    std::string s(data_.substr(pos_, len));
+    pos_ += len;
+    return s;
+  }
+  std::vector<std::string> strings() {
+    std::vector<std::string> v;
+    for (auto count = u32(); ok && count > 0; count--) {
+      v.push_back(str());
+    }
+    return v;
+  }
+  bool at_end() const noexcept { return pos_ == data_.size(); }
+
+  bool ok{true};
+
+private:
+  std::string_view data_;
+  size_t pos_{0};
+};
+
+void write_chunk(Writer& w, const Chunk& chunk) {
+  w.str(chunk.name);
+  w.str(chunk.module);
+  w.strings(chunk.params);
+  w.i32(chunk.num_locals);
+  w.strings(chunk.local_names);
+  w.u32(static_cast<uint32_t>(chunk.code.size()));
+  for (size_t i = 0; i < chunk.code.size(); i++) {
+    const auto& ins = chunk.code[i];
+    w.u8(static_cast<uint8_t>(ins.op));
+    w.i32(ins.a);
+    w.i32(ins.b);
+    w.i32(chunk.lines[i]);
+  }
+  w.u32(static_cast<uint32_t>(chunk.constants.size()));
+  for (const auto& c : chunk.constants) {
+    w.u8(static_cast<uint8_t>(c.type()));
+    switch (c.type()) {
+    case Value::Type::BOOLEAN:
+      w.u8(c.toBool() ? 1 : 0);
+      break;
+    case Value::Type::INTEGER:
+      w.i32(c.toInt());
+      break;
+    case Value::Type::STRING:
+      w.str(c.view());
+      break;
+    case Value::Type::ARRAY:
+    case Value::Type::DICT:
+      // Arrays and dictionaries are only made at runtime, never constants.
+      break;
+    }
+  }
+  w.strings(chunk.names);
+}
+
+bool read_chunk(Reader& r, Chunk& chunk) {
+  chunk.name = r.str();
+  chunk.module = r.str();
+  chunk.params = r.strings();
+  chunk.num_locals = r.i32();
+  chunk.local_names = r.strings();
+  for (auto count = r.u32(); r.ok && count > 0; count--) {
+    const auto op = r.u8();
+    if (op > static_cast<uint8_t>(OpCode::HALT)) {
+      return false;
+    }
+    const auto a = r.i32();
+    const auto b = r.i32();
+    chunk.emit(static_cast<OpCode>(op), a, b, r.i32());
+  }
+  for (auto count = r.u32(); r.ok && count > 0; count--) {
+    switch (static_cast<Value::Type>(r.u8())) {
+    case Value::Type::BOOLEAN:
+      chunk.constants.emplace_back(r.u8() != 0);
+      break;
+    case Value::Type::INTEGER:
+      chunk.constants.emplace_back(r.i32());
+      break;
+    case Value::Type::STRING:
+      chunk.constants.emplace_back(r.str());
+      break;
+    default:
+      return false;
+    }
+  }
+  chunk.names = r.strings();
+  return r.ok;
+}
+
+// True when every operand of every instruction in chunk is in range, so
+// that no instruction of a damaged or hand made entry can take the VM
+// outside its constants, slots, names or code.  valid_stack checks how the
+// instructions fit together.
+bool valid_operands(const Chunk& chunk, bool is_main, int num_globals) {
+  if (chunk.num_locals < static_cast<int>(chunk.params.size())) {
+    return false;
+  }
+  auto in = [](int32_t v, size_t size) { return v >= 0 && static_cast<size_t>(v) < size; };
+  const auto locals = static_cast<size_t>(chunk.num_locals);
+  const auto globals = static_cast<size_t>(num_globals);
+  // The slots FOR loops use in this chunk.
+  const auto loop_slots = is_main ? globals : locals;
+  for (const auto& ins : chunk.code) {
+    bool ok = true;
+    switch (ins.op) {
+    case OpCode::CONST:
+      ok = in(ins.a, chunk.constants.size());
+      break;
+    case OpCode::LOAD_LOCAL:
+    case OpCode::STORE_LOCAL:
+    case OpCode::STORE_ELEMENT_LOCAL:
+      ok = in(ins.a, locals);
+      break;
+    case OpCode::APPEND_LOCAL:
+      ok = in(ins.a, locals) && ins.b >= 0;
+      break;
+    case OpCode::LOAD_GLOBAL:
+    case OpCode::STORE_GLOBAL:
+    case OpCode::STORE_ELEMENT_GLOBAL:
+      ok = in(ins.a, globals);
+      break;
+    case OpCode::APPEND_GLOBAL:
+      ok = in(ins.a, globals) && ins.b >= 0;
+      break;
+    case OpCode::LOAD_NAME:
+    case OpCode::STORE_NAME:
+    case OpCode::STORE_ELEMENT_NAME:
+    case OpCode::IMPORT:
+      ok = in(ins.a, chunk.names.size());
+      break;
+    case OpCode::CALL:
+      ok = in(ins.a, chunk.names.size()) && ins.b >= 0;
+      break;
+    case OpCode::NEW_ARRAY:
+      ok = ins.a == static_cast<int32_t>(Value::Type::BOOLEAN) ||
+           ins.a == static_cast<int32_t>(Value::Type::INTEGER) ||
+           ins.a == static_cast<int32_t>(Value::Type::STRING);
+      break;
+    case OpCode::NEW_DICT:
+      ok = ins.a >= 0;
+      break;
+    case OpCode::JUMP:
+    case OpCode::JUMP_IF_FALSE:
+    case OpCode::JUMP_IF_FALSE_OR_POP:
+    case OpCode::JUMP_IF_TRUE_OR_POP:
+      ok = in(ins.a, chunk.code.size());
+      break;
+    case OpCode::FOR_PREP:
+    case OpCode::FOR_NEXT:
+      // The loop variable, end and step.
+      ok = in(ins.a, chunk.code.size()) && ins.b >= 0 &&
+           static_cast<size_t>(ins.b) + 3 <= loop_slots;
+      break;
+    default:
+      break;
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Values instruction ins pops from the stack, and pushes onto it.
+std::pair<int64_t, int64_t> stack_effect(const Instruction& ins) {
+  switch (ins.op) {
+  case OpCode::CONST:
+  case OpCode::LOAD_LOCAL:
+  case OpCode::LOAD_GLOBAL:
+  case OpCode::LOAD_NAME:
+    return {0, 1};
+  case OpCode::POP:
+  case OpCode::STORE_LOCAL:
+  case OpCode::STORE_GLOBAL:
+  case OpCode::STORE_NAME:
+  case OpCode::JUMP_IF_FALSE:
+  case OpCode::RETURN:
+    return {1, 0};
+  case OpCode::APPEND_LOCAL:
+  case OpCode::APPEND_GLOBAL:
+    return {ins.b, 0};
+  case OpCode::NEW_ARRAY:
+  case OpCode::BOOL:
+    return {1, 1};
+  case OpCode::NEW_DICT:
+    return {2 * static_cast<int64_t>(ins.a), 1};
+  case OpCode::STORE_ELEMENT_LOCAL:
+  case OpCode::STORE_ELEMENT_GLOBAL:
+  case OpCode::STORE_ELEMENT_NAME:
+    return {2, 0};
+  case OpCode::LOAD_ELEMENT:
+  case OpCode::ADD:
+  case OpCode::SUB:
+  case OpCode::MUL:
+  case OpCode::DIV:
+  case OpCode::MOD:
+  case OpCode::EQ:
+  case OpCode::NE:
+  case OpCode::LT:
+  case OpCode::LE:
+  case OpCode::GT:
+  case OpCode::GE:
+    return {2, 1};
+  // Leave the value on the stack when they jump, and pop it otherwise.
+  case OpCode::JUMP_IF_FALSE_OR_POP:
+  case OpCode::JUMP_IF_TRUE_OR_POP:
+    return {1, 1};
+  case OpCode::CALL:
+    return {ins.b, 1};
+  case OpCode::JUMP:
+  case OpCode::FOR_PREP:
+  case OpCode::FOR_NEXT:
+  case OpCode::IMPORT:
+  case OpCode::HALT:
+    return {0, 0};
+  }
+  return {0, 0};
+}
+
+// True when chunk ends in HALT (main) or RETURN (a DEF), and every path
+// through its code reaches each instruction with the same stack depth, no
+// instruction pops more than is on the stack and none runs off the end of
+// the code.  Must be called after valid_operands, so that jump targets are
+// in range.
+bool valid_stack(const Chunk& chunk, bool is_main) {
+  const auto& code = chunk.code;
+  if (code.empty() || code.back().op != (is_main ? OpCode::HALT : OpCode::RETURN)) {
+    return false;
+  }
+  // Stack depth on entry to each instruction, or -1 if not yet reached.
+  std::vector<int64_t> depth(code.size(), -1);
+  std::vector<size_t> todo;
+  // Records that ip is reached with the stack d deep.
+  auto reach = [&](size_t ip, int64_t d) {
+    if (ip >= code.size()) {
+      return false;
+    }
+    if (depth[ip] < 0) {
+      depth[ip] = d;
+      todo.push_back(ip);
+      return true;
+    }
+    return depth[ip] == d;
+  };
+  reach(0, 0);
+  while (!todo.empty()) {
+    const auto ip = todo.back();
+    todo.pop_back();
+    const auto& ins = code[ip];
+    const auto [pops, pushes] = stack_effect(ins);
+    const auto d = depth[ip];
+    if (pops < 0 || pops > d) {
+      return false;
+    }
+    switch (ins.op) {
+    case OpCode::RETURN:
+    case OpCode::HALT:
+      continue;
+    case OpCode::JUMP:
+      if (!reach(ins.a, d)) {
+        return false;
+      }
+      continue;
+    case OpCode::JUMP_IF_FALSE:
+    case OpCode::FOR_PREP:
+    case OpCode::FOR_NEXT:
+      if (!reach(ins.a, d - pops + pushes)) {
+        return false;
+      }
+      break;
+    case OpCode::JUMP_IF_FALSE_OR_POP:
+    case OpCode::JUMP_IF_TRUE_OR_POP:
+      if (!reach(ins.a, d) || !reach(ip + 1, d - 1)) {
+        return false;
+      }
+      continue;
+    default:
+      break;
+    }
+    if (!reach(ip + 1, d - pops + pushes)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Header identifying the source text and interpreter an entry was built for.
+std::string header(const std::string& text) {
+  Writer w;
+  w.data.append(kMagic);
+  w.u32(kProgramFormatVersion);
+  w.str(full_version());
+  w.u32(crc32string(text));
+  w.u32(static_cast<uint32_t>(text.size()));
+  return w.data;
+}
+
+} // namespace
+
+std::string serialize(const Program& program) {
+  Writer w;
+  write_chunk(w, program.main);
+  w.u32(static_cast<uint32_t>(program.functions.size()));
+  for (const auto& fn : program.functions) {
+    write_chunk(w, *fn);
+  }
+  w.strings(program.globals);
+  return w.data;
+}
+
+std::unique_ptr<Program> deserialize(std::string_view data) {
+  Reader r(data);
+  auto program = std::make_unique<Program>();
+  if (!read_chunk(r, program->main)) {
+    return nullptr;
+  }
+  for (auto count = r.u32(); r.ok && count > 0; count--) {
+    auto fn = std::make_unique<Chunk>("");
+    if (!read_chunk(r, *fn)) {
+      return nullptr;
+    }
+    program->functions.push_back(std::move(fn));
+  }
+  program->globals = r.strings();
+  if (!r.ok || !r.at_end()) {
+    return nullptr;
+  }
+  const auto num_globals = static_cast<int>(program->globals.size());
+  if (!valid_operands(program->main, true, num_globals) || !valid_stack(program->main, true)) {
+    return nullptr;
+  }
+  for (const auto& fn : program->functions) {
+    if (!valid_operands(*fn, false, num_globals) || !valid_stack(*fn, false)) {
+      return nullptr;
+    }
+  }
+  program->link();
+  return program;
+}
+
+std::filesystem::path ProgramCache::entry_path(const std::filesystem::path& path) const {
+  const auto key = crc32string(File::absolute(path).string());
+  return dir_ / fmt::format("{:08x}.wbc", key);
+}
+
+std::unique_ptr<Program> ProgramCache::load(const std::filesystem::path& path,
+                                            const std::string& text) const {
+  File f(entry_path(path));
+  if (!f.Open(File::modeBinary | File::modeReadOnly)) {
+    return nullptr;
+  }
+  std::string data(f.length(), '\0');
+  if (f.Read(data.data(), data.size()) != static_cast<File::size_type>(data.size())) {
+    return nullptr;
+  }
+  const auto expected = header(text);
+  if (data.compare(0, expected.size(), expected) != 0) {
+    // Stale: the source, interpreter or format has changed.
+    return nullptr;
+  }
+  // The header is followed by the crc32 of the serialized program.
+  Reader r(std::string_view(data).substr(expected.size(), 4));
+  const auto crc = r.u32();
+  if (!r.ok) {
+    return nullptr;
+  }
+  const auto body = data.substr(expected.size() + 4);
+  if (crc32string(body) != crc) {
+    // Damaged, such as by a partial write or a bad disk.
+    return nullptr;
+  }
+  return deserialize(body);
+}
+
+bool ProgramCache::save(const std::filesystem::path& path, const std::string& text,
+                        const Program& program) const {
+  if (!File::Exists(dir_) && !File::mkdirs(dir_)) {
+    return false;
+  }
+  // Write to a temporary file and rename it over the entry, so that other
+  // processes never see a partially written entry.  The temporary file is
+  // named for this process and save call, so writers of the same entry
+  // never share one.
+  static std::atomic<uint32_t> saves{0};
+  const auto entry = entry_path(path);
+  auto tmp = entry;
+  tmp += fmt::format(".{}.{}.tmp", wwiv::os::get_pid(), saves.fetch_add(1));
+  {
+    File f(tmp);
+    if (!f.Open(File::modeBinary | File::modeCreateFile | File::modeReadWrite |
+                File::modeTruncate)) {
+      return false;
+    }
+    const auto body = serialize(program);
+    Writer w;
+    w.data = header(text);
+    w.u32(crc32string(body));
+    const auto data = w.data + body;
+    if (f.Write(data) != static_cast<File::size_type>(data.size())) {
+      f.Close();
+      File::Remove(tmp);
+      return false;
+    }
+  }
+  if (!File::Rename(tmp, entry)) {
+    File::Remove(tmp);
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<Program> ProgramCache::compile(const std::filesystem::path& path,
+                                               std::vector<std::string>& errors) {
+  TextFile f(path, "rb");
+  if (!f) {
+    errors.push_back(fmt::format("Unable to open file: {}", path.string()));
+    return nullptr;
+  }
+  const auto text = f.ReadFileIntoString();
+  if (auto program = load(path, text)) {
+    hits++;
+    return program;
+  }
+
+  misses++;
+  auto program = compile_source(path.string(), text, errors);
+  if (!program) {
+    return nullptr;
+  }
+  if (!save(path, text, *program)) {
+    std::cout << "Unable to write compiled program cache: " << entry_path(path).string()
+              << std::endl;
+  }
+  return program;
+}
+
+} // namespace wwivbasic
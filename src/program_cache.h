@@ -0,0 +1,63 @@
+#pragma once
+
+#include "bytecode.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wwivbasic {
+
+// Bumped whenever the serialized form of a Program, or the meaning of the
+// bytecode in it, changes.
+constexpr uint32_t kProgramFormatVersion = 7;
+
+// Serializes a compiled program into a portable binary form.
+std::string serialize(const Program& program);
+// Reads a program written by serialize, returning null if data is malformed,
+// has an operand out of range for its chunk, or has a chunk that could pop
+// an empty stack or run past the end of its code.
+std::unique_ptr<Program> deserialize(std::string_view data);
+
+/**
+ * On disk cache of compiled programs, so that a warm start skips lexing and
+ * parsing entirely.
+ *
+ * Each source file has one entry, named for the crc32 of its path.  An entry
+ * is only used when the crc32 and size of the source text, the interpreter
+ * version and kProgramFormatVersion all match what was current when it was
+ * written, and the crc32 stored with the compiled program matches it;
+ * otherwise the source is compiled again and the entry replaced.
+ */
+class ProgramCache {
+public:
+  explicit ProgramCache(std::filesystem::path dir) : dir_(std::move(dir)) {}
+
+  // Returns the compiled program for the source file at path, loading it
+  // from the cache when possible and otherwise compiling it and updating
+  // the cache.  Returns null, adding to errors, if the file can not be read
+  // or fails to parse.
+  std::unique_ptr<Program> compile(const std::filesystem::path& path,
+                                   std::vector<std::string>& errors);
+
+  // Returns the cached program for text, or null if there is no current entry.
+  std::unique_ptr<Program> load(const std::filesystem::path& path, const std::string& text) const;
+  bool save(const std::filesystem::path& path, const std::string& text,
+            const Program& program) const;
+
+  // Path of the cache entry for the source file at path.
+  std::filesystem::path entry_path(const std::filesystem::path& path) const;
+
+  // Number of compile calls satisfied from the cache.
+  int hits{0};
+  // Number of compile calls that needed to parse and compile the source.
+  int misses{0};
+
+private:
+  std::filesystem::path dir_;
+};
+
+} // namespace wwivbasic
@@ -0,0 +1,238 @@
+#include "gtest/gtest.h"
+#include "compiler.h"
+#include "context.h"
+#include "program_cache.h"
+#include "vm.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace wwivbasic;
+
+namespace {
+
+constexpr const char* kScript = R"(def twice(n)
+  return n * 2
+enddef
+s = "a long string constant"
+FOR i = 1 to 3
+  s = s + twice(i)
+NEXT
+print(s)
+print(1 < 2)
+)";
+
+} // namespace
+
+class ProgramCacheTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    const auto* test_info = testing::UnitTest::GetInstance()->current_test_info();
+    dir_ = std::filesystem::temp_directory_path() / "wwivbasic_test" / test_info->name();
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+
+  std::filesystem::path WriteSource(const std::string& text) {
+    const auto path = dir_ / "test.bas";
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+    return path;
+  }
+
+  std::unique_ptr<Program> Compile(const std::string& text) {
+    std::vector<std::string> errors;
+    auto program = compile_source("test.bas", text, errors);
+    EXPECT_TRUE(errors.empty());
+    return program;
+  }
+
+  // Runs program, returning each line written by PRINT.
+  std::vector<std::string> Run(const Program& program) {
+    Context ec;
+    std::vector<std::string> output;
+    ec.root->native_functionl("PRINT", [&output](Args args) -> Value {
+      std::string line;
+      for (const auto& arg : args) {
+        line += arg.toString();
+      }
+      output.push_back(line);
+      return {};
+    });
+    VM vm(ec, program);
+    vm.run();
+    return output;
+  }
+
+  std::filesystem::path dir_;
+};
+
+TEST_F(ProgramCacheTest, SerializeRoundTrip) {
+  const auto program = Compile(kScript);
+  const auto loaded = deserialize(serialize(*program));
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(disassemble(*loaded), disassemble(*program));
+  EXPECT_EQ(Run(*loaded), std::vector<std::string>({"a long string constant246", "TRUE"}));
+}
+
+TEST_F(ProgramCacheTest, DeserializeTruncated) {
+  const auto data = serialize(*Compile(kScript));
+  EXPECT_FALSE(deserialize(data.substr(0, data.size() - 1)));
+  EXPECT_FALSE(deserialize(data + "x"));
+  EXPECT_FALSE(deserialize(""));
+}
+
+TEST_F(ProgramCacheTest, DeserializeOperandOutOfRange) {
+  auto program = Compile(kScript);
+  ASSERT_TRUE(deserialize(serialize(*program)));
+  for (auto& ins : program->main.code) {
+    if (ins.op == OpCode::CONST) {
+      ins.a = static_cast<int32_t>(program->main.constants.size());
+      break;
+    }
+  }
+  EXPECT_FALSE(deserialize(serialize(*program)));
+
+  program = Compile(kScript);
+  for (auto& ins : program->main.code) {
+    if (ins.op == OpCode::FOR_PREP) {
+      ins.b = static_cast<int32_t>(program->globals.size()) - 2;
+    }
+  }
+  EXPECT_FALSE(deserialize(serialize(*program)));
+}
+
+TEST_F(ProgramCacheTest, DeserializeEmptyChunk) {
+  auto program = Compile(kScript);
+  program->functions.front()->code.clear();
+  EXPECT_FALSE(deserialize(serialize(*program)));
+
+  program = Compile(kScript);
+  program->main.code.clear();
+  EXPECT_FALSE(deserialize(serialize(*program)));
+}
+
+TEST_F(ProgramCacheTest, DeserializeFallsOffEnd) {
+  auto program = Compile(kScript);
+  ASSERT_EQ(program->main.code.back().op, OpCode::HALT);
+  program->main.code.pop_back();
+  EXPECT_FALSE(deserialize(serialize(*program)));
+
+  program = Compile(kScript);
+  auto& code = program->functions.front()->code;
+  ASSERT_EQ(code.back().op, OpCode::RETURN);
+  code.back().op = OpCode::POP;
+  EXPECT_FALSE(deserialize(serialize(*program)));
+
+  // A DEF must return to its caller rather than halt.
+  program = Compile(kScript);
+  program->functions.front()->code.back().op = OpCode::HALT;
+  EXPECT_FALSE(deserialize(serialize(*program)));
+}
+
+TEST_F(ProgramCacheTest, DeserializeCallPopsTooMuch) {
+  auto program = Compile(kScript);
+  auto found = false;
+  for (auto& ins : program->main.code) {
+    if (ins.op == OpCode::CALL) {
+      ins.b = 1000;
+      found = true;
+    }
+  }
+  ASSERT_TRUE(found);
+  EXPECT_FALSE(deserialize(serialize(*program)));
+
+  program = Compile(kScript);
+  // One key, value pair when the stack is empty.
+  program->main.code.front() = {OpCode::NEW_DICT, 1};
+  EXPECT_FALSE(deserialize(serialize(*program)));
+}
+
+TEST_F(ProgramCacheTest, CorruptedEntryIsRecompiled) {
+  const auto path = WriteSource(kScript);
+  ProgramCache cache(dir_ / "cache");
+  std::vector<std::string> errors;
+  ASSERT_TRUE(cache.compile(path, errors));
+
+  // Change one byte near the end of the entry, in the compiled program.
+  const auto entry = cache.entry_path(path);
+  {
+    std::fstream f(entry, std::ios::binary | std::ios::in | std::ios::out);
+    f.seekg(-8, std::ios::end);
+    const auto c = static_cast<char>(f.get());
+    f.seekp(-8, std::ios::end);
+    f.put(static_cast<char>(c ^ 0x5a));
+  }
+  std::ifstream in(path, std::ios::binary);
+  const std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  EXPECT_FALSE(cache.load(path, text));
+
+  auto program = cache.compile(path, errors);
+  ASSERT_TRUE(program);
+  EXPECT_EQ(cache.hits, 0);
+  EXPECT_EQ(cache.misses, 2);
+  EXPECT_EQ(Run(*program), std::vector<std::string>({"a long string constant246", "TRUE"}));
+  // The entry was replaced.
+  EXPECT_TRUE(cache.load(path, text));
+}
+
+TEST_F(ProgramCacheTest, WarmStartSkipsParsing) {
+  const auto path = WriteSource(kScript);
+  ProgramCache cache(dir_ / "cache");
+  std::vector<std::string> errors;
+  ASSERT_TRUE(cache.compile(path, errors));
+  EXPECT_EQ(cache.misses, 1);
+
+  auto program = cache.compile(path, errors);
+  ASSERT_TRUE(program);
+  EXPECT_EQ(cache.hits, 1);
+  EXPECT_EQ(cache.misses, 1);
+  EXPECT_TRUE(errors.empty());
+  EXPECT_EQ(Run(*program), std::vector<std::string>({"a long string constant246", "TRUE"}));
+}
+
+TEST_F(ProgramCacheTest, ChangedSourceIsRecompiled) {
+  const auto path = WriteSource(kScript);
+  ProgramCache cache(dir_ / "cache");
+  std::vector<std::string> errors;
+  ASSERT_TRUE(cache.compile(path, errors));
+
+  WriteSource("print(42)\n");
+  auto program = cache.compile(path, errors);
+  ASSERT_TRUE(program);
+  EXPECT_EQ(cache.hits, 0);
+  EXPECT_EQ(cache.misses, 2);
+  EXPECT_EQ(Run(*program), std::vector<std::string>({"42"}));
+}
+
+TEST_F(ProgramCacheTest, ConcurrentSaves) {
+  const auto path = WriteSource(kScript);
+  const auto program = Compile(kScript);
+  ProgramCache cache(dir_ / "cache");
+  std::vector<std::thread> writers;
+  for (int i = 0; i < 8; i++) {
+    writers.emplace_back([&] {
+      for (int j = 0; j < 20; j++) {
+        EXPECT_TRUE(cache.save(path, kScript, *program));
+      }
+    });
+  }
+  for (auto& t : writers) {
+    t.join();
+  }
+  EXPECT_TRUE(cache.load(path, kScript));
+  // Only the entry is left, no temporary files.
+  int files = 0;
+  for (const auto& f : std::filesystem::directory_iterator(dir_ / "cache")) {
+    EXPECT_EQ(f.path(), cache.entry_path(path));
+    files++;
+  }
+  EXPECT_EQ(files, 1);
+}
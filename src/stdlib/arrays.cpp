@@ -0,0 +1,54 @@
+#include "stdlib/arrays.h"
+#include "array.h"
+
+#include <iostream>
+#include <limits>
+
+namespace wwivbasic::stdlib {
+
+static bool is_array(const Value& a) {
+  if (a.is_array()) {
+    return true;
+  }
+  std::cout << "NOT AN ARRAY" << std::endl;
+  return false;
+}
+
+Value sort(const Value& a) {
+  if (!is_array(a)) {
+    return Value(false);
+  }
+  Value result(a);
+  result.mutable_array()->sort();
+  return result;
+}
+
+Value fill(const Value& a, const Value& v) {
+  if (!is_array(a)) {
+    return Value(false);
+  }
+  Value result(a);
+  result.mutable_array()->fill(v);
+  return result;
+}
+
+Value sum(const Value& a) {
+  if (!is_array(a)) {
+    return Value(0);
+  }
+  const auto total = a.array()->sum();
+  if (total < std::numeric_limits<int>::min() || total > std::numeric_limits<int>::max()) {
+    std::cout << "SUM OUT OF RANGE: " << total << std::endl;
+    return Value(0);
+  }
+  return Value(static_cast<int>(total));
+}
+
+Value find(const Value& a, const Value& v) {
+  if (!is_array(a)) {
+    return Value(-1);
+  }
+  return Value(a.array()->find(v));
+}
+
+} // namespace wwivbasic::stdlib
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "value.h"
+
+namespace wwivbasic::stdlib {
+
+// Bulk operations on DIM arrays.  Those that change an array return the
+// changed copy, as in a = SORT(a), and leave their argument alone.
+Value sort(const Value& a);
+Value fill(const Value& a, const Value& v);
+Value sum(const Value& a);
+Value find(const Value& a, const Value& v);
+
+} // namespace wwivbasic::stdlib
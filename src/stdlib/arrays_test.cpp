@@ -0,0 +1,82 @@
+#include "gtest/gtest.h"
+#include "array.h"
+#include "stdlib/arrays.h"
+
+#include <climits>
+
+using namespace wwivbasic;
+using namespace wwivbasic::stdlib;
+
+namespace {
+
+Value make_ints(std::initializer_list<int> values) {
+  auto a = Value::dim(Value::Type::INTEGER, static_cast<int>(values.size()));
+  int i = 0;
+  for (const auto v : values) {
+    a.set_element(i++, Value(v));
+  }
+  return a;
+}
+
+} // namespace
+
+TEST(ArraysTest, Dim) {
+  auto a = Value::dim(Value::Type::STRING, 3);
+  ASSERT_NE(a.array(), nullptr);
+  EXPECT_EQ(a.array()->size(), 3u);
+  EXPECT_EQ(a.element(0).toString(), "");
+  EXPECT_TRUE(a.set_element(1, Value(42)));
+  EXPECT_EQ(a.element(1).toString(), "42");
+  EXPECT_TRUE(a.element(1).is_string());
+  EXPECT_FALSE(a.set_element(3, Value("x")));
+  EXPECT_FALSE(a.element(-1).toBool());
+
+  auto b = Value::dim(Value::Type::BOOLEAN, 2);
+  b.set_element(0, Value("TRUE"));
+  EXPECT_TRUE(b.element(0).is_bool());
+  EXPECT_TRUE(b.element(0).toBool());
+  EXPECT_FALSE(b.element(1).toBool());
+}
+
+TEST(ArraysTest, CopyOnWrite) {
+  auto a = make_ints({1, 2, 3});
+  const auto* storage = a.array();
+  auto b = a;
+  EXPECT_EQ(b.array(), storage);
+  b.set_element(0, Value(10));
+  EXPECT_NE(b.array(), storage);
+  EXPECT_EQ(a.element(0).toInt(), 1);
+  EXPECT_EQ(b.element(0).toInt(), 10);
+  // No longer shared, so stored in place.
+  a.set_element(1, Value(20));
+  EXPECT_EQ(a.array(), storage);
+}
+
+TEST(ArraysTest, SortSumFillFind) {
+  const auto a = make_ints({5, 3, 9, 1});
+  const auto sorted = sort(a);
+  EXPECT_EQ(sorted.element(0).toInt(), 1);
+  EXPECT_EQ(sorted.element(3).toInt(), 9);
+  // The argument is left alone.
+  EXPECT_EQ(a.element(0).toInt(), 5);
+
+  EXPECT_EQ(sum(a).toInt(), 18);
+  EXPECT_EQ(find(a, Value(9)).toInt(), 2);
+  EXPECT_EQ(find(a, Value("3")).toInt(), 1);
+  EXPECT_EQ(find(a, Value(4)).toInt(), -1);
+  EXPECT_EQ(sum(fill(a, Value(7))).toInt(), 28);
+
+  // Totals that do not fit in an INTEGER are reported and give 0.
+  EXPECT_EQ(sum(make_ints({INT_MAX, 1})).toInt(), 0);
+  EXPECT_EQ(sum(make_ints({INT_MIN, -1})).toInt(), 0);
+  EXPECT_EQ(sum(make_ints({INT_MAX, 1, -1})).toInt(), INT_MAX);
+
+  auto names = Value::dim(Value::Type::STRING, 3);
+  names.set_element(0, Value("sysop"));
+  names.set_element(1, Value("alice"));
+  names.set_element(2, Value("bob"));
+  names = sort(names);
+  EXPECT_EQ(names.element(0).toString(), "alice");
+  EXPECT_EQ(names.element(2).toString(), "sysop");
+  EXPECT_EQ(find(names, Value("bob")).toInt(), 1);
+}
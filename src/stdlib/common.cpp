@@ -1,21 +1,30 @@
-#include "stdlib/strings.h"
+#include "stdlib/common.h"
 #include <cstdint>
+#include "array.h"
+#include "dict.h"
 #include "core/stl.h"
 
 namespace wwivbasic::stdlib {
 
-Value val(const std::vector<Value>& v) {
-  if (v.empty()) {
+Value val(Args args) {
+  if (args.empty()) {
     return Value(0);
   }
-  return Value(v.front().toInt());
+  return Value(args.front().toInt());
 }
 
-Value len(const std::vector<Value>& v) {
-  if (v.empty()) {
+Value len(Args args) {
+  if (args.empty()) {
     return Value(0);
   }
-  return Value(wwiv::stl::size_int(v.front().toString()));
+  if (const auto* a = args.front().array()) {
+    return Value(static_cast<int>(a->size()));
+  }
+  if (const auto* d = args.front().dict()) {
+    return Value(static_cast<int>(d->size()));
+  }
+  char buf[16];
+  return Value(wwiv::stl::size_int(args.front().text(buf)));
 }
 
 }
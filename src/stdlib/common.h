@@ -1,12 +1,12 @@
 #pragma once
 
+#include "native.h"
 #include "value.h"
-#include <vector>
 
 namespace wwivbasic::stdlib {
 
-  Value val(const std::vector<Value>& v);
-  Value len(const std::vector<Value>& v);
+  Value val(Args args);
+  Value len(Args args);
 
 
 } // namespace wwivbasic::stdlib
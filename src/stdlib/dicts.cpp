@@ -0,0 +1,48 @@
+#include "stdlib/dicts.h"
+#include "dict.h"
+
+#include <iostream>
+
+namespace wwivbasic::stdlib {
+
+static bool is_dict(const Value& d) {
+  if (d.is_dict()) {
+    return true;
+  }
+  std::cout << "NOT A DICTIONARY" << std::endl;
+  return false;
+}
+
+Value get(Args args) {
+  const auto fallback = args.size() > 2 ? args[2] : Value(false);
+  if (args.size() < 2 || !is_dict(args[0])) {
+    return fallback;
+  }
+  const auto* v = args[0].dict()->find(args[1]);
+  return v ? *v : fallback;
+}
+
+Value set(const Value& d, const Value& key, const Value& v) {
+  if (!is_dict(d)) {
+    return Value(false);
+  }
+  Value result(d);
+  result.mutable_dict()->set(key, v);
+  return result;
+}
+
+Value has(const Value& d, const Value& key) {
+  if (!is_dict(d)) {
+    return Value(false);
+  }
+  return Value(d.dict()->find(key) != nullptr);
+}
+
+Value keys(const Value& d) {
+  if (!is_dict(d)) {
+    return Value::dim(Value::Type::STRING, 0);
+  }
+  return d.dict()->keys();
+}
+
+} // namespace wwivbasic::stdlib
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "native.h"
+#include "value.h"
+
+namespace wwivbasic::stdlib {
+
+// Dictionaries.  d[key] reads and writes entries in place; these are for
+// when a missing key is expected, or a changed copy is wanted.
+
+// GET(d, key[, default]): the value for key, or default (FALSE when not
+// given) when d has no such key.
+Value get(Args args);
+// The changed copy of d with key set to v, as in d = SET(d, key, v).
+Value set(const Value& d, const Value& key, const Value& v);
+Value has(const Value& d, const Value& key);
+// The keys of d in the order they were added, as a STRING array.
+Value keys(const Value& d);
+
+} // namespace wwivbasic::stdlib
@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+#include "array.h"
+#include "dict.h"
+#include "stdlib/dicts.h"
+
+#include <string>
+#include <vector>
+
+using namespace wwivbasic;
+using namespace wwivbasic::stdlib;
+
+TEST(DictsTest, SetAndGet) {
+  auto d = Value::make_dict();
+  ASSERT_NE(d.dict(), nullptr);
+  EXPECT_TRUE(d.set_element(Value("sysop"), Value(1)));
+  EXPECT_TRUE(d.set_element(Value(42), Value("answer")));
+  EXPECT_EQ(d.dict()->size(), 2u);
+  EXPECT_EQ(d.element(Value("sysop")).toInt(), 1);
+  // Keys are compared as text.
+  EXPECT_EQ(d.element(Value("42")).toString(), "answer");
+  EXPECT_FALSE(d.element(Value("missing")).toBool());
+
+  d.set_element(Value("sysop"), Value(2));
+  EXPECT_EQ(d.dict()->size(), 2u);
+  EXPECT_EQ(d.element(Value("sysop")).toInt(), 2);
+}
+
+TEST(DictsTest, CopyOnWrite) {
+  auto a = Value::make_dict();
+  a.set_element(Value("k"), Value(1));
+  const auto* storage = a.dict();
+  auto b = a;
+  EXPECT_EQ(b.dict(), storage);
+  b.set_element(Value("k"), Value(10));
+  EXPECT_NE(b.dict(), storage);
+  EXPECT_EQ(a.element(Value("k")).toInt(), 1);
+  EXPECT_EQ(b.element(Value("k")).toInt(), 10);
+  // No longer shared, so stored in place.
+  a.set_element(Value("j"), Value(2));
+  EXPECT_EQ(a.dict(), storage);
+}
+
+TEST(DictsTest, CopyOnWrite_KeepsEntries) {
+  auto a = Value::make_dict();
+  for (int i = 0; i < 5; i++) {
+    a.set_element(Value("k" + std::to_string(i)), Value(i));
+  }
+  auto b = a;
+  b.set_element(Value("k2"), Value(20));
+  ASSERT_NE(b.dict(), a.dict());
+  EXPECT_EQ(b.dict()->size(), 5u);
+  for (int i = 0; i < 5; i++) {
+    const auto key = Value("k" + std::to_string(i));
+    EXPECT_TRUE(has(b, key).toBool()) << i;
+    const std::vector<Value> args{b, key, Value(-1)};
+    EXPECT_EQ(get(Args(args)).toInt(), i == 2 ? 20 : i);
+  }
+
+  // Grow the copy well past the table it was copied with.
+  for (int i = 5; i < 40; i++) {
+    b.set_element(Value("k" + std::to_string(i)), Value(i));
+  }
+  EXPECT_EQ(b.dict()->size(), 40u);
+  for (int i = 0; i < 40; i++) {
+    EXPECT_EQ(b.element(Value("k" + std::to_string(i))).toInt(), i == 2 ? 20 : i) << i;
+  }
+  EXPECT_EQ(a.dict()->size(), 5u);
+  EXPECT_EQ(a.element(Value("k2")).toInt(), 2);
+
+  // SET on a shared dictionary copies it too.
+  const auto c = set(a, Value("k0"), Value(100));
+  EXPECT_EQ(c.dict()->size(), 5u);
+  EXPECT_EQ(c.element(Value("k4")).toInt(), 4);
+  EXPECT_EQ(c.element(Value("k0")).toInt(), 100);
+  EXPECT_EQ(a.element(Value("k0")).toInt(), 0);
+}
+
+TEST(DictsTest, Builtins) {
+  auto d = Value::make_dict();
+  d = set(d, Value("b"), Value(2));
+  d = set(d, Value("a"), Value(1));
+  const auto copy = set(d, Value("c"), Value(3));
+  // The argument is left alone.
+  EXPECT_FALSE(has(d, Value("c")).toBool());
+  EXPECT_TRUE(has(copy, Value("c")).toBool());
+
+  const std::vector<Value> args{d, Value("z"), Value(-1)};
+  EXPECT_EQ(get(Args(args)).toInt(), -1);
+  EXPECT_EQ(get(Args(args.data(), 2)).toBool(), false);
+  const std::vector<Value> found{d, Value("a")};
+  EXPECT_EQ(get(Args(found)).toInt(), 1);
+
+  // Keys are in insertion order.
+  const auto k = keys(copy);
+  ASSERT_NE(k.array(), nullptr);
+  ASSERT_EQ(k.array()->size(), 3u);
+  EXPECT_EQ(k.element(0).toString(), "b");
+  EXPECT_EQ(k.element(1).toString(), "a");
+  EXPECT_EQ(k.element(2).toString(), "c");
+}
+
+TEST(DictsTest, ManyKeys) {
+  auto d = Value::make_dict();
+  for (int i = 0; i < 20000; i++) {
+    d.set_element(Value("user" + std::to_string(i)), Value(i));
+  }
+  EXPECT_EQ(d.dict()->size(), 20000u);
+  EXPECT_EQ(d.element(Value("user12345")).toInt(), 12345);
+  EXPECT_EQ(keys(d).element(19999).toString(), "user19999");
+}
@@ -3,7 +3,7 @@
 
 namespace wwivbasic::stdlib {
 
-int asc(std::string s) {
+int asc(std::string_view s) {
   return s.empty() ? 0 : static_cast<int>(static_cast<uint8_t>(s.front()));
 }
 
@@ -14,41 +14,39 @@ std::string chr(int c) {
   return std::string(1, static_cast<int>(c & 0xff));
 }
 
-std::string left(std::string s, int len) {
-  if (len >= s.size()) {
-    return s;
-  }
-  return s.substr(0, len);
+// LEFT, RIGHT and MID return substrings (Value::substr), so long results
+// share the storage of their argument rather than copying it.
+Value left(const Value& s, int len) {
+  return s.substr(0, static_cast<size_t>(len));
 }
 
-std::string right(std::string s, int len) {
-  if (len >= s.size()) {
-    return s;
+Value right(const Value& s, int len) {
+  char buf[16];
+  const auto size = s.text(buf).size();
+  if (static_cast<size_t>(len) >= size) {
+    return s.substr(0);
   }
-  return s.substr(s.size() - len);
+  return s.substr(size - len);
 }
 
-Value mid(std::vector<Value> args) {
+Value mid(Args args) {
   // string, start, [len]
   if (args.size() < 1) {
     return {};
   }
-  const auto s = args.at(0).toString();
+  const auto& s = args[0];
   if (args.size() < 2) {
-    return Value(s);
+    return s.substr(0);
   }
-  if (args.size() == 2) {
-    if (const auto start = args.at(1).toInt(); start < s.size()) {
-      return Value(s.substr(start));
-    }
-    return Value(s);
+  char buf[16];
+  const auto start = static_cast<size_t>(args[1].toInt());
+  if (start >= s.text(buf).size()) {
+    return s.substr(0);
   }
-  const auto start = args.at(1).toInt();
-  if (start < s.size()) {
-    const int len = args.at(2).toInt();
-    return Value(s.substr(start, len));
+  if (args.size() == 2) {
+    return s.substr(start);
   }
-  return Value(s);
+  return s.substr(start, static_cast<size_t>(args[2].toInt()));
 }
 
 
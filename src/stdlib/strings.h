@@ -1,15 +1,19 @@
 #pragma once
 
+#include "native.h"
 #include "value.h"
 
+#include <string>
+#include <string_view>
+
 namespace wwivbasic::stdlib {
 
-int asc(std::string s);
+int asc(std::string_view s);
 std::string chr(int c);
 
-std::string left(std::string s, int len);
-std::string right(std::string s, int len);
-Value mid(std::vector<Value> args);
+Value left(const Value& s, int len);
+Value right(const Value& s, int len);
+Value mid(Args args);
 
 
 } // namespace wwivbasic::stdlib
@@ -13,4 +13,35 @@ TEST(StringsTest, CHR) {
   ASSERT_STREQ("A", chr(65).c_str());
   ASSERT_STREQ("\xFE", chr(254).c_str());
   ASSERT_STREQ("", chr(999).c_str());
-}
\ No newline at end of file
+}
+TEST(StringsTest, LEFT) {
+  const wwivbasic::Value s("Hello");
+  EXPECT_EQ("He", left(s, 2).toString());
+  EXPECT_EQ("Hello", left(s, 10).toString());
+  EXPECT_EQ("12", left(wwivbasic::Value(12345), 2).toString());
+}
+
+TEST(StringsTest, RIGHT) {
+  const wwivbasic::Value s("Hello");
+  EXPECT_EQ("lo", right(s, 2).toString());
+  EXPECT_EQ("Hello", right(s, 10).toString());
+}
+
+TEST(StringsTest, MID) {
+  const std::vector<wwivbasic::Value> args{wwivbasic::Value("Hello"), wwivbasic::Value(1),
+                                           wwivbasic::Value(3)};
+  EXPECT_EQ("ell", mid(args).toString());
+  EXPECT_EQ("ello", mid(wwivbasic::Args(args.data(), 2)).toString());
+  EXPECT_EQ("Hello", mid(wwivbasic::Args(args.data(), 1)).toString());
+}
+
+TEST(StringsTest, LongSubstringsShareStorage) {
+  const std::vector<wwivbasic::Value> args{
+      wwivbasic::Value("0123456789abcdefghijklmnopqrstuvwxyz"), wwivbasic::Value(10),
+      wwivbasic::Value(20)};
+  const auto s = args[0].view();
+  EXPECT_EQ(mid(args).view().data(), s.data() + 10);
+  EXPECT_EQ(left(args[0], 20).view().data(), s.data());
+  EXPECT_EQ(right(args[0], 20).view().data(), s.data() + 16);
+  EXPECT_EQ("abcdefghijklmnopqrst", mid(args).toString());
+}
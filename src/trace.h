@@ -0,0 +1,28 @@
+#pragma once
+
+#include "core/log.h"
+
+namespace wwivbasic {
+
+// Verbosity levels (--v=N) for interpreter traces.
+constexpr int TRACE_CALLS = 1;       // procedure calls, returns and imports
+constexpr int TRACE_ASSIGNMENTS = 2; // variable assignments
+constexpr int TRACE_EXPRESSIONS = 3; // expression results and variable lookups
+
+} // namespace wwivbasic
+
+// Writes an interpreter trace through VLOG.  Unlike VLOG, nothing after the
+// macro is evaluated unless the verbosity level is enabled, so a disabled
+// trace costs a single comparison.  Build with WWIVBASIC_DISABLE_TRACE
+// defined to compile traces out entirely.
+#ifdef WWIVBASIC_DISABLE_TRACE
+#define BASIC_TRACE(level)                                                                         \
+  if (true) {                                                                                      \
+  } else                                                                                           \
+    wwiv::core::NullLogger()
+#else
+#define BASIC_TRACE(level)                                                                         \
+  if (!VLOG_IS_ON(level)) {                                                                        \
+  } else                                                                                           \
+    VLOG(level)
+#endif
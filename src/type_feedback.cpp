@@ -0,0 +1,26 @@
+#include "type_feedback.h"
+
+namespace wwivbasic {
+
+Value apply_generic(ast::BinaryOp op, const Value& left, const Value& right) {
+  switch (op) {
+  case ast::BinaryOp::ADD: return left + right;
+  case ast::BinaryOp::SUB: return left - right;
+  case ast::BinaryOp::MUL: return left * right;
+  case ast::BinaryOp::DIV: return left / right;
+  case ast::BinaryOp::MOD: return left % right;
+  case ast::BinaryOp::EQ: return Value(left == right);
+  case ast::BinaryOp::NE: return Value(left != right);
+  case ast::BinaryOp::LT: return Value(left < right);
+  case ast::BinaryOp::LE: return Value(left == right || left < right);
+  case ast::BinaryOp::GT: return Value(left > right);
+  case ast::BinaryOp::GE: return Value(left == right || left > right);
+  case ast::BinaryOp::AND:
+  case ast::BinaryOp::OR:
+    // Short circuit, so never applied to two values.
+    break;
+  }
+  return Value(false);
+}
+
+} // namespace wwivbasic
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "ast.h"
+#include "value.h"
+
+#include <cstdint>
+
+namespace wwivbasic {
+
+// Applies op with Value's generic operators, whatever the operand types.
+// op may not be AND or OR, which short circuit.
+Value apply_generic(ast::BinaryOp op, const Value& left, const Value& right);
+
+/**
+ * Operand types seen by one arithmetic or comparison operator.
+ *
+ * While every evaluation at a site has seen the same pair of types (both
+ * integers, both strings or both booleans), the operator is applied
+ * directly to the unboxed operands rather than through Value's operators,
+ * which switch on the left type and convert the right operand.  Once a site
+ * sees a different pair it stays on the generic path.  Either way the
+ * result is the same as Value's operators give.
+ */
+class TypeFeedback {
+public:
+  enum class Shape : uint8_t { NONE, INTEGER, STRING, BOOLEAN, MIXED };
+
+  Shape shape() const noexcept { return shape_; }
+
+  // Evaluates left op right, recording the operand types.  op may not be
+  // AND or OR.
+  Value apply(ast::BinaryOp op, const Value& left, const Value& right) {
+    switch (observe(left, right)) {
+    case Shape::INTEGER:
+      return apply_int(op, left.int_value(), right.int_value());
+    case Shape::STRING:
+      return apply_string(op, left, right);
+    case Shape::BOOLEAN:
+      return apply_bool(op, left.bool_value(), right.bool_value());
+    default:
+      return apply_generic(op, left, right);
+    }
+  }
+
+private:
+  static Shape shape_of(const Value& left, const Value& right) noexcept {
+    if (left.is_int()) {
+      return right.is_int() ? Shape::INTEGER : Shape::MIXED;
+    }
+    if (left.is_string()) {
+      return right.is_string() ? Shape::STRING : Shape::MIXED;
+    }
+    if (left.is_bool()) {
+      return right.is_bool() ? Shape::BOOLEAN : Shape::MIXED;
+    }
+    return Shape::MIXED;
+  }
+
+  // Records the operands' shape, returning it if this site has only seen
+  // that shape, or MIXED when the generic path must be used.
+  Shape observe(const Value& left, const Value& right) noexcept {
+    if (shape_ == Shape::MIXED) {
+      return Shape::MIXED;
+    }
+    const auto s = shape_of(left, right);
+    if (s == shape_) {
+      return s;
+    }
+    shape_ = shape_ == Shape::NONE ? s : Shape::MIXED;
+    return shape_;
+  }
+
+  static Value apply_int(ast::BinaryOp op, int left, int right) {
+    switch (op) {
+    case ast::BinaryOp::ADD: return Value(left + right);
+    case ast::BinaryOp::SUB: return Value(left - right);
+    case ast::BinaryOp::MUL: return Value(left * right);
+    case ast::BinaryOp::DIV: return Value(left / right);
+    case ast::BinaryOp::MOD: return Value(left % right);
+    case ast::BinaryOp::EQ: return Value(left == right);
+    case ast::BinaryOp::NE: return Value(left != right);
+    case ast::BinaryOp::LT: return Value(left < right);
+    case ast::BinaryOp::LE: return Value(left <= right);
+    case ast::BinaryOp::GT: return Value(left > right);
+    case ast::BinaryOp::GE: return Value(left >= right);
+    default: return Value(false);
+    }
+  }
+
+  // Arithmetic on strings concatenates, which the generic path does as well
+  // as anything could.
+  static Value apply_string(ast::BinaryOp op, const Value& left, const Value& right) {
+    switch (op) {
+    case ast::BinaryOp::EQ: return Value(left.view() == right.view());
+    case ast::BinaryOp::NE: return Value(left.view() != right.view());
+    case ast::BinaryOp::LT: return Value(left.view() < right.view());
+    case ast::BinaryOp::LE: return Value(left.view() <= right.view());
+    case ast::BinaryOp::GT: return Value(left.view() > right.view());
+    case ast::BinaryOp::GE: return Value(left.view() >= right.view());
+    default: return apply_generic(op, left, right);
+    }
+  }
+
+  static Value apply_bool(ast::BinaryOp op, bool left, bool right) {
+    switch (op) {
+    case ast::BinaryOp::ADD: return Value(left || right);
+    case ast::BinaryOp::SUB: return Value(!(left && right));
+    case ast::BinaryOp::MUL: return Value(left * right);
+    case ast::BinaryOp::EQ: return Value(left == right);
+    case ast::BinaryOp::NE: return Value(left != right);
+    case ast::BinaryOp::LT: return Value(left < right);
+    case ast::BinaryOp::LE: return Value(left <= right);
+    case ast::BinaryOp::GT: return Value(left > right);
+    case ast::BinaryOp::GE: return Value(left >= right);
+    default: return Value(false);
+    }
+  }
+
+  Shape shape_{Shape::NONE};
+};
+
+} // namespace wwivbasic
@@ -0,0 +1,57 @@
+#include "gtest/gtest.h"
+#include "type_feedback.h"
+#include "value.h"
+
+#include <vector>
+
+using namespace wwivbasic;
+
+using ast::BinaryOp;
+using Shape = TypeFeedback::Shape;
+
+TEST(TypeFeedbackTest, SpecializesOnIntegers) {
+  TypeFeedback f;
+  EXPECT_EQ(f.shape(), Shape::NONE);
+  EXPECT_EQ(f.apply(BinaryOp::ADD, Value(2), Value(3)).toInt(), 5);
+  EXPECT_EQ(f.shape(), Shape::INTEGER);
+  EXPECT_EQ(f.apply(BinaryOp::ADD, Value(-2), Value(3)).toInt(), 1);
+  EXPECT_EQ(f.shape(), Shape::INTEGER);
+}
+
+TEST(TypeFeedbackTest, FallsBackWhenTypesChange) {
+  TypeFeedback f;
+  EXPECT_TRUE(f.apply(BinaryOp::LT, Value(1), Value(2)).toBool());
+  EXPECT_EQ(f.shape(), Shape::INTEGER);
+  // A string on the right is converted, as Value's operators do.
+  EXPECT_TRUE(f.apply(BinaryOp::LT, Value(1), Value("2")).toBool());
+  EXPECT_EQ(f.shape(), Shape::MIXED);
+  // Stays generic even once the types are stable again.
+  EXPECT_FALSE(f.apply(BinaryOp::LT, Value(2), Value(1)).toBool());
+  EXPECT_EQ(f.shape(), Shape::MIXED);
+}
+
+TEST(TypeFeedbackTest, MatchesGenericOperators) {
+  const std::vector<Value> values = {Value(0),     Value(7),     Value(-3),   Value(true),
+                                     Value(false), Value("abc"), Value("12"), Value("abd")};
+  const std::vector<BinaryOp> ops = {BinaryOp::ADD, BinaryOp::SUB, BinaryOp::MUL, BinaryOp::DIV,
+                                     BinaryOp::MOD, BinaryOp::EQ,  BinaryOp::NE,  BinaryOp::LT,
+                                     BinaryOp::LE,  BinaryOp::GT,  BinaryOp::GE};
+  for (const auto op : ops) {
+    for (const auto& left : values) {
+      for (const auto& right : values) {
+        if ((op == BinaryOp::DIV || op == BinaryOp::MOD) && left.is_int() &&
+            right.toInt() == 0) {
+          continue;
+        }
+        // Twice, so that the second evaluation takes the specialized path.
+        TypeFeedback f;
+        f.apply(op, left, right);
+        const auto result = f.apply(op, left, right);
+        const auto expected = apply_generic(op, left, right);
+        const auto where = fmt::format("{} op {} {}", left, static_cast<int>(op), right);
+        EXPECT_EQ(result.type(), expected.type()) << where;
+        EXPECT_EQ(result.toString(), expected.toString()) << where;
+      }
+    }
+  }
+}
@@ -1,231 +1,496 @@
 #include "value.h"
-#include "core/textfile.h"
-#include "core/stl.h"
-#include "executor.h"
-#include "utils.h"
+#include "array.h"
+#include "dict.h"
 #include "fmt/format.h"
 
+#include <algorithm>
 #include <any>
+#include <cctype>
+#include <charconv>
 #include <iostream>
-#include <map>
-#include <stack>
+#include <limits>
+#include <new>
 #include <string>
 #include <vector>
 
-using namespace wwiv::stl;
-
 namespace wwivbasic {
 
-Value::Value(const std::any& a) {
+StringRep* StringRep::allocate(size_t size, size_t capacity) {
+  if (size > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("String too long");
+  }
+  capacity = std::min<size_t>(std::max(size, capacity), std::numeric_limits<uint32_t>::max());
+  auto* mem = ::operator new(sizeof(StringRep) + capacity);
+  return new (mem) StringRep(static_cast<uint32_t>(size), static_cast<uint32_t>(capacity));
+}
+
+StringRep* StringRep::make(std::string_view s) {
+  auto* rep = allocate(s.size(), s.size());
+  std::memcpy(rep->data(), s.data(), s.size());
+  return rep;
+}
+
+StringRep* StringRep::make(std::string_view a, std::string_view b) {
+  return make(a, b, a.size() + b.size());
+}
+
+StringRep* StringRep::make(std::string_view a, std::string_view b, size_t capacity) {
+  auto* rep = allocate(a.size() + b.size(), capacity);
+  std::memcpy(rep->data(), a.data(), a.size());
+  std::memcpy(rep->data() + a.size(), b.data(), b.size());
+  return rep;
+}
+
+void StringRep::unref() noexcept {
+  if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    this->~StringRep();
+    ::operator delete(this);
+  }
+}
+
+void Value::assign(std::string_view s) {
+  if (s.size() <= kSmallSize) {
+    small_ = Small{Tag::SMALL_STRING, static_cast<uint8_t>(s.size()), {}};
+    std::memcpy(small_.data, s.data(), s.size());
+    return;
+  }
+  heap_ = Heap{Tag::HEAP_STRING, StringRep::make(s)};
+}
+
+Value Value::concat(std::string_view a, std::string_view b) {
+  Value v;
+  if (a.size() + b.size() <= kSmallSize) {
+    v.small_.size = static_cast<uint8_t>(a.size() + b.size());
+    std::memcpy(v.small_.data, a.data(), a.size());
+    std::memcpy(v.small_.data + a.size(), b.data(), b.size());
+    return v;
+  }
+  v.heap_ = Heap{Tag::HEAP_STRING, StringRep::make(a, b)};
+  return v;
+}
+
+Value& Value::append(const Value& that) {
+  if (!is_string()) {
+    return *this = *this + that;
+  }
+  // that may be this value, so tail may view this value's characters.
+  // They are never overwritten before being copied.
+  char buf[16];
+  const auto tail = that.text(buf);
+  const auto head = view();
+  const auto size = head.size() + tail.size();
+  if (size <= kSmallSize) {
+    // Only inline strings are this short.
+    std::memcpy(small_.data + small_.size, tail.data(), tail.size());
+    small_.size = static_cast<uint8_t>(size);
+    return *this;
+  }
+  if (is_heap() && heap_.rep->unique() && size <= heap_.rep->capacity) {
+    std::memcpy(heap_.rep->data() + head.size(), tail.data(), tail.size());
+    heap_.rep->size = static_cast<uint32_t>(size);
+    return *this;
+  }
+  auto* rep = StringRep::make(head, tail, std::max(size, head.size() * 2));
+  release();
+  heap_ = Heap{Tag::HEAP_STRING, rep};
+  return *this;
+}
+
+Value Value::substr(size_t pos, size_t len) const {
+  char buf[16];
+  const auto whole = text(buf);
+  const auto s = whole.substr(pos, len);
+  if (s.size() <= kSmallSize || !has_rep()) {
+    return Value(s);
+  }
+  if (s.size() == whole.size()) {
+    return *this;
+  }
+  auto* rep = heap_.rep;
+  const auto offset = static_cast<size_t>(s.data() - rep->data());
+  if (offset > kMaxSliceOffset) {
+    return Value(s);
+  }
+  rep->ref();
+  Value v;
+  v.slice_ = Slice{Tag::SLICE_STRING, static_cast<uint8_t>(offset >> 16),
+                   static_cast<uint16_t>(offset & 0xffff), static_cast<uint32_t>(s.size()), rep};
+  return v;
+}
+
+Value Value::dim(Type type, int size) {
+  if (size < 0) {
+    std::cout << "DIM size must not be negative: " << size << std::endl;
+    size = 0;
+  }
+  Value v;
+  v.array_ = ArrayCell{Tag::ARRAY, new Array(type, static_cast<size_t>(size))};
+  return v;
+}
+
+Array* Value::mutable_array() {
+  if (!is_array()) {
+    return nullptr;
+  }
+  if (!array_.rep->unique()) {
+    auto* copy = new Array(*array_.rep);
+    array_.rep->unref();
+    array_.rep = copy;
+  }
+  return array_.rep;
+}
+
+Value Value::element(int i) const {
+  const auto* a = array();
+  if (!a) {
+    std::cout << "NOT AN ARRAY" << std::endl;
+    return Value(false);
+  }
+  if (!a->in_range(i)) {
+    std::cout << "ARRAY INDEX OUT OF RANGE: " << i << " (SIZE " << a->size() << ")" << std::endl;
+    return Value(false);
+  }
+  return a->get(static_cast<size_t>(i));
+}
+
+bool Value::set_element(int i, const Value& v) {
+  if (!is_array()) {
+    std::cout << "NOT AN ARRAY" << std::endl;
+    return false;
+  }
+  if (!array_.rep->in_range(i)) {
+    std::cout << "ARRAY INDEX OUT OF RANGE: " << i << " (SIZE " << array_.rep->size() << ")"
+              << std::endl;
+    return false;
+  }
+  mutable_array()->set(static_cast<size_t>(i), v);
+  return true;
+}
+
+Value Value::make_dict() {
+  Value v;
+  v.dict_ = DictCell{Tag::DICT, new Dict()};
+  return v;
+}
+
+Dict* Value::mutable_dict() {
+  if (!is_dict()) {
+    return nullptr;
+  }
+  if (!dict_.rep->unique()) {
+    auto* copy = new Dict(*dict_.rep);
+    dict_.rep->unref();
+    dict_.rep = copy;
+  }
+  return dict_.rep;
+}
+
+Value Value::element(const Value& key) const {
+  if (!is_dict()) {
+    return element(key.toInt());
+  }
+  if (const auto* v = dict_.rep->find(key)) {
+    return *v;
+  }
+  std::cout << "KEY NOT FOUND: " << key << std::endl;
+  return Value(false);
+}
+
+bool Value::set_element(const Value& key, const Value& v) {
+  if (!is_dict()) {
+    return set_element(key.toInt(), v);
+  }
+  mutable_dict()->set(key, v);
+  return true;
+}
+
+void Value::ref_container() const noexcept {
+  if (is_array()) {
+    array_.rep->ref();
+  } else {
+    dict_.rep->ref();
+  }
+}
+
+void Value::unref_container() noexcept {
+  if (is_array()) {
+    array_.rep->unref();
+  } else {
+    dict_.rep->unref();
+  }
+}
+
+void Value::assign_any(const std::any& a) {
   if (!a.has_value()) {
-    debug = "WTF";
     return;
   }
   if (a.type() == typeid(bool)) {
-    type = Type::BOOLEAN;
-    value_ = std::any_cast<bool>(a);
-    debug = fmt::format("{}", std::get<bool>(value_));
+    scalar_ = Scalar{Tag::BOOLEAN, std::any_cast<bool>(a), 0};
   } else if (a.type() == typeid(int)) {
-    type = Type::INTEGER;
-    value_ = std::any_cast<int>(a);
-    debug = fmt::format("{}", std::get<int>(value_));
+    scalar_ = Scalar{Tag::INTEGER, false, std::any_cast<int>(a)};
   } else if (a.type() == typeid(std::string)) {
-    type = Type::STRING;
-    value_ = std::any_cast<std::string>(a);
-    debug = fmt::format("{}", std::get<std::string>(value_));
+    assign(std::any_cast<const std::string&>(a));
+  } else if (a.type() == typeid(Value)) {
+    *this = std::any_cast<const Value&>(a);
   } else {
-    type = Type::STRING;
-    debug = fmt::format("WTF! {}", a.type().name());
-    value_ = std::any_cast<std::string>(a);
+    assign(std::any_cast<std::string>(a));
+  }
+}
+
+std::string_view Value::text(char (&buf)[16]) const noexcept {
+  switch (tag()) {
+  case Tag::BOOLEAN:
+    return scalar_.b ? "TRUE" : "FALSE";
+  case Tag::INTEGER: {
+    const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), scalar_.i);
+    return std::string_view(buf, end - buf);
+  }
+  case Tag::ARRAY:
+  case Tag::DICT:
+    return {};
+  default:
+    return view();
   }
 }
 
 bool Value::toBool() const {
-  switch (type) {
-  case Type::BOOLEAN: {
-    return std::get<bool>(value_);
-  } break;
-  case Type::INTEGER: {
-    const auto i = std::get<int>(value_);
-    return i != 0;
-  } break;
-  case Type::STRING: {
-    const auto& s = std::get<std::string>(value_);
-    return s == "TRUE";
-  } break;
+  switch (tag()) {
+  case Tag::BOOLEAN:
+    return scalar_.b;
+  case Tag::INTEGER:
+    return scalar_.i != 0;
+  case Tag::ARRAY:
+  case Tag::DICT:
+    return false;
+  default:
+    return view() == "TRUE";
+  }
+}
+
+// Parses like std::stoi: leading whitespace and a sign are allowed, and
+// anything after the digits is ignored.  Returns 0 when there is no number.
+static int parse_int(std::string_view s) {
+  size_t i = 0;
+  while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) {
+    i++;
+  }
+  if (i < s.size() && s[i] == '+') {
+    i++;
   }
-  return false;
+  int result = 0;
+  if (const auto [p, ec] = std::from_chars(s.data() + i, s.data() + s.size(), result);
+      ec != std::errc()) {
+    return 0;
+  }
+  return result;
 }
 
 int Value::toInt() const {
-  switch (type) {
-  case Type::BOOLEAN: {
-    const auto b = std::get<bool>(value_);
-    return b ? 1 : 0;
-  } break;
-  case Type::INTEGER: {
-    return std::get<int>(value_);
-  } break;
-  case Type::STRING: {
-    const auto s = std::get<std::string>(value_);
-    try {
-      return std::stoi(s);
-    } catch (const std::exception&) {
-      return 0;
-    }
-  } break;
+  switch (tag()) {
+  case Tag::BOOLEAN:
+    return scalar_.b ? 1 : 0;
+  case Tag::INTEGER:
+    return scalar_.i;
+  case Tag::ARRAY:
+  case Tag::DICT:
+    return 0;
+  default:
+    return parse_int(view());
   }
-  return 0;
 }
 
 std::string Value::toString() const {
-  switch (type) {
-  case Type::BOOLEAN: {
-    const auto b = std::get<bool>(value_);
-    return b ? "TRUE" : "FALSE";
-  } break;
-  case Type::INTEGER: {
-    return std::to_string(std::get<int>(value_));
-  } break;
-  case Type::STRING: {
-    return std::get<std::string>(value_);
-  } break;
-  }
-  return {};
+  char buf[16];
+  return std::string(text(buf));
 }
 
 std::any Value::toAny() const { 
-  switch (type) {
-  case Type::BOOLEAN: return std::make_any<bool>(std::get<bool>(value_));
-  case Type::INTEGER: return std::make_any<int>(std::get<int>(value_));
-  case Type::STRING:return std::make_any<std::string>(std::get<std::string>(value_));
+  switch (type()) {
+  case Type::BOOLEAN: return std::make_any<bool>(scalar_.b);
+  case Type::INTEGER: return std::make_any<int>(scalar_.i);
+  case Type::STRING: return std::make_any<std::string>(view());
+  // Arrays and dictionaries are passed through std::any as Values, sharing
+  // their elements.
+  case Type::ARRAY:
+  case Type::DICT: return std::make_any<Value>(*this);
   }
   return {};
 }
 
 Value Value::operator+(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return Value(toBool() || that.toBool());
   case Type::INTEGER:
-    return Value(toInt() + that.toInt());
-  case Type::STRING:
-    return Value(fmt::format("{}{}", toString(), that));
+    return Value(scalar_.i + that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return concat(view(), that.text(buf));
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return Value(false);
 }
 
 Value Value::operator-(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return Value(!(toBool() && that.toBool()));
   case Type::INTEGER:
-    return Value(toInt() - that.toInt());
-  case Type::STRING:
-    return Value(fmt::format("{}{}", toString(), that));
+    return Value(scalar_.i - that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return concat(view(), that.text(buf));
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return Value(false);
 }
 
 Value Value::operator*(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return Value(toBool() * that.toBool());
   case Type::INTEGER:
-    return Value(toInt() * that.toInt());
-  case Type::STRING:
-    return Value(fmt::format("{}{}", toString(), that)); // ????!
+    return Value(scalar_.i * that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return concat(view(), that.text(buf)); // ????!
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return Value(false);
 }
 
 Value Value::operator/(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return Value(false); // TODO WARN
   case Type::INTEGER:
-    return Value(toInt() / that.toInt());
-  case Type::STRING:
-    return Value(fmt::format("{}{}", toString(), that));
+    return Value(scalar_.i / that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return concat(view(), that.text(buf));
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return Value(false);
 }
 
 Value Value::operator%(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return Value(false); // TODO WARN
   case Type::INTEGER:
-    return Value(toInt() % that.toInt());
-  case Type::STRING:
-    return Value(fmt::format("{}{}", toString(), that));
+    return Value(scalar_.i % that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return concat(view(), that.text(buf));
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return Value(false);
 }
 
 bool Value::operator<(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return (toBool() < that.toBool());
   case Type::INTEGER:
-    return (toInt() < that.toInt());
-  case Type::STRING:
-    return (toString() < that.toString());
+    return (scalar_.i < that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return view() < that.text(buf);
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return (false);
 }
 
 bool Value::operator>(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return (toBool() > that.toBool());
   case Type::INTEGER:
-    return (toInt() > that.toInt());
-  case Type::STRING:
-    return (toString() > that.toString());
+    return (scalar_.i > that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return view() > that.text(buf);
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return (false);
 }
 
 bool Value::operator==(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return (toBool() == that.toBool());
   case Type::INTEGER:
-    return (toInt() == that.toInt());
-  case Type::STRING:
-    return (toString() == that.toString());
+    return (scalar_.i == that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return view() == that.text(buf);
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return (false);
 }
 
 Value Value::operator||(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return Value(toBool() || that.toBool());
   case Type::INTEGER:
-    return Value(toInt() || that.toInt());
-  case Type::STRING:
-    return Value(fmt::format("{}{}", toString(), that)); // Is this right
+    return Value(scalar_.i || that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return concat(view(), that.text(buf)); // Is this right
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return Value(false);
 }
 
 Value Value::operator&&(const Value& that) const {
-  switch (type) {
+  switch (type()) {
   case Type::BOOLEAN:
     return Value(toBool() && that.toBool());
   case Type::INTEGER:
-    return Value(toInt() && that.toInt());
-  case Type::STRING:
-    return Value(fmt::format("{}{}", toString(), that)); // Is this right
+    return Value(scalar_.i && that.toInt());
+  case Type::STRING: {
+    char buf[16];
+    return concat(view(), that.text(buf)); // Is this right
+  }
+  case Type::ARRAY:
+  case Type::DICT:
+    break;
   }
   return Value(false);
 }
 
 std::ostream& operator<<(std::ostream& os, const Value& v) {
-  os << v.toString();
+  char buf[16];
+  os << v.text(buf);
   return os;
 }
 
-} // namespace wwivbasic
\ No newline at end of file
+} // namespace wwivbasic
@@ -1,57 +1,210 @@
 #pragma once
 
-#include "BasicLexer.h"
-#include "BasicParser.h"
-#include "core/stl.h"
 #include "fmt/format.h"
 
 #include <any>
-#include <deque>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iosfwd>
-#include <filesystem>
-#include <functional>
-#include <map>
-#include <memory>
 #include <string>
+#include <string_view>
 #include <type_traits>
-#include <variant>
 #include <vector>
 
 namespace wwivbasic {
 
+class Array;
+class Dict;
+
+// Reference counted, immutable once shared, heap storage for strings that
+// are too long to be stored inline in a Value.  A rep may have room after
+// its characters, so that a Value holding the only reference to it can
+// append in place.
+class StringRep {
+public:
+  static StringRep* make(std::string_view s);
+  static StringRep* make(std::string_view a, std::string_view b);
+  // Makes a rep holding a then b, with room for at least capacity bytes.
+  static StringRep* make(std::string_view a, std::string_view b, size_t capacity);
+
+  char* data() noexcept { return reinterpret_cast<char*>(this + 1); }
+  const char* data() const noexcept { return reinterpret_cast<const char*>(this + 1); }
+  std::string_view view() const noexcept { return {data(), size}; }
+
+  void ref() noexcept { refs.fetch_add(1, std::memory_order_relaxed); }
+  void unref() noexcept;
+  // True when the caller holds the only reference, so may modify this rep.
+  bool unique() const noexcept { return refs.load(std::memory_order_acquire) == 1; }
+
+  std::atomic<int32_t> refs{1};
+  uint32_t size{0};
+  uint32_t capacity{0};
+
+private:
+  StringRep(uint32_t s, uint32_t c) : size(s), capacity(c) {}
+  static StringRep* allocate(size_t size, size_t capacity);
+};
+
+/**
+ * A BASIC value.
+ *
+ * Values are 16 byte tagged cells: booleans and integers are stored
+ * unboxed, strings of up to 14 bytes are stored inline, and longer strings
+ * share a reference counted StringRep.  A long substring of a long string
+ * (see substr) is a slice of the same StringRep, so taking one neither
+ * allocates nor copies.  DIM arrays share a reference counted Array, and
+ * dictionaries a reference counted Dict.  None
+ * of the arithmetic or comparison operators on integers allocate.
+ */
 class Value {
 public:
-  enum class Type { BOOLEAN, INTEGER, STRING };
+  enum class Type { BOOLEAN, INTEGER, STRING, ARRAY, DICT };
 
-  Value() : value_(std::string()), type(Type::STRING) { debug = ""; }
-  explicit Value(bool b) : value_(b), type(Type::BOOLEAN) { debug = fmt::format("{}", b); }
-  explicit Value(int i) : value_(i), type(Type::INTEGER) { debug = fmt::format("{}", i); }
-  explicit Value(const std::string& s) : value_(s), type(Type::STRING) { debug = s; }
-  explicit Value(const char* s) : value_(std::string(s)), type(Type::STRING) { debug = s; }
-  explicit Value(const std::any& a);
+  Value() noexcept { small_ = Small{Tag::SMALL_STRING, 0, {}}; }
+  explicit Value(bool b) noexcept { scalar_ = Scalar{Tag::BOOLEAN, b, 0}; }
+  explicit Value(int i) noexcept { scalar_ = Scalar{Tag::INTEGER, false, i}; }
+  explicit Value(std::string_view s) { assign(s); }
+  explicit Value(const std::string& s) : Value(std::string_view(s)) {}
+  explicit Value(const char* s) : Value(std::string_view(s)) {}
+  // Only accepts std::any itself; a plain std::any parameter would make
+  // std::is_copy_constructible<Value> recursive.
+  template <typename T, typename = std::enable_if_t<std::is_same_v<T, std::any>>>
+  explicit Value(const T& a) : Value() {
+    assign_any(a);
+  }
+
+  Value(const Value& that) noexcept {
+    copy_cell(that);
+    if (counted()) {
+      ref();
+    }
+  }
+  Value(Value&& that) noexcept {
+    copy_cell(that);
+    that.small_ = Small{Tag::SMALL_STRING, 0, {}};
+  }
+  Value& operator=(const Value& that) noexcept {
+    if (this != &that) {
+      if (that.counted()) {
+        that.ref();
+      }
+      release();
+      copy_cell(that);
+    }
+    return *this;
+  }
+  Value& operator=(Value&& that) noexcept {
+    if (this != &that) {
+      release();
+      copy_cell(that);
+      that.small_ = Small{Tag::SMALL_STRING, 0, {}};
+    }
+    return *this;
+  }
+  ~Value() { release(); }
 
   int set(int i) {
-    value_ = i;
-    type = Type::INTEGER;
-    debug = fmt::format("{}", i);
+    release();
+    scalar_ = Scalar{Tag::INTEGER, false, i};
     return i;
   }
 
   std::string set(std::string_view sv) {
-    auto s = std::string(sv);
-    value_ = s;
-    type = Type::STRING;
-    debug = fmt::format("{}", s);
-    return s;
+    release();
+    assign(sv);
+    return std::string(sv);
   }
 
+  // Sets this value to *this + that.  When this is a string that no other
+  // value shares, that is appended in place, and the storage grows
+  // geometrically, so building a string by repeated appends takes
+  // amortized constant time per append rather than copying the string
+  // each time.
+  Value& append(const Value& that);
+
+  // The characters of this value's text from pos, up to len of them, as
+  // std::string_view::substr, which pos must be valid for.  A substring
+  // too long to store inline shares this value's StringRep, which then
+  // stays alive as long as the substring does.
+  Value substr(size_t pos, size_t len = std::string_view::npos) const;
+
+  // Makes a DIM array of size elements of type, each 0, "" or FALSE.
+  static Value dim(Type type, int size);
+  // The array this value holds, or null when it is not an array.
+  const Array* array() const noexcept { return is_array() ? array_.rep : nullptr; }
+  // As array(), but first copies the array when another value shares it,
+  // so that it may be modified.
+  Array* mutable_array();
+  // Element i of an array.  Prints an error and returns FALSE when this is
+  // not an array or i is out of range.
+  Value element(int i) const;
+  // Sets element i of an array to v, converted to the array's type.  Prints
+  // an error and returns false when this is not an array or i is out of
+  // range.
+  bool set_element(int i, const Value& v);
+
+  // Makes an empty dictionary.
+  static Value make_dict();
+  // The dictionary this value holds, or null when it is not a dictionary.
+  const Dict* dict() const noexcept { return is_dict() ? dict_.rep : nullptr; }
+  // As dict(), but first copies the dictionary when another value shares
+  // it, so that it may be modified.
+  Dict* mutable_dict();
+
+  // The value for key in a dictionary, or element key of an array.  Prints
+  // an error and returns FALSE when there is no such key or element.
+  Value element(const Value& key) const;
+  // Sets the value for key in a dictionary, or element key of an array.
+  // Prints an error and returns false when this is neither, or key is out
+  // of range of an array.
+  bool set_element(const Value& key, const Value& v);
+
+  Type type() const noexcept {
+    switch (tag()) {
+    case Tag::BOOLEAN: return Type::BOOLEAN;
+    case Tag::INTEGER: return Type::INTEGER;
+    case Tag::ARRAY: return Type::ARRAY;
+    case Tag::DICT: return Type::DICT;
+    default: return Type::STRING;
+    }
+  }
+  bool is_bool() const noexcept { return tag() == Tag::BOOLEAN; }
+  bool is_int() const noexcept { return tag() == Tag::INTEGER; }
+  bool is_string() const noexcept {
+    return tag() >= Tag::SMALL_STRING && tag() <= Tag::SLICE_STRING;
+  }
+  bool is_array() const noexcept { return tag() == Tag::ARRAY; }
+  bool is_dict() const noexcept { return tag() == Tag::DICT; }
+
   bool toBool() const;
   int toInt() const;
   std::string toString() const;
   std::any toAny() const;
+  // The boolean or integer held by this value, without conversion.  Only
+  // valid when is_bool() or is_int() respectively.
+  bool bool_value() const noexcept { return scalar_.b; }
+  int int_value() const noexcept { return scalar_.i; }
+  // Views the characters of a string value.  Only valid for strings, and
+  // only for as long as this value is alive and unmodified.
+  std::string_view view() const noexcept {
+    switch (tag()) {
+    case Tag::HEAP_STRING: return heap_.rep->view();
+    case Tag::SLICE_STRING: return {slice_.rep->data() + slice_.offset(), slice_.size};
+    default: return {small_.data, small_.size};
+    }
+  }
 
-  template <typename T> 
-  T get() const { return std::get<T>(value_); }
+  template <typename T> T get() const {
+    if constexpr (std::is_same_v<T, bool>) {
+      return toBool();
+    } else if constexpr (std::is_same_v<T, int>) {
+      return toInt();
+    } else {
+      return T(toString());
+    }
+  }
 
   // operators
   Value operator+(const Value& that) const;
@@ -68,13 +221,98 @@ public:
   bool operator==(const Value& that) const;
   bool operator!=(const Value& that) const { return !(*this == that); }
 
+  // Renders this value as text without allocating, using buf for numbers.
+  // Arrays and dictionaries have no text.
+  std::string_view text(char (&buf)[16]) const noexcept;
+
 private:
-  std::variant<bool, int, std::string> value_;
-  Type type;
-  std::string debug;
+  static constexpr uint8_t kSmallSize = 14;
+  // Slices can only start this far into their StringRep.
+  static constexpr size_t kMaxSliceOffset = (1u << 24) - 1;
+  enum class Tag : uint8_t { BOOLEAN, INTEGER, SMALL_STRING, HEAP_STRING, SLICE_STRING, ARRAY, DICT };
+
+  // All members of the union start with the tag, so it may be read through
+  // any of them.
+  struct Small {
+    Tag tag;
+    uint8_t size;
+    char data[kSmallSize];
+  };
+  struct Scalar {
+    Tag tag;
+    bool b;
+    int32_t i;
+  };
+  struct Heap {
+    Tag tag;
+    StringRep* rep;
+  };
+  // size characters of rep starting at offset, which is split to fit the
+  // cell.
+  struct Slice {
+    Tag tag;
+    uint8_t offset_high;
+    uint16_t offset_low;
+    uint32_t size;
+    StringRep* rep;
+
+    size_t offset() const noexcept { return (size_t{offset_high} << 16) | offset_low; }
+  };
+  static_assert(offsetof(Slice, rep) == offsetof(Heap, rep), "has_rep reads rep through heap_");
+  struct ArrayCell {
+    Tag tag;
+    Array* rep;
+  };
+  struct DictCell {
+    Tag tag;
+    Dict* rep;
+  };
+
+  Tag tag() const noexcept { return small_.tag; }
+  void copy_cell(const Value& that) noexcept {
+    std::memcpy(static_cast<void*>(this), static_cast<const void*>(&that), sizeof(Value));
+  }
+  bool is_heap() const noexcept { return tag() == Tag::HEAP_STRING; }
+  // Heap strings and slices hold a reference to their StringRep, which may
+  // be read through heap_ for either.
+  bool has_rep() const noexcept { return is_heap() || tag() == Tag::SLICE_STRING; }
+  // Whether this value holds a reference, to a StringRep, an Array or a
+  // Dict.
+  bool counted() const noexcept { return tag() >= Tag::HEAP_STRING; }
+  void ref() const noexcept {
+    if (has_rep()) {
+      heap_.rep->ref();
+    } else {
+      ref_container();
+    }
+  }
+  // ref() and release() for arrays and dictionaries, which are out of line
+  // since Array and Dict are incomplete here.
+  void ref_container() const noexcept;
+  void unref_container() noexcept;
+  void assign(std::string_view s);
+  void assign_any(const std::any& a);
+  void release() noexcept {
+    if (has_rep()) {
+      heap_.rep->unref();
+    } else if (counted()) {
+      unref_container();
+    }
+  }
+  static Value concat(std::string_view a, std::string_view b);
 
+  union {
+    Small small_;
+    Scalar scalar_;
+    Heap heap_;
+    Slice slice_;
+    ArrayCell array_;
+    DictCell dict_;
+  };
 };
 
+static_assert(sizeof(Value) == 16, "Value should be a 16 byte cell");
+
 std::ostream& operator<<(std::ostream& os, const Value& v);
 
 
@@ -85,6 +323,7 @@ public:
   constexpr auto parse(fmt::format_parse_context& ctx) { return ctx.begin(); }
   template <typename Context>
   constexpr auto format(wwivbasic::Value const& v, Context& ctx) const {
-    return format_to(ctx.out(), "{}", v.toString());
+    char buf[16];
+    return format_to(ctx.out(), "{}", v.text(buf));
   }
 };
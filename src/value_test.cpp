@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+#include "value.h"
+
+#include <string>
+
+using namespace wwivbasic;
+
+TEST(ValueTest, Size) {
+  EXPECT_EQ(sizeof(Value), 16u);
+}
+
+TEST(ValueTest, SmallAndLongStrings) {
+  const std::string small(14, 'a');
+  const std::string long_str(15, 'b');
+  Value s(small);
+  Value l(long_str);
+  EXPECT_EQ(s.toString(), small);
+  EXPECT_EQ(l.toString(), long_str);
+
+  Value copy(l);
+  EXPECT_EQ(copy.view(), l.view());
+  EXPECT_EQ(copy.view().data(), l.view().data());
+
+  Value moved(std::move(copy));
+  EXPECT_EQ(moved.toString(), long_str);
+  EXPECT_TRUE(copy.toString().empty());
+
+  l.set(12);
+  EXPECT_EQ(moved.toString(), long_str);
+}
+
+TEST(ValueTest, Concat) {
+  Value a("hello ");
+  EXPECT_EQ((a + Value("world")).toString(), "hello world");
+  EXPECT_EQ((a + Value(42)).toString(), "hello 42");
+  EXPECT_EQ((a + Value(true)).toString(), "hello TRUE");
+  EXPECT_EQ((a + Value("this is a longer string")).toString(), "hello this is a longer string");
+}
+
+TEST(ValueTest, Append) {
+  Value s("small");
+  s.append(Value(" string"));
+  EXPECT_EQ(s.toString(), "small string");
+  s.append(Value(" now long")).append(Value(1));
+  EXPECT_EQ(s.toString(), "small string now long1");
+
+  // The only reference is appended to in place.
+  s.append(Value("x"));
+  const auto* data = s.view().data();
+  s.append(Value("y"));
+  EXPECT_EQ(s.view().data(), data);
+  EXPECT_EQ(s.toString(), "small string now long1xy");
+
+  // A shared string is not modified.
+  const Value copy(s);
+  s.append(s);
+  EXPECT_EQ(copy.toString(), "small string now long1xy");
+  EXPECT_EQ(s.toString(), "small string now long1xysmall string now long1xy");
+
+  Value n(2);
+  n.append(Value(3));
+  EXPECT_EQ(n.toInt(), 5);
+}
+
+TEST(ValueTest, Substr) {
+  Value s("a string that is stored on the heap");
+  const auto data = s.view().data();
+
+  // Short substrings are stored inline; long ones share s's storage.
+  EXPECT_EQ(s.substr(2, 6).toString(), "string");
+  const auto tail = s.substr(2);
+  EXPECT_EQ(tail.view().data(), data + 2);
+  const auto middle = tail.substr(4, 20);
+  EXPECT_EQ(middle.view().data(), data + 6);
+  EXPECT_EQ(middle.toString(), "ng that is stored on");
+  EXPECT_EQ(s.substr(0).view().data(), data);
+  EXPECT_EQ(Value(12345).substr(1, 2).toString(), "23");
+
+  // The storage outlives s, and is copied rather than modified by appends.
+  s.set(1);
+  auto copy = middle;
+  copy.append(Value("!"));
+  EXPECT_EQ(middle.toString(), "ng that is stored on");
+  EXPECT_EQ(copy.toString(), "ng that is stored on!");
+  EXPECT_TRUE(middle == Value("ng that is stored on"));
+}
+
+TEST(ValueTest, ToInt) {
+  EXPECT_EQ(Value("123").toInt(), 123);
+  EXPECT_EQ(Value("  -45").toInt(), -45);
+  EXPECT_EQ(Value("+7 apples").toInt(), 7);
+  EXPECT_EQ(Value("apples").toInt(), 0);
+  EXPECT_EQ(Value(true).toInt(), 1);
+}
+
+TEST(ValueTest, Compare) {
+  EXPECT_TRUE(Value(3) < Value(4));
+  EXPECT_TRUE(Value("10") == Value(10));
+  EXPECT_TRUE(Value("abc") < Value("abd"));
+  EXPECT_TRUE(Value(5) == Value("5"));
+  EXPECT_EQ(fmt::format("{}", Value(-12)), "-12");
+}
@@ -0,0 +1,291 @@
+#include "vm.h"
+#include "dict.h"
+#include "core/stl.h"
+#include "fmt/format.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace wwivbasic {
+
+using namespace wwiv::stl;
+
+VM::VM(Context& ec, const Program& program)
+    : ec_(ec), program_(program), globals_(program.globals.size()) {
+  stack_.reserve(256);
+  auto add_chunk = [this](const Chunk& chunk) {
+    call_sites_.emplace_back(chunk.names.size());
+    feedback_.emplace_back(chunk.code.size());
+    auto& names = names_.emplace_back();
+    for (const auto& name : chunk.names) {
+      names.emplace_back(name);
+    }
+  };
+  add_chunk(program.main);
+  for (const auto& fn : program.functions) {
+    add_chunk(*fn);
+  }
+}
+
+Value VM::run() {
+  // When starting, reset the module to the root.
+  ec_.module = ec_.root;
+  frames_.clear();
+  return execute(program_.main);
+}
+
+std::optional<Value> VM::global(const std::string& name) const {
+  if (const auto index = program_.global_index(name); index >= 0) {
+    return globals_.at(index);
+  }
+  return std::nullopt;
+}
+
+// The arguments are the top argc values of the stack.  For a DEF they
+// become the first slots of its frame.  DEFs of the program were resolved
+// when it was linked; anything else must be a native function.
+const Chunk* VM::call(const Chunk& chunk, int name, int argc) {
+  const auto base = stack_.size() - argc;
+  const auto& function_name = chunk.names[name];
+  const auto fail = [&] {
+    stack_.resize(base);
+    stack_.emplace_back(false);
+    return nullptr;
+  };
+  if (const auto* callee = chunk.callees[name]) {
+    if (argc != wwiv::stl::size_int(callee->params)) {
+      std::cout << "Wrong number of parameter to function: " << function_name << std::endl;
+      std::cout << "have: " << argc << std::endl;
+      std::cout << "want: " << callee->params.size() << std::endl;
+      return fail();
+    }
+    if (frames_.size() >= ec_.max_call_depth) {
+      std::cout << "CALL DEPTH LIMIT REACHED: " << function_name << " (LIMIT "
+                << ec_.max_call_depth << ")" << std::endl;
+      return fail();
+    }
+    stack_.resize(base + callee->num_locals);
+    return callee;
+  }
+
+  auto& site = call_sites_[chunk.index][name];
+  auto* fn = site.get(ec_.module, ec_.generation);
+  if (!fn) {
+    fn = ec_.resolve(site, names_[chunk.index][name]);
+  }
+  if (!fn) {
+    std::cout << "Unknown function: " << function_name << std::endl;
+    return fail();
+  }
+  if (fn->type != BasicFunction::Type::NATIVE) {
+    std::cout << "Function not compiled: " << function_name << std::endl;
+    return fail();
+  }
+  // Native functions see their arguments in place on the stack.
+  auto result = fn->cpp_fn(Args(stack_.data() + base, argc));
+  stack_.resize(base);
+  stack_.push_back(std::move(result));
+  return nullptr;
+}
+
+Value VM::execute(const Chunk& main) {
+  const Chunk* chunk = &main;
+  size_t base = stack_.size();
+  const Instruction* code;
+  const Name* names;
+  TypeFeedback* feedback;
+  // Points the dispatch loop at the code of chunk.
+  const auto enter = [&] {
+    code = chunk->code.data();
+    names = names_[chunk->index].data();
+    feedback = feedback_[chunk->index].data();
+  };
+  enter();
+  for (int ip = 0;;) {
+    const auto& ins = code[ip++];
+    switch (ins.op) {
+    case OpCode::CONST:
+      stack_.push_back(chunk->constants[ins.a]);
+      break;
+    case OpCode::POP:
+      stack_.pop_back();
+      break;
+    case OpCode::LOAD_LOCAL:
+      stack_.push_back(stack_[base + ins.a]);
+      break;
+    case OpCode::STORE_LOCAL:
+      stack_[base + ins.a] = pop();
+      break;
+    case OpCode::LOAD_GLOBAL:
+      stack_.push_back(globals_[ins.a]);
+      break;
+    case OpCode::STORE_GLOBAL:
+      globals_[ins.a] = pop();
+      break;
+    case OpCode::LOAD_NAME:
+      if (auto* v = ec_.var(names[ins.a])) {
+        stack_.push_back(v->value());
+      } else {
+        stack_.emplace_back();
+      }
+      break;
+    case OpCode::STORE_NAME:
+      ec_.upsert(names[ins.a], pop());
+      break;
+    case OpCode::APPEND_LOCAL:
+      append(stack_[base + ins.a], ins.b);
+      break;
+    case OpCode::APPEND_GLOBAL:
+      append(globals_[ins.a], ins.b);
+      break;
+    case OpCode::NEW_ARRAY:
+      stack_.back() = Value::dim(static_cast<Value::Type>(ins.a), stack_.back().toInt());
+      break;
+    case OpCode::NEW_DICT: {
+      const auto first = stack_.size() - 2 * static_cast<size_t>(ins.a);
+      auto d = Value::make_dict();
+      auto* dict = d.mutable_dict();
+      for (auto i = first; i < stack_.size(); i += 2) {
+        dict->set(stack_[i], stack_[i + 1]);
+      }
+      stack_.resize(first);
+      stack_.push_back(std::move(d));
+    } break;
+    case OpCode::LOAD_ELEMENT: {
+      const auto n = stack_.size();
+      stack_[n - 2] = stack_[n - 2].element(stack_[n - 1]);
+      stack_.pop_back();
+    } break;
+    case OpCode::STORE_ELEMENT_LOCAL:
+      store_element(&stack_[base + ins.a]);
+      break;
+    case OpCode::STORE_ELEMENT_GLOBAL:
+      store_element(&globals_[ins.a]);
+      break;
+    case OpCode::STORE_ELEMENT_NAME: {
+      auto* var = ec_.var(names[ins.a]);
+      store_element(var ? &var->value() : nullptr);
+    } break;
+    // Each operator instruction keeps its own TypeFeedback, so that it can
+    // specialize on the operand types it sees.
+    case OpCode::ADD:
+      binary(ast::BinaryOp::ADD, feedback[ip - 1]);
+      break;
+    case OpCode::SUB:
+      binary(ast::BinaryOp::SUB, feedback[ip - 1]);
+      break;
+    case OpCode::MUL:
+      binary(ast::BinaryOp::MUL, feedback[ip - 1]);
+      break;
+    case OpCode::DIV:
+      binary(ast::BinaryOp::DIV, feedback[ip - 1]);
+      break;
+    case OpCode::MOD:
+      binary(ast::BinaryOp::MOD, feedback[ip - 1]);
+      break;
+    case OpCode::BOOL:
+      stack_.back() = Value(stack_.back().toBool());
+      break;
+    case OpCode::EQ:
+      binary(ast::BinaryOp::EQ, feedback[ip - 1]);
+      break;
+    case OpCode::NE:
+      binary(ast::BinaryOp::NE, feedback[ip - 1]);
+      break;
+    case OpCode::LT:
+      binary(ast::BinaryOp::LT, feedback[ip - 1]);
+      break;
+    case OpCode::LE:
+      binary(ast::BinaryOp::LE, feedback[ip - 1]);
+      break;
+    case OpCode::GT:
+      binary(ast::BinaryOp::GT, feedback[ip - 1]);
+      break;
+    case OpCode::GE:
+      binary(ast::BinaryOp::GE, feedback[ip - 1]);
+      break;
+    case OpCode::JUMP:
+      ip = ins.a;
+      break;
+    case OpCode::FOR_PREP: {
+      auto* loop = slots(*chunk, base) + ins.b;
+      for (int i = 0; i < 3; i++) {
+        if (!loop[i].is_int()) {
+          loop[i].set(loop[i].toInt());
+        }
+      }
+      if (loop[2].int_value() == 0) {
+        std::cout << "FOR STEP must not be 0" << std::endl;
+        ip = ins.a;
+      } else if (!for_in_range(loop[0].int_value(), loop)) {
+        ip = ins.a;
+      }
+    } break;
+    case OpCode::FOR_NEXT: {
+      auto* loop = slots(*chunk, base) + ins.b;
+      // The body may have assigned anything to the loop variable.
+      const auto& var = loop[0];
+      const auto next =
+          static_cast<int64_t>(var.is_int() ? var.int_value() : var.toInt()) + loop[2].int_value();
+      if (for_in_range(next, loop)) {
+        loop[0].set(static_cast<int>(next));
+        ip = ins.a;
+      }
+    } break;
+    case OpCode::JUMP_IF_FALSE:
+      if (!pop().toBool()) {
+        ip = ins.a;
+      }
+      break;
+    case OpCode::JUMP_IF_FALSE_OR_POP:
+      if (!stack_.back().toBool()) {
+        stack_.back() = Value(false);
+        ip = ins.a;
+      } else {
+        stack_.pop_back();
+      }
+      break;
+    case OpCode::JUMP_IF_TRUE_OR_POP:
+      if (stack_.back().toBool()) {
+        stack_.back() = Value(true);
+        ip = ins.a;
+      } else {
+        stack_.pop_back();
+      }
+      break;
+    case OpCode::CALL:
+      if (const auto* callee = call(*chunk, ins.a, ins.b)) {
+        frames_.push_back(Frame{chunk, base, ip});
+        chunk = callee;
+        base = stack_.size() - callee->num_locals;
+        enter();
+        ip = 0;
+      }
+      break;
+    case OpCode::RETURN: {
+      auto result = pop();
+      stack_.resize(base);
+      if (frames_.empty()) {
+        return result;
+      }
+      // Carries on in the caller with the result pushed.
+      const auto& caller = frames_.back();
+      chunk = caller.chunk;
+      base = caller.base;
+      ip = caller.ip;
+      frames_.pop_back();
+      enter();
+      stack_.push_back(std::move(result));
+    } break;
+    case OpCode::IMPORT:
+      ec_.module->imported_modules.insert(Atom(chunk->names[ins.a]));
+      break;
+    case OpCode::HALT:
+      stack_.resize(base);
+      return {};
+    }
+  }
+}
+
+} // namespace wwivbasic
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "bytecode.h"
+#include "context.h"
+#include "type_feedback.h"
+#include "value.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wwivbasic {
+
+/**
+ * Stack based interpreter for a compiled Program.
+ *
+ * Global variables live in a slot array indexed by the compiler's global
+ * slots.  Each call to a DEF gets a frame on the value stack: its
+ * arguments followed by the rest of its local slots.  Calls between DEFs
+ * do not recurse on the native stack: the caller's chunk, frame and
+ * return address are pushed onto a stack of Frames, and the same dispatch
+ * loop carries on in the callee.  So how deeply scripts may recurse is
+ * only bounded by Context::max_call_depth, and each level costs a Frame
+ * plus the callee's slots.
+ *
+ * A VM and its Context hold all of the state of one execution.  The
+ * program is only read, so many VMs may run the same program at once.
+ */
+class VM {
+public:
+  VM(Context& ec, const Program& program);
+
+  // Executes the main body of the program.
+  Value run();
+
+  // Gets the value of a global variable by name, for debugging and for
+  // the host to read results.
+  std::optional<Value> global(const std::string& name) const;
+
+private:
+  // Where to carry on in a caller once the DEF it called returns.
+  struct Frame {
+    const Chunk* chunk;
+    // Stack slot of the caller's frame.
+    size_t base;
+    // The instruction after the CALL.
+    int ip;
+  };
+
+  // Executes chunk, which must be the main chunk, and every DEF it calls,
+  // until it halts.
+  Value execute(const Chunk& chunk);
+  // Calls the function chunk.names[name] with the top argc values of the
+  // stack as arguments.  Returns a compiled DEF for the caller to enter,
+  // with its arguments left as the start of its frame.  Anything else is
+  // called here, or fails with an error, and the arguments are replaced by
+  // the result.
+  const Chunk* call(const Chunk& chunk, int name, int argc);
+  Value pop() {
+    auto v = std::move(stack_.back());
+    stack_.pop_back();
+    return v;
+  }
+  // The global slots for the main chunk, or the frame at base for a DEF.
+  Value* slots(const Chunk& chunk, size_t base) {
+    return &chunk == &program_.main ? globals_.data() : stack_.data() + base;
+  }
+  // Whether a FOR loop whose end and step are in loop[1] and loop[2]
+  // continues with its variable at var.  Wider than int, so stepping past
+  // the largest or smallest int ends the loop rather than overflowing.
+  static bool for_in_range(int64_t var, const Value* loop) noexcept {
+    return loop[2].int_value() > 0 ? var <= loop[1].int_value() : var >= loop[1].int_value();
+  }
+  // Replaces the top two values of the stack, left then right, with
+  // left op right.
+  void binary(ast::BinaryOp op, TypeFeedback& feedback) {
+    const auto n = stack_.size();
+    stack_[n - 2] = feedback.apply(op, stack_[n - 2], stack_[n - 1]);
+    stack_.pop_back();
+  }
+
+  // Appends the top count values of the stack, in order, to var and pops
+  // them.  var may be a slot on the stack below them.
+  void append(Value& var, int count) {
+    const auto first = stack_.size() - count;
+    for (auto i = first; i < stack_.size(); i++) {
+      var.append(stack_[i]);
+    }
+    stack_.resize(first);
+  }
+
+  // Pops a value and then an index or key, and stores the value into that
+  // element of the array or dictionary in var, when there is one.
+  void store_element(Value* var) {
+    const auto n = stack_.size();
+    if (var) {
+      var->set_element(stack_[n - 2], stack_[n - 1]);
+    }
+    stack_.resize(n - 2);
+  }
+
+  Context& ec_;
+  const Program& program_;
+  // Inline caches for the calls of each chunk to functions outside the
+  // program, indexed by Chunk::index and then by name.  Kept here rather
+  // than in the Chunk since the program is shared.
+  std::vector<std::vector<CallSite>> call_sites_;
+  // Chunk::names of each chunk interned, indexed the same way.
+  std::vector<std::vector<Name>> names_;
+  // Operand types seen by each instruction of each chunk, indexed the same
+  // way and then by instruction.
+  std::vector<std::vector<TypeFeedback>> feedback_;
+  std::vector<Value> globals_;
+  std::vector<Value> stack_;
+  // The callers of the DEFs running, innermost last.
+  std::vector<Frame> frames_;
+};
+
+} // namespace wwivbasic
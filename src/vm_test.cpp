@@ -0,0 +1,404 @@
+#include "gtest/gtest.h"
+#include "ast_builder.h"
+#include "compiler.h"
+#include "context.h"
+#include "vm.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace wwivbasic;
+
+class VMTest : public ::testing::Test {
+protected:
+  // Compiles and runs text on the VM, returning each line written by PRINT.
+  std::vector<std::string> Run(const std::string& text) {
+    ec_.add_source("test.bas", text);
+    EXPECT_TRUE(ec_.errors.empty());
+    ec_.root->native_functionl("PRINT", [this](Args args) -> Value {
+      std::string line;
+      for (const auto& arg : args) {
+        line += arg.toString();
+      }
+      output_.push_back(line);
+      return {};
+    });
+
+    auto& su = ec_.sources.at("test.bas");
+    auto unit = AstBuilder().build("test.bas", su->main());
+    program_ = Compiler().compile(*unit);
+    vm_ = std::make_unique<VM>(ec_, *program_);
+    vm_->run();
+    return output_;
+  }
+
+  Context ec_;
+  std::unique_ptr<Program> program_;
+  std::unique_ptr<VM> vm_;
+  std::vector<std::string> output_;
+};
+
+TEST_F(VMTest, Arithmetic) {
+  const auto out = Run("a = 10\nb = a * 2 + 3\nprint(b)\nprint(b MOD 7)\n");
+  EXPECT_EQ(out, std::vector<std::string>({"23", "2"}));
+}
+
+TEST_F(VMTest, IfElseIf) {
+  const auto out = Run(R"(a = 23
+If a = 1 Then
+print("one")
+ElseIf a = 23 Then
+print("twenty three")
+Else
+print("other")
+EndIf
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"twenty three"}));
+}
+
+TEST_F(VMTest, ShortCircuit) {
+  const auto out = Run(R"(def expensive(n)
+  print("called")
+  return 1
+enddef
+n = 0
+IF n > 0 AND expensive(n) = 1 THEN
+  print("and")
+ENDIF
+IF n = 0 OR expensive(n) = 1 THEN
+  print("or")
+ENDIF
+print(n = 0 AND expensive(n) = 1)
+print(n MOD 3 = 0 AND 2 + 3 * 2 = 8 OR FALSE)
+print(FALSE OR 5)
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"or", "called", "TRUE", "TRUE", "TRUE"}));
+}
+
+TEST_F(VMTest, RedefinedNativeFunction) {
+  ec_.root->native_function("VERSION", []() { return 1; });
+  ec_.root->native_functionl("REDEFINE", [this](Args) -> Value {
+    ec_.root->native_function("VERSION", []() { return 2; });
+    return {};
+  });
+  const auto out = Run(R"(FOR i = 1 to 2
+  print(version())
+  redefine()
+NEXT
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"1", "2"}));
+}
+
+TEST_F(VMTest, ForLoop) {
+  const auto out = Run(R"(s = 0
+FOR i = 1 to 10
+  s = s + i
+NEXT
+print(s)
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"55"}));
+}
+
+TEST_F(VMTest, ForLoopStep) {
+  const auto out = Run(R"(n = 2
+FOR i = 10 to 1 STEP -3
+  print(i)
+NEXT
+FOR i = 1 to 10 STEP n * 2
+  print(i)
+NEXT
+FOR i = 5 to 1
+  print("never")
+NEXT
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"10", "7", "4", "1", "1", "5", "9"}));
+}
+
+TEST_F(VMTest, ForLoopCompoundNegativeStep) {
+  // The minus applies to the first operand of the step, not the whole step.
+  const auto out = Run(R"(a = 5
+b = 2
+FOR i = 10 to 1 STEP -a + b
+  print(i)
+NEXT
+FOR i = 10 to 1 STEP -(a - b)
+  print(i)
+NEXT
+FOR i = 20 to 1 STEP -a * b
+  print(i)
+NEXT
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"10", "7", "4", "1", "10", "7", "4", "1", "20", "10"}));
+}
+
+TEST_F(VMTest, ForLoopBreak) {
+  const auto out = Run(R"(s = 0
+FOR i = 1 to 100
+  if i = 4 then
+    break
+  endif
+  FOR j = 1 to 100
+    if j > 2 then
+      break
+    endif
+    s = s + 1
+  NEXT
+NEXT
+print(s)
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"6"}));
+}
+
+TEST_F(VMTest, AppendToVariable) {
+  const auto out = Run(R"(s = ""
+FOR i = 1 to 20
+  s = s + i + ","
+NEXT
+t = s
+s = s + "end"
+def build(n)
+  r = "items:"
+  FOR i = 1 to n
+    r = r + " " + i
+  NEXT
+  return r
+enddef
+print(t)
+print(s)
+print(build(3))
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,",
+                                           "1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,end",
+                                           "items: 1 2 3"}));
+}
+
+TEST_F(VMTest, AppendCallChangesVariable) {
+  // The variable is read before the call, so the call's change is lost.
+  const auto out = Run(R"(s = "a"
+def bump()
+  s = "changed"
+  return "!"
+enddef
+s = s + bump()
+print(s)
+t = "x"
+def grow()
+  t = t + "y"
+  return "z"
+enddef
+t = t + grow() + grow()
+print(t)
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"a!", "xzz"}));
+}
+
+TEST_F(VMTest, Arrays) {
+  const auto out = Run(R"(DIM scores[5]
+FOR i = 0 to 4
+  scores[i] = (i * 7) MOD 5
+NEXT
+sorted = SORT(scores)
+print(SUM(scores))
+print(sorted[0])
+print(sorted[4])
+print(scores[1])
+print(FIND(scores, 4))
+DIM names[2] AS STRING
+names[0] = "sysop"
+copy = names
+copy[0] = 1
+print(names[0])
+print(copy[0])
+def doublesum(a)
+  DIM twice[LEN(a)]
+  FOR i = 0 to LEN(a) - 1
+    twice[i] = a[i] * 2
+  NEXT
+  return SUM(twice)
+enddef
+print(doublesum(scores))
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"10", "0", "4", "2", "2", "sysop", "1", "20"}));
+}
+
+TEST_F(VMTest, Dictionaries) {
+  const auto out = Run(R"(stats = {"sysop": 1, "guest": 0}
+stats["alice"] = 5
+stats["sysop"] = stats["sysop"] + 1
+print(stats["sysop"])
+print(LEN(stats))
+print(HAS(stats, "bob"))
+print(GET(stats, "bob", 7))
+names = KEYS(stats)
+print(names[2])
+copy = stats
+copy["guest"] = 9
+print(stats["guest"])
+print(copy["guest"])
+counts = {}
+FOR i = 1 to 10
+  counts[i MOD 3] = GET(counts, i MOD 3, 0) + 1
+NEXT
+print(counts[1])
+print(counts["0"])
+)");
+  EXPECT_EQ(out, std::vector<std::string>(
+                     {"2", "3", "FALSE", "7", "alice", "0", "9", "4", "3"}));
+}
+
+TEST_F(VMTest, DictionaryCopies) {
+  const auto out = Run(R"(d = {"a": 1, "b": 2, "c": 3}
+copy = d
+copy["b"] = 20
+print(LEN(copy))
+print(HAS(copy, "a"))
+print(GET(copy, "c", 0))
+e = SET(d, "a", 10)
+print(GET(e, "b", 0))
+print(GET(d, "a", 0))
+FOR i = 1 to 10
+  copy[i] = i
+NEXT
+print(LEN(copy))
+print(copy["a"] + copy["b"] + copy["c"] + copy[10])
+print(LEN(d))
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"3", "TRUE", "3", "2", "1", "13", "34", "3"}));
+}
+
+TEST_F(VMTest, RecursiveFunction) {
+  const auto out = Run(R"(def fib(n)
+  if n < 2 then
+    return n
+  endif
+  return fib(n - 1) + fib(n - 2)
+enddef
+print(fib(10))
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"55"}));
+}
+
+// Calls do not recurse on the native stack, so only max_call_depth limits
+// how deep they go.
+TEST_F(VMTest, DeepRecursion) {
+  ec_.max_call_depth = 200000;
+  const auto out = Run(R"(def depth(n)
+  if n = 0 then
+    return 0
+  endif
+  return depth(n - 1) + 1
+enddef
+print(depth(100000))
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"100000"}));
+}
+
+TEST_F(VMTest, CallDepthLimit) {
+  ec_.max_call_depth = 10;
+  const auto out = Run(R"(def depth(n)
+  if n = 0 then
+    return 0
+  endif
+  return depth(n - 1) + 1
+enddef
+print(depth(9))
+print(depth(10))
+print("after")
+print(depth(3))
+)");
+  // The innermost call fails with FALSE, and the rest of the script runs.
+  EXPECT_EQ(out, std::vector<std::string>({"9", "TRUE", "after", "3"}));
+}
+
+TEST_F(VMTest, ReturnFromForLoop) {
+  const auto out = Run(R"(def find(x)
+  FOR i = 1 to 10
+    if i = x then
+      return i * 100
+    endif
+  NEXT
+  return 0
+enddef
+print(find(3))
+print(find(3))
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"300", "300"}));
+}
+
+TEST_F(VMTest, LocalsAndGlobals) {
+  const auto out = Run(R"(i = 99
+total = 0
+def addto(n)
+  total = total + n
+  x = n * 2
+  return x
+enddef
+FOR i = 1 to 5
+  r = addto(i)
+NEXT
+print(i)
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"99"}));
+  EXPECT_EQ(vm_->global("total")->toInt(), 15);
+  EXPECT_EQ(vm_->global("R")->toInt(), 10);
+  EXPECT_FALSE(vm_->global("x").has_value());
+}
+
+TEST(VMThreadsTest, ShareProgram) {
+  std::vector<std::string> errors;
+  const std::shared_ptr<const Program> program = compile_source("test.bas", R"(def fib(n)
+  if n < 2 then
+    return n
+  endif
+  return fib(n - 1) + fib(n - 2)
+enddef
+s = "a string too long to store inline"
+FOR i = 1 to 50
+  s = "a string too long to store inline" + fib(i MOD 10)
+NEXT
+print(s)
+)", errors);
+  ASSERT_TRUE(program);
+
+  std::vector<std::vector<std::string>> outputs(8);
+  std::vector<std::thread> threads;
+  for (auto& output : outputs) {
+    threads.emplace_back([&program, &output] {
+      Context ec;
+      ec.root->native_functionl("PRINT", [&output](Args args) -> Value {
+        output.push_back(args.front().toString());
+        return {};
+      });
+      VM vm(ec, *program);
+      vm.run();
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (const auto& output : outputs) {
+    EXPECT_EQ(output, std::vector<std::string>({"a string too long to store inline0"}));
+  }
+}
+
+TEST_F(VMTest, StringFunctions) {
+  const auto out = Run(R"(s = "Hello World"
+print(LEN(s))
+print(LEFT(s, 5))
+print(RIGHT(s, 5))
+print(MID(s, 6, 3))
+print(ASC(MID(s, 4)))
+print(LEN(12345))
+)");
+  EXPECT_EQ(out, std::vector<std::string>({"11", "Hello", "World", "Wor", "111", "5"}));
+}
+
+TEST_F(VMTest, NativeFunctionArity) {
+  ec_.root->native_function("JOIN3", [](std::string_view a, int b, const std::string& c) {
+    return fmt::format("{}-{}-{}", a, b, c);
+  });
+  const auto out = Run("print(JOIN3(\"a\", 2, 3))\nprint(JOIN3(1, 2))\n");
+  EXPECT_EQ(out, std::vector<std::string>({"a-2-3", "FALSE"}));
+}